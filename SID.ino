@@ -1,23 +1,45 @@
 #include <Arduino.h>
+#include <MIDIUSB.h>
 #include <MemoryFree.h>
 #include <math.h>
-#include <usbmidi.h>
-#include "src/deque.h"
-#include "src/hash_table.h"
+
+// register writes go straight to the port pins (src/sid_avr_bus.h) instead of
+// through the `sid_bus` transport table
+#define SID_AVR_BUS_INLINE
+
+#include "src/control_scheduler.h"
+#include "src/dds.h"
+#include "src/envelope.h"
+#include "src/midi_cc_coalescer.h"
+#include "src/midi_cc_table.h"
 #include "src/midi_constants.h"
+#include "src/midi_parser.h"
+#include "src/midi_queue.h"
 #include "src/note.h"
+#include "src/note_priority.h"
+#include "src/note_table.h"
 #include "src/sid.h"
+#include "src/sid_avr_bus.h"
 #include "src/stdinout.h"
+#include "src/sysex.h"
+#include "src/usb_midi_packet.h"
 #include "src/util.h"
+#include "src/voice_allocator.h"
 
 #define DEBUG_LOGGING false
 
-const unsigned int deque_size = 16; // the number of notes that can be held simultaneously
-const int ARDUINO_SID_CHIP_SELECT_PIN = 13; // wired to SID's CS pin
-const int ARDUINO_SID_MASTER_CLOCK_PIN = 5; // wired to SID's Ø2 pin
-const byte MAX_POLYPHONY = 3;
+// one per chip, wired to each SID's CS pin: 13 (PC7), 4 (PD4), 6 (PD7). The
+// number of chips is SID_NUM_CHIPS (see src/sid.h, `make build SID_NUM_CHIPS=2`)
+const int ARDUINO_SID_CHIP_SELECT_PINS[] = { 13, 4, 6 };
+const int ARDUINO_SID_MASTER_CLOCK_PIN = 5; // wired to every SID's Ø2 pin
+const byte MAX_POLYPHONY = SID_VOICES;
+
+static_assert(
+  SID_NUM_CHIPS <= sizeof(ARDUINO_SID_CHIP_SELECT_PINS) / sizeof(*ARDUINO_SID_CHIP_SELECT_PINS),
+  "every SID needs its own chip select pin"
+);
 const byte DEFAULT_PITCH_BEND_SEMITONES = 5;
-const float DEFAULT_GLIDE_TIME_MILLIS = 100.0;
+const unsigned int DEFAULT_GLIDE_TIME_MILLIS = 100;
 const unsigned int GLIDE_TIME_MIN_MILLIS = 1;
 const unsigned int GLIDE_TIME_MAX_MILLIS = 10000;
 const word MAX_PULSE_WIDTH_VALUE = 4095;
@@ -30,35 +52,59 @@ const byte DEFAULT_RELEASE = 0;
 const unsigned short int DEFAULT_FILTER_FREQUENCY = 1000;
 const byte DEFAULT_FILTER_RESONANCE = 15;
 const byte DEFAULT_VOLUME = 15;
-const unsigned int PULSE_WIDTH_MODULATION_MODE_CARRIER_FREQUENCY = 65535;
-const float UPDATE_EVERY_MICROS = (100.0 / 4.41);
+const word PULSE_WIDTH_MODULATION_MODE_CARRIER_REGISTER = 65535; // the highest frequency the SID can make
+// Timer 1 ticks at 2MHz (16MHz / 8), so this drains one queued register write
+// every 16µs, i.e. every 16 cycles of the SID's 1MHz clock
+const unsigned int SID_QUEUE_DRAIN_PERIOD_TICKS = 32;
+const unsigned int SID_QUEUE_DRAIN_PERIOD_MICROS = SID_QUEUE_DRAIN_PERIOD_TICKS / 2;
+// MIDI events applied per loop, at most, so a burst can't hold up glide and
+// the modulation modes; the rest wait in `midi_events`
+const byte MIDI_EVENTS_PER_LOOP = 4;
+// the control scheduler's tick (see src/control_scheduler.h), and how often
+// each control task runs. `make build CONTROL_TICK_MICROS=16` for a finer one.
+#ifndef CONTROL_TICK_MICROS
+#define CONTROL_TICK_MICROS 32
+#endif
+static_assert(CONTROL_TICK_MICROS > 0 && CONTROL_TICK_MICROS <= 32767, "CONTROL_TICK_MICROS has to fit Timer 1 at 2MHz");
+const unsigned int CONTROL_TICK_TIMER_TICKS = CONTROL_TICK_MICROS * 2; // Timer 1 ticks at 2MHz
+// a period in control ticks, rounded up, so never 0
+#define CONTROL_TICKS(micros) (((micros) + CONTROL_TICK_MICROS - 1) / CONTROL_TICK_MICROS)
+const unsigned int ENVELOPE_PERIOD_MICROS = 1000; // envelopes are timed in milliseconds anyway
+const unsigned int GLIDE_PERIOD_MICROS = 500;
+// The modulation modes make a tone at the note's own pitch, so they want an
+// audio rate, but every tick can change a pulse width high byte per voice
+// (PWM mode) and the volume register on each chip (volume mode), and the bus
+// drains one write per SID_QUEUE_DRAIN_PERIOD_MICROS. Any faster and the queue
+// fills, and the loop is stuck draining it by hand. That's 64µs (15.6kHz) for
+// one chip.
+const unsigned int MODULATION_WRITES_PER_TICK = MAX_POLYPHONY + SID_NUM_CHIPS; // at worst
+const unsigned int MODULATION_PERIOD_MICROS = MODULATION_WRITES_PER_TICK * SID_QUEUE_DRAIN_PERIOD_MICROS;
+// what the modulation task's period comes to, in whole control ticks
+const unsigned int MODULATION_TICK_MICROS = CONTROL_TICKS(MODULATION_PERIOD_MICROS) * CONTROL_TICK_MICROS;
+static_assert(MODULATION_TICK_MICROS >= MODULATION_WRITES_PER_TICK * SID_QUEUE_DRAIN_PERIOD_MICROS, "the modulation modes would write faster than the bus drains");
+const byte CONTROL_CLOCK_CYCLES_PER_TICK = 8; // `control_scheduler_clock()` is Timer 1, at clk/8
+#define CONTROL_TASK_ENVELOPES 0 // `controls.tasks`, in the order `setup()` adds them
+#define CONTROL_TASK_GLIDE 1
+#define CONTROL_TASK_MODULATION 2
+#define MIDI_PORT_USB 0
+#define MIDI_PORT_DIN 1
+// SysEx messages we'll read, without their F0 and F7: a patch load is the
+// longest
+const byte MIDI_SYSEX_BUFFER_SIZE = SYSEX_PATCH_MESSAGE_SIZE - 2;
 
 byte polyphony = 1;
-word glide_time_raw_word;
-float glide_time_millis = DEFAULT_GLIDE_TIME_MILLIS;
+byte note_priority = NOTE_PRIORITY_LAST; // which held note mono mode plays
+byte voice_stealing = VOICE_ALLOCATOR_RELEASED_FIRST; // which voice paraphonic mode steals when they're all busy
+unsigned int glide_time_millis = DEFAULT_GLIDE_TIME_MILLIS;
 bool legato_mode = (polyphony == 1) && glide_time_millis > 0;
-byte glide_time_raw_lsb;
 unsigned long glide_start_time_micros = 0;
 byte glide_to = 0;
 byte glide_from = 0;
 int midi_pitch_bend_max_semitones = DEFAULT_PITCH_BEND_SEMITONES;
-float current_pitchbend_amount = 0.0; // [-1.0 .. 1.0]
+int pitchbend_amount = 0; // [-8192 .. 8191]
 byte detune_max_semitones = 5;
 // temp vars for implementing 14-bit midi CC messages spread over two messages
-word pw_v1     = DEFAULT_PULSE_WIDTH;
-byte pw_v1_lsb = 0;
-word pw_v2     = DEFAULT_PULSE_WIDTH;
-byte pw_v2_lsb = 0;
-word pw_v3     = DEFAULT_PULSE_WIDTH;
-byte pw_v3_lsb = 0;
-word detune_v1_raw_word = 8192;
-byte detune_v1_lsb      = 0;
-word detune_v2_raw_word = 8192;
-byte detune_v2_lsb      = 0;
-word detune_v3_raw_word = 8192;
-byte detune_v3_lsb      = 0;
-word filter_frequency = 0;
-byte filter_frequency_lsb = 0;
+byte midi_cc_slots[MIDI_CC_SLOTS]; // the last LSB sent for each MSB/LSB CC pair
 word rpn_value = 0; // used to implement RPN messages
 word data_entry = 0; // used to implement RPN messages
 
@@ -68,208 +114,325 @@ word data_entry = 0; // used to implement RPN messages
 bool volume_modulation_mode_active = false;
 bool pulse_width_modulation_mode_active = false;
 
-unsigned long last_update = 0;
-unsigned long last_glide_update_micros = 0;
 unsigned long time_in_micros = 0;
-unsigned long time_in_seconds = 0;
 
-struct note oscillator_notes[3] = { { .number=0, .on_time=0, .off_time=0 } };
-float voice_detune_percents[MAX_POLYPHONY] = { 0.0, 0.0, 0.0 }; // [-1.0 .. 1.0]
-float voice_frequency_mods[MAX_POLYPHONY] = { 1.0, 1.0, 1.0 };
-deque *notes = deque_initialize(deque_size, stdout, _note_indexer, _note_node_print_function);
+struct note oscillator_notes[MAX_POLYPHONY] = { { .number=0, .on_time=0, .off_time=0 } };
+int voice_detune_amounts[MAX_POLYPHONY] = { 0, 0, 0 }; // [-8192 .. 8191]
+// pitch bend + detune per voice, in 1/256ths of a semitone (see `sid_note_register_word`)
+long voice_pitch_offsets[MAX_POLYPHONY] = { 0, 0, 0 };
+note_table held_notes; // every note being held down, oldest first
+envelope voice_envelopes[MAX_POLYPHONY]; // what each voice's ADSR is doing, as far as we can tell
+dds_oscillator voice_oscillators[MAX_POLYPHONY]; // the modulation modes' waveforms, one per voice
+// the note and pitch offset each of `voice_oscillators` was last tuned to
+byte voice_oscillator_notes[MAX_POLYPHONY] = { 0 };
+long voice_oscillator_pitch_offsets[MAX_POLYPHONY] = { 0 };
+// `voice_envelopes`' levels for the modulation modes, worked out once per
+// note tick (they don't change any faster) rather than once per modulation tick
+byte voice_modulation_levels[MAX_POLYPHONY] = { 0 };
+note_ticks voice_modulation_levels_at = 0;
+uint16_t last_modulation_tick = 0; // `controls.now` at the modulation task's last run
+// 15 / (253 * voices), in 1/65536ths and rounded up: mixes [0..253] per voice
+// into the 4-bit volume, for 1..MAX_POLYPHONY voices. Filled in `setup()`.
+uint16_t volume_modulation_scales[MAX_POLYPHONY + 1];
+voice_allocator voices; // which voice each new note goes to in paraphonic mode
+midi_parser usb_midi_parser; // SysEx, for USB's packets
+midi_parser serial_midi_parser; // partial messages and running status
+byte usb_sysex_buffer[MIDI_SYSEX_BUFFER_SIZE]; // the SysEx message each parser has collected
+byte serial_sysex_buffer[MIDI_SYSEX_BUFFER_SIZE];
+midi_queue midi_events; // parsed events from both ports, oldest first
+midi_cc_coalescer pending_ccs; // continuous CCs popped from `midi_events`, not yet applied
+control_scheduler controls; // glide, the modulation modes and envelope tracking, on Timer 1's ticks
 
 static char float_string[15];
 
 void clean_slate();
 void update_oscillator_frequencies();
 
-void clock_high() {
+void cs_high(byte chip) {
   uint8_t oldSREG = SREG;
   cli();
 
-  PORTC |= 0B01000000;
-  // digitalWrite(ARDUINO_SID_MASTER_CLOCK_PIN, HIGH);
+  *sid_chip_select_ports[chip] |= sid_chip_select_masks[chip];
+  // digitalWrite(ARDUINO_SID_CHIP_SELECT_PINS[chip], HIGH);
 
   SREG = oldSREG;
 }
 
-void clock_low() {
-  uint8_t oldSREG = SREG;
-  cli();
+// the real SID bus as a transport, installed as `sid_bus` in `setup()`. Only
+// used if SID_AVR_BUS_INLINE is off (e.g. to wrap it for debugging).
+void avr_port_write(__attribute__ ((unused)) void *context, byte address, byte data) {
+  sid_avr_bus_write(address, data);
+}
 
-  PORTC &= 0B10111111;
-  // digitalWrite(ARDUINO_SID_MASTER_CLOCK_PIN, LOW);
+sid_transport avr_port_transport = { .write=avr_port_write, .context=NULL };
 
-  SREG = oldSREG;
+// SID requires a 1MHz clock signal, so this sets `ARDUINO_SID_MASTER_CLOCK_PIN`
+// to be our 1MHz oscillator by configuring Timer 3 of the ATmega32U4.
+// http://medesign.seas.upenn.edu/index.php/Guides/MaEvArM-timer3
+void start_clock() {
+  TCCR3A = 0;
+  TCCR3B = 0;
+  TCNT3 = 0;
+  OCR3A = 7;
+  TCCR3A |= (1 << COM3A0);
+  TCCR3B |= (1 << WGM32);
+  TCCR3B |= (1 << CS30);
 }
 
-void cs_high() {
+// Timer 1 free-runs so its compare units can be used as independent periodic
+// interrupts: OCR1A is re-armed from inside its own ISR, `period` ticks later.
+void start_bus_queue_timer() {
+  TCCR1A = 0;
+  TCCR1B = (1 << CS11); // normal mode, clk/8
+  TIMSK1 = 0;
+}
+
+// arms the bus-drain ISR if it isn't running. Called after every enqueue.
+void sid_bus_drain_start() {
   uint8_t oldSREG = SREG;
   cli();
 
-  PORTC |= 0B10000000;
-  // digitalWrite(ARDUINO_SID_CHIP_SELECT_PIN, HIGH);
+  if (!(TIMSK1 & (1 << OCIE1A))) {
+    OCR1A = TCNT1 + SID_QUEUE_DRAIN_PERIOD_TICKS;
+    TIFR1 = (1 << OCF1A); // clear a stale match so we don't fire immediately
+    TIMSK1 |= (1 << OCIE1A);
+  }
 
   SREG = oldSREG;
 }
 
-void cs_low() {
+// drains one register write per tick, and disarms itself once the queue is
+// empty so an idle synth doesn't pay for the interrupt
+ISR(TIMER1_COMPA_vect) {
+  sid_telemetry_critical_begin(); // interrupts are off for the whole ISR
+  OCR1A += SID_QUEUE_DRAIN_PERIOD_TICKS;
+
+  if (!sid_queue_drain_one()) {
+    TIMSK1 &= ~(1 << OCIE1A);
+  }
+  sid_telemetry_critical_end();
+}
+
+// the control scheduler's tick, on Timer 1's other compare unit. Only counts:
+// the tasks run in the loop (see `run_control_tasks()`)
+ISR(TIMER1_COMPB_vect) {
+  OCR1B += CONTROL_TICK_TIMER_TICKS;
+  control_scheduler_tick(&controls);
+}
+
+void start_control_timer() {
   uint8_t oldSREG = SREG;
   cli();
 
-  PORTC &= 0B01111111;
-  // digitalWrite(ARDUINO_SID_CHIP_SELECT_PIN, LOW);
+  OCR1B = TCNT1 + CONTROL_TICK_TIMER_TICKS;
+  TIFR1 = (1 << OCF1B); // clear a stale match so we don't fire immediately
+  TIMSK1 |= (1 << OCIE1B);
 
   SREG = oldSREG;
 }
 
-// SID requires a 1MHz clock signal, so this sets `ARDUINO_SID_MASTER_CLOCK_PIN`
-// to be our 1MHz oscillator by configuring Timer 3 of the ATmega32U4.
-// http://medesign.seas.upenn.edu/index.php/Guides/MaEvArM-timer3
-void start_clock() {
-  TCCR3A = 0;
-  TCCR3B = 0;
-  TCNT3 = 0;
-  OCR3A = 7;
-  TCCR3A |= (1 << COM3A0);
-  TCCR3B |= (1 << WGM32);
-  TCCR3B |= (1 << CS30);
+uint16_t control_scheduler_clock() {
+  return TCNT1;
 }
 
+#ifdef SID_TELEMETRY
+// Timer 1 free-runs at 2MHz (see `start_bus_queue_timer()`)
+const byte TELEMETRY_TICKS_PER_MICROSECOND = 2;
+
+uint16_t sid_telemetry_clock() {
+  return TCNT1;
+}
+#endif
+
 void nullify_notes_playing() {
   for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
     oscillator_notes[i] = { .number = 0, .on_time = 0, .off_time = 0 };
+    envelope_reset(&voice_envelopes[i]);
   }
 
-  deque_empty(notes);
+  voice_allocator_initialize(&voices, MAX_POLYPHONY);
+  note_table_empty(&held_notes);
 }
 
-void handle_voice_attack_change(byte voice, byte envelope_value) {
+// per-voice CC handlers. The voice is a template parameter, so the mono path
+// writes to constant register addresses via sid_voice<V> (src/sid.h);
+// `handle_control_change()` picks the instance for the CC's voice.
+template <byte VOICE>
+void handle_voice_attack_change(byte envelope_value) {
   if (polyphony > 1) {
     for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_attack(i, envelope_value);
     }
   } else {
-    sid_set_attack(voice, envelope_value);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_attack(envelope_value); });
   }
 }
 
-void handle_voice_decay_change(byte voice, byte envelope_value) {
+template <byte VOICE>
+void handle_voice_decay_change(byte envelope_value) {
   if (polyphony > 1) {
-    for (unsigned char i = 0; i < 3; i++) {
+    for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_decay(i, envelope_value);
     }
   } else {
-    sid_set_decay(voice, envelope_value);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_decay(envelope_value); });
   }
 }
 
-void handle_voice_sustain_change(byte voice, byte envelope_value) {
+template <byte VOICE>
+void handle_voice_sustain_change(byte envelope_value) {
   if (polyphony > 1) {
-    for (unsigned char i = 0; i < 3; i++) {
+    for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_sustain(i, envelope_value);
     }
   } else {
-    sid_set_sustain(voice, envelope_value);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_sustain(envelope_value); });
   }
 }
 
-void handle_voice_release_change(byte voice, byte envelope_value) {
+template <byte VOICE>
+void handle_voice_release_change(byte envelope_value) {
   if (polyphony > 1) {
-    for (unsigned char i = 0; i < 3; i++) {
+    for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_release(i, envelope_value);
     }
   } else {
-    sid_set_release(voice, envelope_value);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_release(envelope_value); });
   }
 }
 
-void handle_voice_waveform_change(byte voice, byte waveform, bool on) {
+template <byte VOICE>
+void handle_voice_waveform_change(byte waveform, bool on) {
   if (polyphony == 1) {
-    sid_set_waveform(voice, waveform, on);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_waveform(waveform, on); });
   } else {
-    for (unsigned char i = 0; i < 3; i++) {
+    for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_waveform(i, waveform, on);
     }
   }
 }
 
-void handle_voice_filter_change(byte voice, bool on) {
+template <byte VOICE>
+void handle_voice_filter_change(bool on) {
   if (polyphony > 1) {
-    byte address = SID_REGISTER_ADDRESS_FILTER_RESONANCE;
-    byte data = 0;
     byte voice_filter_mask = (SID_FILTER_VOICE1 | SID_FILTER_VOICE2 | SID_FILTER_VOICE3);
 
-    if (on) {
-      data = sid_state_bytes[address] | voice_filter_mask;
-    } else {
-      data = sid_state_bytes[address] & ~voice_filter_mask;
-    }
+    for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+      byte address = sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_RESONANCE);
+      byte data = 0;
 
-    sid_transfer(address, data);
+      if (on) {
+        data = sid_state_bytes[address] | voice_filter_mask;
+      } else {
+        data = sid_state_bytes[address] & ~voice_filter_mask;
+      }
+
+      sid_transfer(address, data);
+    }
   } else {
-    sid_set_filter(voice, on);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_filter(on); });
   }
 }
 
-void handle_voice_pulse_width_change(byte voice, word frequency) {
+template <byte VOICE>
+void handle_voice_pulse_width_change(word frequency) {
   if (polyphony > 1) {
     for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_pulse_width(i, frequency);
     }
   } else {
-    sid_set_pulse_width(voice, frequency);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_pulse_width(frequency); });
   }
 }
 
-void handle_voice_ring_mod_change(byte voice, bool on) {
+template <byte VOICE>
+void handle_voice_ring_mod_change(bool on) {
   if (polyphony > 1) {
     for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_ring_mod(i, on);
     }
   } else {
-    sid_set_ring_mod(voice, on);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_ring_mod(on); });
   }
 }
 
-void handle_voice_sync_change(byte voice, bool on) {
+template <byte VOICE>
+void handle_voice_sync_change(bool on) {
   if (polyphony > 1) {
     for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_sync(i, on);
     }
   } else {
-    sid_set_sync(voice, on);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_sync(on); });
   }
 }
 
-void handle_voice_test_change(byte voice, bool on) {
+template <byte VOICE>
+void handle_voice_test_change(bool on) {
   if (polyphony > 1) {
     for (unsigned char i = 0; i < polyphony; i++) {
       sid_set_test(i, on);
     }
   } else {
-    sid_set_test(voice, on);
+    sid_voice_on_every_chip<VOICE>::apply([=](auto voice) { voice.set_test(on); });
   }
 }
 
-// detune factor: [-1.0...1.0]
-void handle_voice_detune_change(byte voice, float detune_factor) {
-  voice_detune_percents[voice] = detune_factor;
+// amounts are 14-bit midi values re-centered on 0, so an amount of 8192 means
+// "the max number of semitones". 8192 / 256ths of a semitone = 32.
+void update_voice_pitch_offsets() {
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    voice_pitch_offsets[i] = (
+      ((long)pitchbend_amount * midi_pitch_bend_max_semitones) +
+      ((long)voice_detune_amounts[i] * detune_max_semitones)
+    ) / 32;
+  }
+}
 
-  double temp_double = (current_pitchbend_amount * midi_pitch_bend_max_semitones) + (voice_detune_percents[voice] * detune_max_semitones);
-  voice_frequency_mods[voice] = pow(2, temp_double / 12.0);
+int voice_detune_percent(byte voice) {
+  return (int)(((long)voice_detune_amounts[voice] * 100) / 8192);
+}
 
+// detune_raw_word: 14-bit, 8192 means "no detune"
+void handle_voice_detune_change(byte voice, word detune_raw_word) {
+  for (unsigned char i = voice; i < MAX_POLYPHONY; i += 3) {
+    voice_detune_amounts[i] = (int)detune_raw_word - 8192;
+  }
+  update_voice_pitch_offsets();
   update_oscillator_frequencies();
 }
 
+// keeps `voice_envelopes` in step with the gate. Call it after every gate
+// write, and for the modulation modes' software envelopes, which don't touch
+// the gate at all.
+void track_voice_envelope(byte voice, bool gate, note_ticks now) {
+  envelope_gate(
+    &voice_envelopes[voice],
+    gate,
+    now,
+    sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)],
+    sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR)]
+  );
+}
+
+// the level `voice_envelopes[voice]` is at, [0..255]
+byte voice_envelope_level(byte voice, note_ticks now) {
+  return envelope_level(
+    &voice_envelopes[voice],
+    now,
+    sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)],
+    sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR)]
+  );
+}
+
 // set the oscillator frequency and gate it!
 // - takes stateful stuff into account, like pitch bend and detune
 // - will first de-gate the oscillator iff it's not already de-gated for some reason
 // - handles global modulation modes (if we're in volume mod mode, we don't actually interact with the voice.)
 void play_note_for_voice(byte note_number, unsigned char voice) {
   unsigned long now = micros();
-  double hertz = (current_pitchbend_amount * midi_pitch_bend_max_semitones) + (voice_detune_percents[voice] * detune_max_semitones);
-  hertz = note_number_to_frequency(note_number) * voice_frequency_mods[voice];
+  note_ticks now_ticks = note_ticks_from_millis(millis());
+  word frequency = sid_note_register_word(note_number, voice_pitch_offsets[voice]);
 
   if (!volume_modulation_mode_active) {
     if (get_voice_gate(voice)) { // this voice is already playing another note, still in its ADS phase. So glide might be relevant. Otherwise we can just clobber the gate
@@ -279,51 +442,112 @@ void play_note_for_voice(byte note_number, unsigned char voice) {
         glide_from = oscillator_notes[voice].number;
       } else {
         sid_set_gate(voice, false);
+        track_voice_envelope(voice, false, now_ticks);
       }
     }
 
     if (pulse_width_modulation_mode_active) {
-      sid_set_voice_frequency(voice, PULSE_WIDTH_MODULATION_MODE_CARRIER_FREQUENCY);
+      sid_set_voice_frequency_register(voice, PULSE_WIDTH_MODULATION_MODE_CARRIER_REGISTER);
     } else {
       if (!legato_mode || (oscillator_notes[voice].number == 0 || oscillator_notes[voice].off_time != 0)) { // i.e. no other note is being voiced OR the note being voiced is in its release phase
-        sid_set_voice_frequency(voice, hertz);
+        sid_set_voice_frequency_register(voice, frequency);
       }
     }
 
     if (!get_voice_gate(voice)) {
       sid_set_gate(voice, true);
-      oscillator_notes[voice].on_time = now;
+      oscillator_notes[voice].on_time = now_ticks;
+      dds_reset(&voice_oscillators[voice]);
     }
   }
-  deque_append_replace(notes, { .number=note_number, .on_time=now, .off_time=0, .voiced_by_oscillator=voice });
+  track_voice_envelope(voice, true, now_ticks);
+  note_table_append(&held_notes, note_number);
 
+  voice_allocator_assign(&voices, voice, note_number);
   oscillator_notes[voice].number = note_number;
   oscillator_notes[voice].off_time = 0;
 }
 
 void log_load_stats() {
   printf(
-    "{free_mem: %d, h(%u/%u){load: %d%%, coll: %d%%}\n",
+    "{free_mem: %d, held: %u, q(%u/%u){max: %u, ovf: %u}}\n",
     freeMemory(),
-    notes->ht->size,
-    notes->ht->max_size,
-    (unsigned int)(hash_table_load_factor(notes->ht) * 100),
-    (unsigned int)(hash_table_collision_ratio(notes->ht) * 100)
+    held_notes.length,
+    sid_queue_depth(&sid_write_queue),
+    SID_QUEUE_SIZE - 1,
+    sid_write_queue.max_depth,
+    sid_write_queue.overflows
+  );
+  printf(
+    "{midi(%u/%u){max: %u, latency{max: %uus, mean: %uus}, coalesced: %lu}}\n",
+    midi_queue_depth(&midi_events),
+    MIDI_QUEUE_PORTS * (MIDI_QUEUE_SIZE - 1),
+    midi_events.max_depth,
+    midi_events.max_latency,
+    midi_queue_mean_latency(&midi_events),
+    (unsigned long)pending_ccs.merged
+  );
+
+  printf(
+    "{control{overruns: %lu, stalls: %lu, longest(cycles){envelopes: %lu, glide: %lu, modulation: %lu}}}\n",
+    (unsigned long)control_scheduler_overruns(&controls),
+    (unsigned long)controls.overflows,
+    (unsigned long)controls.tasks[CONTROL_TASK_ENVELOPES].longest_run * CONTROL_CLOCK_CYCLES_PER_TICK,
+    (unsigned long)controls.tasks[CONTROL_TASK_GLIDE].longest_run * CONTROL_CLOCK_CYCLES_PER_TICK,
+    (unsigned long)controls.tasks[CONTROL_TASK_MODULATION].longest_run * CONTROL_CLOCK_CYCLES_PER_TICK
   );
+
+  #ifdef SID_TELEMETRY
+    printf(
+      "{bus{writes: %lu, suppressed: %lu, coalesced: %lu, busy: %luus, longest_cli: %uus}}\n",
+      (unsigned long)sid_telemetry_total_writes(),
+      (unsigned long)sid_stats.suppressed,
+      (unsigned long)sid_stats.coalesced,
+      (unsigned long)(sid_stats.bus_ticks / TELEMETRY_TICKS_PER_MICROSECOND),
+      sid_stats.longest_critical_ticks / TELEMETRY_TICKS_PER_MICROSECOND
+    );
+  #endif
+}
+
+// writes per register since the last reset, e.g. to see which automation lanes
+// are saturating the bus
+void log_register_writes() {
+  #ifdef SID_TELEMETRY
+    for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+      printf("SID%u writes:", chip);
+      for (byte i = 0; i < 25; i++) {
+        printf(" %02u:%lu", i, (unsigned long)sid_stats.register_writes[sid_chip_address(chip, i)]);
+      }
+      printf("\n");
+    }
+  #endif
 }
 
 
 void inspect_oscillator_notes() {
-  printf("{%d, %d, %d}\n", oscillator_notes[0].number, oscillator_notes[1].number, oscillator_notes[2].number);
+  printf("{");
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    printf(i == 0 ? "%d" : ", %d", oscillator_notes[i].number);
+  }
+  printf("}\n");
 }
 
 void inspect_voice_detunes() {
-  printf(
-    "{%d%%, %d%%, %d%%}\n",
-    (signed int)(voice_detune_percents[0] * 100),
-    (signed int)(voice_detune_percents[1] * 100),
-    (signed int)(voice_detune_percents[2] * 100)
-  );
+  printf("{");
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    printf(i == 0 ? "%d%%" : ", %d%%", voice_detune_percent(i));
+  }
+  printf("}\n");
+}
+
+bool any_oscillator_playing() {
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    if (oscillator_notes[i].number != 0) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 void handle_note_on(byte note_number) {
@@ -333,8 +557,14 @@ void handle_note_on(byte note_number) {
     inspect_oscillator_notes();
   #endif
 
-  // We're mono, so play the same base note on all 3 oscillators
+  // We're mono, so play the same base note on every oscillator (of every chip)
   if (polyphony == 1) {
+    if (note_priority != NOTE_PRIORITY_LAST) {
+      note_table_append(&held_notes, note_number);
+      if (note_priority_select(&held_notes, note_priority) != note_number) {
+        return; // held, but a note with priority over it keeps sounding
+      }
+    }
     for (unsigned char i = 0; i < MAX_POLYPHONY; i++ ) {
       if (get_voice_waveform(i) != 0) { // don't even try to play "muted" voices
         play_note_for_voice(note_number, i);
@@ -343,25 +573,24 @@ void handle_note_on(byte note_number) {
     return;
   }
 
-  // we're poly, so every voice has its own frequency.
-  // if there's a free voice, we can just use that.
+  // we're poly, so every voice has its own frequency. A free voice if there is
+  // one, or else whichever one `voice_stealing` says
+  note_ticks now_ticks = note_ticks_from_millis(millis());
   for (unsigned char i = 0; i < polyphony; i++) {
-    if (oscillator_notes[i].number == 0) {
-      play_note_for_voice(note_number, i);
-      return;
-    }
+    voice_allocator_set_level(&voices, i, voice_envelope_level(i, now_ticks));
   }
-
-  unsigned int oldest_voice = notes->first->data.voiced_by_oscillator;
+  byte voice = voice_allocator_pick(&voices, note_number, voice_stealing);
 
   #if DEBUG_LOGGING
-    printf("oldest_voice: %d\n", oldest_voice);
+    printf("picked voice: %d\n", voice);
+    voice_allocator_inspect(&voices, stdout);
   #endif
-  play_note_for_voice(note_number, oldest_voice);
+  play_note_for_voice(note_number, voice);
 }
 
 void handle_note_off(byte note_number) {
   unsigned long now = micros();
+  note_ticks now_ticks = note_ticks_from_millis(millis());
 
   #if DEBUG_LOGGING
     log_load_stats();
@@ -369,9 +598,9 @@ void handle_note_off(byte note_number) {
     inspect_oscillator_notes();
   #endif
 
-  note *note_from_deque = deque_find_by_key(notes, note_number);
-  if (note_from_deque) {
-    note_from_deque->off_time = now;
+  byte other_most_recent_note = NOTE_TABLE_NONE; // the held note that takes over, by `note_priority`
+  if (note_table_contains(&held_notes, note_number)) {
+    other_most_recent_note = note_priority_select_without(&held_notes, note_priority, note_number);
   } else {
     #if DEBUG_LOGGING
       Serial.print("NOTE: received note_off message for an unknown note.");
@@ -379,35 +608,48 @@ void handle_note_off(byte note_number) {
   }
 
   bool remove_note = false;
+  bool retrigger = false;
 
   for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
     // if the note is being voiced, we just need to start its release phase
     if (oscillator_notes[i].number == note_number) {
       if (pulse_width_modulation_mode_active) {
-        oscillator_notes[i].off_time = now;
+        oscillator_notes[i].off_time = now_ticks;
+        track_voice_envelope(i, false, now_ticks);
+        voice_allocator_release(&voices, i);
         continue;
       }
-      node *other_most_recent_node = deque_find_node_by_key(notes, note_number)->previous;
-      if (legato_mode && other_most_recent_node) {
+      if (legato_mode && other_most_recent_note != NOTE_TABLE_NONE) {
         // this means more than one note is being held. So we start gliding to the other most recent note. This is how "hammer-off" glides work
-        byte new_num = other_most_recent_node->data.number;
-        oscillator_notes[i] = { .number=new_num, .on_time=now, .off_time=0, .voiced_by_oscillator=i };
+        byte new_num = other_most_recent_note;
+        oscillator_notes[i] = { .number=new_num, .voiced_by_oscillator=i, .on_time=now_ticks, .off_time=0 };
+        voice_allocator_assign(&voices, i, new_num);
         glide_start_time_micros = now;
         glide_to = new_num;
         glide_from = note_number;
         remove_note = true;
+      } else if (polyphony == 1 && note_priority != NOTE_PRIORITY_LAST && other_most_recent_note != NOTE_TABLE_NONE) {
+        // without glide, the note that takes over is struck again
+        retrigger = true;
+        remove_note = true;
       } else {
         sid_set_gate(i, false);
-        oscillator_notes[i].off_time = now;
+        track_voice_envelope(i, false, now_ticks);
+        voice_allocator_release(&voices, i);
+        oscillator_notes[i].off_time = now_ticks;
       }
     } else {
-      // if the note is not being voiced, we may as well try to remove its entry from the deque now
+      // if the note is not being voiced, we may as well try to remove its entry from the table now
       remove_note = true;
     }
   }
 
   if (remove_note) {
-    deque_remove_by_key(notes, note_number);
+    note_table_remove(&held_notes, note_number);
+  }
+
+  if (retrigger) {
+    handle_note_on(other_most_recent_note);
   }
 
   if (note_number == glide_to) {
@@ -417,54 +659,121 @@ void handle_note_off(byte note_number) {
 }
 
 void handle_pitchbend_change(word pitchbend) {
-  double temp_double = 0.0;
-  current_pitchbend_amount = ((pitchbend / 8192.0) - 1); // 8192 is the "neutral" pitchbend value (half of 2**14)
-  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
-    if (oscillator_notes[i].number != 0) {
-      temp_double = (current_pitchbend_amount * midi_pitch_bend_max_semitones) + (voice_detune_percents[i] * detune_max_semitones);
-      voice_frequency_mods[i] = pow(2, temp_double / 12.0);
+  pitchbend_amount = (int)pitchbend - 8192; // 8192 is the "neutral" pitchbend value (half of 2**14)
+  update_voice_pitch_offsets();
 
-      if (!pulse_width_modulation_mode_active){
-        sid_set_voice_frequency(i, note_number_to_frequency(oscillator_notes[i].number) * voice_frequency_mods[i]);
-      }
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    if (oscillator_notes[i].number != 0 && !pulse_width_modulation_mode_active) {
+      sid_set_voice_frequency_register(i, sid_note_register_word(oscillator_notes[i].number, voice_pitch_offsets[i]));
     }
   }
 }
 
 void duplicate_voice(unsigned char from_voice, unsigned char to_voice) {
   for (unsigned char i = 0; i < 7; i++) {
-    sid_transfer((to_voice * 7) + i, sid_state_bytes[(from_voice * 7) + i]);
+    sid_transfer(sid_voice_address(to_voice, i), sid_state_bytes[sid_voice_address(from_voice, i)]);
   }
 
-  voice_detune_percents[to_voice] = voice_detune_percents[from_voice];
+  voice_detune_amounts[to_voice] = voice_detune_amounts[from_voice];
+  update_voice_pitch_offsets();
 }
 
 void initialize_glide_state() {
-  glide_time_raw_word = 0;
-  glide_time_raw_lsb = 0;
+  midi_cc_slots[MIDI_CC_SLOT_GLIDE_TIME] = 0;
   glide_start_time_micros = 0;
   glide_to = 0;
   glide_from = 0;
 }
 
+// CC 123: every voice still being held goes into its release, as if its note
+// had been let go, and no notes are held any more. The loop's leak detector
+// zeroes each voice's frequency once its release is over, as usual.
+void handle_all_notes_off() {
+  note_ticks now_ticks = note_ticks_from_millis(millis());
+
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    if (oscillator_notes[i].number == 0 || oscillator_notes[i].off_time != 0) {
+      continue; // silent, or releasing already
+    }
+    if (!pulse_width_modulation_mode_active) {
+      sid_set_gate(i, false);
+    }
+    track_voice_envelope(i, false, now_ticks);
+    voice_allocator_release(&voices, i);
+    oscillator_notes[i].off_time = now_ticks;
+  }
+
+  note_table_empty(&held_notes);
+  glide_from = 0;
+  glide_to = 0;
+}
+
+// CC 120: silent now, rather than after the release. Every gate goes off and
+// every frequency to 0, and every note is forgotten. Nothing the patch sets
+// changes, and the loop's transaction only sends the registers that do.
+void handle_all_sound_off() {
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    sid_set_gate(i, false);
+    sid_set_voice_frequency_register(i, 0);
+  }
+
+  nullify_notes_playing();
+  glide_from = 0;
+  glide_to = 0;
+}
+
+// CC 121: pitch bend back to the middle, and no RPN selected, so a stray data
+// entry can't change the bend range. The patch stays as it is.
+void handle_reset_all_controllers() {
+  rpn_value = MIDI_RPN_NULL;
+  handle_pitchbend_change(8192);
+}
+
 void handle_program_change(byte program_number) {
   switch (program_number) {
   case MIDI_PROGRAM_CHANGE_SET_GLOBAL_MODE_PARAPHONIC:
-    polyphony = 3;
-    sid_set_gate(0, false);
-    sid_set_gate(1, false);
-    sid_set_gate(2, false);
-    duplicate_voice(0, 1);
-    duplicate_voice(0, 2);
-    for (unsigned char i = 0; i < 3; i++) {
+    polyphony = MAX_POLYPHONY;
+    for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+      sid_set_gate(i, false);
+      track_voice_envelope(i, false, note_ticks_from_millis(millis()));
+    }
+    for (unsigned char i = 1; i < MAX_POLYPHONY; i++) {
+      duplicate_voice(0, i);
+    }
+    for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
       oscillator_notes[i] = { .number = 0, .on_time = 0, .off_time = 0 };
     }
+    voice_allocator_initialize(&voices, MAX_POLYPHONY);
     legato_mode = false;
     break;
   case MIDI_PROGRAM_CHANGE_SET_GLOBAL_MODE_MONOPHONIC_UNISON:
     polyphony = 1;
     initialize_glide_state();
-    legato_mode = (polyphony == 1) && (glide_time_millis > 0.01);
+    legato_mode = (polyphony == 1) && (glide_time_millis > 0);
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_NOTE_PRIORITY_LAST:
+    note_priority = NOTE_PRIORITY_LAST;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_NOTE_PRIORITY_LOWEST:
+    note_priority = NOTE_PRIORITY_LOWEST;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_NOTE_PRIORITY_HIGHEST:
+    note_priority = NOTE_PRIORITY_HIGHEST;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_OLDEST:
+    voice_stealing = VOICE_ALLOCATOR_OLDEST;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_QUIETEST:
+    voice_stealing = VOICE_ALLOCATOR_QUIETEST;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_RELEASED_FIRST:
+    voice_stealing = VOICE_ALLOCATOR_RELEASED_FIRST;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_ROUND_ROBIN:
+    voice_stealing = VOICE_ALLOCATOR_ROUND_ROBIN;
+    break;
+  case MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_SAME_NOTE:
+    voice_stealing = VOICE_ALLOCATOR_SAME_NOTE;
     break;
   case MIDI_PROGRAM_CHANGE_HARDWARE_RESET:
     clean_slate();
@@ -475,18 +784,16 @@ void handle_program_change(byte program_number) {
 void enable_pulse_width_modulation_mode() {
   pulse_width_modulation_mode_active = true;
 
-  for (unsigned char i = 0; i < 3; i++) {
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
     sid_set_waveform(i, SID_SQUARE, true);
-    sid_set_voice_frequency(i, PULSE_WIDTH_MODULATION_MODE_CARRIER_FREQUENCY);
+    sid_set_voice_frequency_register(i, PULSE_WIDTH_MODULATION_MODE_CARRIER_REGISTER);
   }
 }
 
 void reset_voice_waveforms_to_default() {
-  for (unsigned int i = 0; i < polyphony; i++) {
-    if (i < polyphony) {
+  for (unsigned int i = 0; i < MAX_POLYPHONY; i++) {
+    if (i < polyphony || (polyphony == 1 && i % 3 == 0)) { // in mono, voice 1 of every chip
       sid_set_waveform(i, DEFAULT_WAVEFORM, true);
-    } else {
-      sid_zero_waveform(i);
     }
   }
 }
@@ -494,22 +801,142 @@ void reset_voice_waveforms_to_default() {
 void disable_pulse_width_modulation_mode() {
   pulse_width_modulation_mode_active = false;
 
-  for (unsigned char i = 0; i < 3; i++) {
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
     sid_set_test(i, false);
   }
 
   reset_voice_waveforms_to_default();
 }
 
+// sends a whole SysEx message (F0 to F7) out of `port`, straight away
+void send_sysex(byte port, const byte *message, byte length) {
+  if (port == MIDI_PORT_DIN) {
+    Serial1.write(message, length);
+    return;
+  }
+
+  usb_midi_packet packet;
+  for (byte offset = 0; offset < length;) {
+    offset += usb_midi_sysex_packet(message, length, offset, &packet);
+    MidiUSB.sendMIDI({ packet.header, packet.bytes[0], packet.bytes[1], packet.bytes[2] });
+  }
+  MidiUSB.flush();
+}
+
+// the patch we're playing: chip 0's registers (every chip gets the same patch)
+// and the globals
+void current_patch(sysex_patch *patch) {
+  for (byte i = 0; i < SYSEX_PATCH_REGISTERS; i++) {
+    patch->registers[i] = sid_state_bytes[sid_chip_address(0, i)];
+  }
+  patch->modes = (
+    (polyphony > 1 ? SYSEX_PATCH_PARAPHONIC : 0) |
+    (volume_modulation_mode_active ? SYSEX_PATCH_VOLUME_MODULATION : 0) |
+    (pulse_width_modulation_mode_active ? SYSEX_PATCH_PULSE_WIDTH_MODULATION : 0)
+  );
+  patch->note_priority = note_priority;
+  patch->voice_stealing = voice_stealing;
+  patch->glide_time_millis = glide_time_millis;
+  patch->pitch_bend_semitones = midi_pitch_bend_max_semitones;
+  patch->detune_semitones = detune_max_semitones;
+  for (byte i = 0; i < 3; i++) {
+    patch->detunes[i] = voice_detune_amounts[i] + 8192;
+  }
+}
+
+// Everything in one go: the loop's `sid_commit()` sends each changed register
+// once. The modes go first, since switching them rewrites waveforms, which the
+// patch's registers then overwrite. Frequencies and gates are left alone, so
+// held notes keep playing, with the new sound.
+void apply_patch(const sysex_patch *patch) {
+  bool paraphonic = patch->modes & SYSEX_PATCH_PARAPHONIC;
+  if (paraphonic != (polyphony > 1)) {
+    handle_program_change(paraphonic ? MIDI_PROGRAM_CHANGE_SET_GLOBAL_MODE_PARAPHONIC : MIDI_PROGRAM_CHANGE_SET_GLOBAL_MODE_MONOPHONIC_UNISON);
+  }
+  bool pulse_width_modulation = patch->modes & SYSEX_PATCH_PULSE_WIDTH_MODULATION;
+  if (pulse_width_modulation && !pulse_width_modulation_mode_active) {
+    enable_pulse_width_modulation_mode();
+  } else if (!pulse_width_modulation && pulse_width_modulation_mode_active) {
+    disable_pulse_width_modulation_mode();
+  }
+  volume_modulation_mode_active = patch->modes & SYSEX_PATCH_VOLUME_MODULATION;
+
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    for (byte i = 0; i < SYSEX_PATCH_REGISTERS; i++) {
+      byte address = sid_chip_address(chip, i);
+      byte data = patch->registers[i];
+      if (i < 21 && i % 7 <= SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI) {
+        continue;
+      }
+      if (i < 21 && i % 7 == SID_REGISTER_OFFSET_VOICE_CONTROL) {
+        data = (data & ~SID_GATE) | (sid_state_bytes[address] & SID_GATE);
+      }
+      sid_transfer(address, data);
+    }
+  }
+
+  if (patch->note_priority <= NOTE_PRIORITY_HIGHEST) {
+    note_priority = patch->note_priority;
+  }
+  if (patch->voice_stealing <= VOICE_ALLOCATOR_SAME_NOTE) {
+    voice_stealing = patch->voice_stealing;
+  }
+  glide_time_millis = patch->glide_time_millis > GLIDE_TIME_MAX_MILLIS ? GLIDE_TIME_MAX_MILLIS : patch->glide_time_millis;
+  legato_mode = (polyphony == 1) && (glide_time_millis > 0);
+  midi_pitch_bend_max_semitones = patch->pitch_bend_semitones;
+  detune_max_semitones = patch->detune_semitones;
+  for (byte i = 0; i < 3; i++) {
+    handle_voice_detune_change(i, patch->detunes[i] > 16383 ? 16383 : patch->detunes[i]);
+  }
+}
+
+void send_patch_dump(byte port) {
+  sysex_patch patch;
+  byte message[SYSEX_PATCH_MESSAGE_SIZE];
+
+  current_patch(&patch);
+  send_sysex(port, message, sysex_patch_message(&patch, message));
+}
+
+// `event` is a SysEx message from the parser: `data_one` is its length, and
+// `data_two` the port it came in on (see `read_midi_input()`). Loads and
+// anything we don't understand are acknowledged; dumps and acks (ours,
+// echoed back by a MIDI thru) are ignored, so two of us can't ack each other
+// forever.
+void handle_sysex(const midi_event *event) {
+  byte port = event->data_two;
+  midi_parser *parser = port == MIDI_PORT_USB ? &usb_midi_parser : &serial_midi_parser;
+  sysex_patch patch;
+  byte command = 0;
+  byte checksum = 0;
+
+  byte status = sysex_parse(parser->sysex, event->data_one, &command, &checksum, &patch);
+  midi_parser_release_sysex(parser);
+
+  if (status == SYSEX_STATUS_NOT_OURS || command == SYSEX_PATCH_DUMP || command == SYSEX_ACK) {
+    return;
+  }
+  if (command == SYSEX_PATCH_DUMP_REQUEST && status == SYSEX_STATUS_OK) {
+    send_patch_dump(port);
+    return;
+  }
+  if (command == SYSEX_PATCH_LOAD && status == SYSEX_STATUS_OK) {
+    apply_patch(&patch);
+  }
+
+  byte ack[SYSEX_ACK_MESSAGE_SIZE];
+  send_sysex(port, ack, sysex_ack_message(command, status, checksum, ack));
+}
+
 void handle_state_dump_request(bool human) {
   // for testing purposes, print the state of our sid representation, which
   // should (hopefully) mirror what the SID's registers are right now
 
   if (human) {
     #if DEBUG_LOGGING
-      printf("V#  WAVE     FREQ    DTUN   A      D      S    R      PW   TEST RING SYNC GATE FILT\n");
+      printf("V#  WAVE     FREQ    DTUN   A      D      S    R      PW   TEST RING SYNC GATE FILT ENV\n");
 
-      for (unsigned int i = 0; i < 3; i++) {
+      for (unsigned int i = 0; i < MAX_POLYPHONY; i++) {
         printf("V%u  ", i);
 
         byte wave = get_voice_waveform(i) << 4;
@@ -530,7 +957,7 @@ void handle_state_dump_request(bool human) {
         float_as_padded_string(float_string, f, 4, 2, '0');
         printf(" %s", float_string);
 
-        f = voice_detune_percents[i] * 100;
+        f = voice_detune_percent(i);
         float_as_padded_string(float_string, f, 3, 1, '0');
         printf(" %s%%", float_string);
 
@@ -552,13 +979,14 @@ void handle_state_dump_request(bool human) {
         printf(" %s", float_string);
 
         printf(
-          " %4u  %d    %d    %d    %d    %d\n",
+          " %4u  %d    %d    %d    %d    %d    %3u\n",
           get_voice_pulse_width(i),
           get_voice_test_bit(i),
           get_voice_ring_mod(i),
           get_voice_sync(i),
           get_voice_gate(i),
-          get_filter_enabled_for_voice(i)
+          get_filter_enabled_for_voice(i),
+          voice_envelope_level(i, note_ticks_from_millis(millis()))
         );
       }
 
@@ -572,7 +1000,12 @@ void handle_state_dump_request(bool human) {
       printf("\n");
 
       printf("Global Mode: %s\n", polyphony == 1 ? "Mono Unison" : "Paraphonic");
+      if (polyphony > 1) {
+        static const char *stealing[] = { "oldest", "quietest", "released first", "round robin", "same note" };
+        printf("Voice stealing: %s\n", stealing[voice_stealing]);
+      }
       if (polyphony == 1) {
+        printf("Note priority: %s\n", note_priority == NOTE_PRIORITY_LOWEST ? "lowest" : note_priority == NOTE_PRIORITY_HIGHEST ? "highest" : "last");
         printf("Glide enabled: %s", legato_mode ? "true" : "false");
         char str[12];
         float_as_padded_string(str, glide_time_millis, 2, 3, '0');
@@ -588,434 +1021,378 @@ void handle_state_dump_request(bool human) {
     #endif
 
     inspect_oscillator_notes();
-    deque_inspect(notes);
+    note_table_inspect(&held_notes, stdout);
+    log_register_writes();
   } else {
-    for (unsigned char i = 0; i < 25; i++) {
-      print_byte_in_binary(sid_state_bytes[i]);
-    }
+    send_patch_dump(MIDI_PORT_USB);
   }
 
   log_load_stats();
 }
 
-void handle_midi_input(Stream *midi_port) {
-  if (midi_port->available() > 0) {
-    byte incomingByte = midi_port->read();
-    byte opcode  = incomingByte >> 4;
-    byte channel = incomingByte & (0B00001111);
-    byte data_byte_one = 0;
-    byte data_byte_two = 0;
-    word pitchbend = 8192.0;
-    byte controller_number = 0;
-    byte controller_value = 0;
-
-    if (channel == MIDI_CHANNEL && opcode >= 0B1000 && opcode <= 0B1110) { // Voice/Mode Messages, on our channel
-      switch (opcode) {
-      case MIDI_CONTROL_CHANGE:
-        while (midi_port->available() <= 0) {}
-        controller_number = midi_port->read();
-        while (midi_port->available() <= 0) {}
-        controller_value = midi_port->read();
-
-        #if DEBUG_LOGGING
-          printf("[%lu] Received MIDI CC %u %u\n", time_in_micros, controller_number, controller_value);
-        #endif
-
-        switch (controller_number) {
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_SQUARE:
-          handle_voice_waveform_change(0, SID_SQUARE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_SQUARE:
-          handle_voice_waveform_change(1, SID_SQUARE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_SQUARE:
-          handle_voice_waveform_change(2, SID_SQUARE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_TRIANGLE:
-          handle_voice_waveform_change(0, SID_TRIANGLE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_TRIANGLE:
-          handle_voice_waveform_change(1, SID_TRIANGLE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_TRIANGLE:
-          handle_voice_waveform_change(2, SID_TRIANGLE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_RAMP:
-          handle_voice_waveform_change(0, SID_RAMP, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_RAMP:
-          handle_voice_waveform_change(1, SID_RAMP, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_RAMP:
-          handle_voice_waveform_change(2, SID_RAMP, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_NOISE:
-          handle_voice_waveform_change(0, SID_NOISE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_NOISE:
-          handle_voice_waveform_change(1, SID_NOISE, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_NOISE:
-          handle_voice_waveform_change(2, SID_NOISE, controller_value == 127);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_ONE:
-          // replaces the triangle output of voice 1 with a ring modulated combination of voice 1 by voice 3
-          handle_voice_ring_mod_change(0, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_TWO:
-          // replaces the triangle output of voice 2 with a ring modulated combination of voice 2 by voice 1
-          handle_voice_ring_mod_change(1, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_THREE:
-          // replaces the triangle output of voice 3 with a ring modulated combination of voice 3 by voice 2
-          handle_voice_ring_mod_change(2, controller_value == 127);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_ONE:
-          // hard-syncs frequency of voice 1 to voice 3
-          handle_voice_sync_change(0, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_TWO:
-          // hard-syncs frequency of voice 2 to voice 1
-          handle_voice_sync_change(1, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_THREE:
-          // hard-syncs frequency of voice 3 to voice 2
-          handle_voice_sync_change(2, controller_value == 127);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_TEST_VOICE_ONE:
-          handle_voice_test_change(0, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_TEST_VOICE_TWO:
-          handle_voice_test_change(1, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_TEST_VOICE_THREE:
-          handle_voice_test_change(2, controller_value == 127);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_ONE:
-          pw_v1 = ((word)controller_value) << 5;
-          pw_v1 += pw_v1_lsb;
-          handle_voice_pulse_width_change(0, pw_v1);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_TWO:
-          pw_v2 = ((word)controller_value) << 5;
-          pw_v2 += pw_v2_lsb;
-          handle_voice_pulse_width_change(1, pw_v2);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_THREE:
-          pw_v3 = ((word)controller_value) << 5;
-          pw_v3 += pw_v3_lsb;
-          handle_voice_pulse_width_change(2, pw_v3);
-          break;
-
-        // LSB messages will not trigger PW change on the SID!
-        // must be followed up by a MSB message to trigger a SID update w/ both
-        case MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_ONE:
-          pw_v1_lsb = controller_value & 0b00011111;
-          break;
-        case MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_TWO:
-          pw_v2_lsb = controller_value & 0b00011111;
-          break;
-        case MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_THREE:
-          pw_v3_lsb = controller_value & 0b00011111;
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_ONE:
-          handle_voice_attack_change(0, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_TWO:
-          handle_voice_attack_change(1, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_THREE:
-          handle_voice_attack_change(2, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_ONE:
-          handle_voice_decay_change(0, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_TWO:
-          handle_voice_decay_change(1, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_THREE:
-          handle_voice_decay_change(2, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_ONE:
-          handle_voice_sustain_change(0, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_TWO:
-          handle_voice_sustain_change(1, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_THREE:
-          handle_voice_sustain_change(2, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_ONE:
-          handle_voice_release_change(0, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_TWO:
-          handle_voice_release_change(1, controller_value >> 3);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_THREE:
-          handle_voice_release_change(2, controller_value >> 3);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_ONE:
-          handle_voice_filter_change(0, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_TWO:
-          handle_voice_filter_change(1, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_THREE:
-          handle_voice_filter_change(2, controller_value == 127);
-          break;
-
-        // LSB messages will not trigger change on the SID!
-        // must be followed up by a MSB message to trigger a SID update w/ both
-        case MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_ONE:
-          detune_v1_lsb = controller_value & 0B01111111;
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_TWO:
-          detune_v2_lsb = controller_value & 0B01111111;
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_THREE:
-          detune_v3_lsb = controller_value & 0B01111111;
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_ONE:
-          detune_v1_raw_word = ((word)controller_value & 0B01111111) << 7;
-          detune_v1_raw_word += detune_v1_lsb;
-          handle_voice_detune_change(0, ((detune_v1_raw_word / 16383.0) * 2 - 1));
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_TWO:
-          detune_v2_raw_word = ((word)controller_value & 0B01111111) << 7;
-          detune_v2_raw_word += detune_v2_lsb;
-          handle_voice_detune_change(1, ((detune_v2_raw_word / 16383.0) * 2 - 1));
-          break;
-        case MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_THREE:
-          detune_v3_raw_word = ((word)controller_value & 0B01111111) << 7;
-          detune_v3_raw_word += detune_v3_lsb;
-          handle_voice_detune_change(2, ((detune_v3_raw_word / 16383.0) * 2 - 1));
-          break;
-
-        case MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_LP:
-          sid_set_filter_mode(SID_FILTER_LP, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_BP:
-          sid_set_filter_mode(SID_FILTER_BP, controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_HP:
-          sid_set_filter_mode(SID_FILTER_HP, controller_value == 127);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY:
-          filter_frequency = (((word)controller_value) << 4) + filter_frequency_lsb;
-          sid_set_filter_frequency(filter_frequency);
-          break;
-        // same as PW LSB message, LSB will not trigger a SID update until we receive the MSB message next.
-        case MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY_LSB:
-          filter_frequency_lsb = (controller_value & 0b00001111);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_FILTER_RESONANCE:
-          controller_value = constrain(controller_value, 0, 15);
-          sid_set_filter_resonance(controller_value);
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_VOLUME:
-          sid_set_volume(controller_value >> 3);
-          break;
-
-        case MIDI_CONTROL_CHANGE_RPN_LSB:
-          rpn_value += (controller_value & 0b01111111);
-          break;
-
-        case MIDI_CONTROL_CHANGE_RPN_MSB:
-          rpn_value = ((word)controller_value) << 5;
-          break;
-
-        case MIDI_CONTROL_CHANGE_DATA_ENTRY:
-          data_entry = controller_value;
-          if (rpn_value == MIDI_RPN_PITCH_BEND_SENSITIVITY) {
-            midi_pitch_bend_max_semitones = data_entry;
-            detune_max_semitones = data_entry;
-          }
-          break;
-
-        case MIDI_CONTROL_CHANGE_TOGGLE_VOLUME_MODULATION_MODE:
-          volume_modulation_mode_active = (controller_value == 127);
-          break;
-        case MIDI_CONTROL_CHANGE_TOGGLE_PULSE_WIDTH_MODULATION_MODE:
-          if (controller_value == 127) {
-            enable_pulse_width_modulation_mode();
-          } else {
-            disable_pulse_width_modulation_mode();
-          }
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_GLIDE_TIME_LSB:
-          glide_time_raw_lsb = controller_value;
-          break;
-
-        case MIDI_CONTROL_CHANGE_SET_GLIDE_TIME: // controller_value is 7-bit
-          glide_time_raw_word = (((word)controller_value) << 7) + glide_time_raw_lsb;
-          glide_time_millis = ((glide_time_raw_word / 16383.0) * (GLIDE_TIME_MAX_MILLIS - GLIDE_TIME_MIN_MILLIS)) + GLIDE_TIME_MIN_MILLIS;
-          if (glide_time_millis <= GLIDE_TIME_MIN_MILLIS) {
-            glide_time_millis = 0;
-          }
-          legato_mode = (polyphony == 1) && (glide_time_millis > 0.01);
-          break;
-
-        case MIDI_CONTROL_CHANGE_TOGGLE_ALL_TEST_BITS:
-          sid_set_test(0, controller_value == 127);
-          sid_set_test(1, controller_value == 127);
-          sid_set_test(2, controller_value == 127);
-          break;
-
-        case 127:
-          if (controller_value == 127) {
-            handle_state_dump_request(true);
-          }
-          break;
-        }
-        break;
-      case MIDI_PROGRAM_CHANGE:
-        while (midi_port->available() <= 0) {}
-        data_byte_one = midi_port->read();
-
-        #if DEBUG_LOGGING
-          printf("[%lu] Received MIDI PC %u\n", time_in_micros, data_byte_one);
-        #endif
-
-        handle_program_change(data_byte_one);
-        break;
-
-      case MIDI_PITCH_BEND:
-        while (midi_port->available() <= 0) {}
-        data_byte_one = midi_port->read();
-        while (midi_port->available() <= 0) {}
-        data_byte_two = midi_port->read();
-        pitchbend = data_byte_two;
-        pitchbend = (pitchbend << 7);
-        pitchbend |= data_byte_one;
-
-        #if DEBUG_LOGGING
-          printf("[%lu] Received MIDI PB %u\n", time_in_micros, pitchbend);
-        #endif
-
-        handle_pitchbend_change(pitchbend);
-        break;
-      case MIDI_NOTE_ON:
-        while (midi_port->available() <= 0) {}
-        data_byte_one = midi_port->read();
-        while (midi_port->available() <= 0) {}
-        data_byte_two = midi_port->read(); // "velocity", which we don't use
-
-        #if DEBUG_LOGGING
-          printf("[%lu] Received MIDI Note On %u\n", time_in_micros, data_byte_one);
-        #endif
-
-        if (data_byte_one < 96) { // SID can't handle freqs > B7
-          handle_note_on(data_byte_one);
-        }
-        break;
-      case MIDI_NOTE_OFF:
-        while (midi_port->available() <= 0) {}
-        data_byte_one = midi_port->read();
-        while (midi_port->available() <= 0) {}
-        data_byte_two = midi_port->read(); // "velocity", which we don't use
-
-        #if DEBUG_LOGGING
-          printf("[%lu] Received MIDI Note Off %u\n", time_in_micros, data_byte_one);
-        #endif
-
-        if (data_byte_one < 96) { // SID can't handle freqs > B7
+// the per-voice CC handlers above, by kind (MIDI_CC_WAVEFORM to
+// MIDI_CC_RELEASE) and voice, all taking the CC's argument (the waveform bit
+// >> 4, for MIDI_CC_WAVEFORM) and its decoded value. Each template instance is in
+// here once, rather than inlined at every call site.
+typedef void (*voice_cc_handler)(byte argument, word value);
+
+template <byte VOICE>
+struct voice_cc {
+  static void waveform(byte argument, word value) { handle_voice_waveform_change<VOICE>(argument << 4, value); }
+  static void ring_mod(byte, word value) { handle_voice_ring_mod_change<VOICE>(value); }
+  static void sync(byte, word value) { handle_voice_sync_change<VOICE>(value); }
+  static void test(byte, word value) { handle_voice_test_change<VOICE>(value); }
+  static void filter(byte, word value) { handle_voice_filter_change<VOICE>(value); }
+  static void pulse_width(byte, word value) { handle_voice_pulse_width_change<VOICE>(value); }
+  static void attack(byte, word value) { handle_voice_attack_change<VOICE>(value); }
+  static void decay(byte, word value) { handle_voice_decay_change<VOICE>(value); }
+  static void sustain(byte, word value) { handle_voice_sustain_change<VOICE>(value); }
+  static void release(byte, word value) { handle_voice_release_change<VOICE>(value); }
+};
+
+#define VOICE_CC_HANDLERS(name) { voice_cc<0>::name, voice_cc<1>::name, voice_cc<2>::name }
+
+const voice_cc_handler voice_cc_handlers[MIDI_CC_RELEASE][3] PROGMEM = {
+  VOICE_CC_HANDLERS(waveform),
+  VOICE_CC_HANDLERS(ring_mod),
+  VOICE_CC_HANDLERS(sync),
+  VOICE_CC_HANDLERS(test),
+  VOICE_CC_HANDLERS(filter),
+  VOICE_CC_HANDLERS(pulse_width),
+  VOICE_CC_HANDLERS(attack),
+  VOICE_CC_HANDLERS(decay),
+  VOICE_CC_HANDLERS(sustain),
+  VOICE_CC_HANDLERS(release)
+};
+
+// sets the parameter `cc` is for to `decoded` (see `midi_cc_decode()`)
+void apply_control_change(midi_cc cc, word decoded) {
+  if (cc.kind >= MIDI_CC_WAVEFORM && cc.kind <= MIDI_CC_RELEASE) {
+    voice_cc_handler handler = (voice_cc_handler)pgm_read_ptr(&voice_cc_handlers[cc.kind - MIDI_CC_WAVEFORM][cc.voice]);
+    handler(cc.argument, decoded);
+    return;
+  }
+
+  switch (cc.kind) {
+  case MIDI_CC_DETUNE:
+    handle_voice_detune_change(cc.voice, decoded);
+    break;
+
+  case MIDI_CC_FILTER_MODE:
+    sid_set_filter_mode(cc.argument << 4, decoded);
+    break;
+  case MIDI_CC_FILTER_FREQUENCY:
+    sid_set_filter_frequency(decoded);
+    break;
+  case MIDI_CC_FILTER_RESONANCE:
+    sid_set_filter_resonance(decoded > 15 ? 15 : decoded);
+    break;
+  case MIDI_CC_VOLUME:
+    sid_set_volume(decoded);
+    break;
+
+  case MIDI_CC_GLIDE_TIME:
+    glide_time_millis = (((unsigned long)decoded * (GLIDE_TIME_MAX_MILLIS - GLIDE_TIME_MIN_MILLIS)) / 16383) + GLIDE_TIME_MIN_MILLIS;
+    if (glide_time_millis <= GLIDE_TIME_MIN_MILLIS) {
+      glide_time_millis = 0;
+    }
+    legato_mode = (polyphony == 1) && (glide_time_millis > 0);
+    break;
+
+  case MIDI_CC_RPN_LSB:
+    rpn_value += decoded;
+    break;
+  case MIDI_CC_RPN_MSB:
+    rpn_value = decoded << 5;
+    break;
+  case MIDI_CC_DATA_ENTRY:
+    data_entry = decoded;
+    if (rpn_value == MIDI_RPN_PITCH_BEND_SENSITIVITY) {
+      midi_pitch_bend_max_semitones = data_entry;
+      detune_max_semitones = data_entry;
+    }
+    break;
+
+  case MIDI_CC_VOLUME_MODULATION_MODE:
+    volume_modulation_mode_active = decoded;
+    break;
+  case MIDI_CC_PULSE_WIDTH_MODULATION_MODE:
+    if (decoded) {
+      enable_pulse_width_modulation_mode();
+    } else {
+      disable_pulse_width_modulation_mode();
+    }
+    break;
+
+  case MIDI_CC_ALL_TEST_BITS:
+    for (byte v = 0; v < SID_VOICES; v++) {
+      sid_set_test(v, decoded);
+    }
+    break;
+
+  case MIDI_CC_ALL_SOUND_OFF:
+    handle_all_sound_off();
+    break;
+  case MIDI_CC_RESET_ALL_CONTROLLERS:
+    handle_reset_all_controllers();
+    break;
+  case MIDI_CC_ALL_NOTES_OFF:
+    handle_all_notes_off();
+    break;
+
+  case MIDI_CC_STATE_DUMP:
+    if (decoded == MIDI_STATE_DUMP_HUMAN) {
+      handle_state_dump_request(true);
+    } else if (decoded == MIDI_STATE_DUMP_SYSEX) {
+      handle_state_dump_request(false);
+    } else if (decoded == MIDI_STATE_DUMP_RESET_TELEMETRY) {
+      sid_telemetry_reset();
+      midi_queue_reset_stats(&midi_events);
+      pending_ccs.merged = 0;
+      control_scheduler_reset_stats(&controls);
+    }
+    break;
+  }
+}
+
+// what CC `number` does comes from the table in src/midi_cc_table.h, which
+// also turns `value` into the parameter's value (scaled, or combined with its
+// LSB). LSB CCs are stored there and don't get this far.
+void handle_control_change(byte number, byte value) {
+  midi_cc cc = midi_cc_lookup(number);
+  word decoded = 0;
+
+  if (midi_cc_decode(&cc, value, midi_cc_slots, &decoded)) {
+    apply_control_change(cc, decoded);
+  }
+}
+
+void handle_midi_event(const midi_event *event) {
+  if (event->status == 0xF0) {
+    handle_sysex(event);
+    return;
+  }
+
+  byte opcode  = midi_event_opcode(event);
+  byte channel = midi_event_channel(event);
+  byte data_byte_one = event->data_one;
+  byte data_byte_two = event->data_two;
+  word pitchbend = 8192.0;
+  byte controller_number = 0;
+  byte controller_value = 0;
+
+  if (channel == MIDI_CHANNEL && opcode >= 0B1000 && opcode <= 0B1110) { // Voice/Mode Messages, on our channel
+    switch (opcode) {
+    case MIDI_CONTROL_CHANGE:
+      controller_number = data_byte_one;
+      controller_value = data_byte_two;
+
+      #if DEBUG_LOGGING
+        printf("[%lu] Received MIDI CC %u %u\n", time_in_micros, controller_number, controller_value);
+      #endif
+
+      handle_control_change(controller_number, controller_value);
+      break;
+    case MIDI_PROGRAM_CHANGE:
+      #if DEBUG_LOGGING
+        printf("[%lu] Received MIDI PC %u\n", time_in_micros, data_byte_one);
+      #endif
+
+      handle_program_change(data_byte_one);
+      break;
+
+    case MIDI_PITCH_BEND:
+      pitchbend = data_byte_two;
+      pitchbend = (pitchbend << 7);
+      pitchbend |= data_byte_one;
+
+      #if DEBUG_LOGGING
+        printf("[%lu] Received MIDI PB %u\n", time_in_micros, pitchbend);
+      #endif
+
+      handle_pitchbend_change(pitchbend);
+      break;
+    case MIDI_NOTE_ON:
+      #if DEBUG_LOGGING
+        printf("[%lu] Received MIDI Note On %u\n", time_in_micros, data_byte_one);
+      #endif
+
+      // velocity isn't used, except that 0 means note off: with running
+      // status, that's how most gear sends note offs
+      if (data_byte_one < 96) { // SID can't handle freqs > B7
+        if (data_byte_two == 0) {
           handle_note_off(data_byte_one);
+        } else {
+          handle_note_on(data_byte_one);
         }
-        break;
       }
+      break;
+    case MIDI_NOTE_OFF:
+      #if DEBUG_LOGGING
+        printf("[%lu] Received MIDI Note Off %u\n", time_in_micros, data_byte_one);
+      #endif
+
+      if (data_byte_one < 96) { // SID can't handle freqs > B7
+        handle_note_off(data_byte_one);
+      }
+      break;
     }
   }
 }
 
-// manually update oscillator frequencies to account for glide times
-void update_oscillator_frequencies() {
-  unsigned long start_time_micros = micros();
+// SysEx events get the port they came in on, so `handle_sysex()` knows which
+// buffer, and where to reply
+void queue_midi_event(midi_event *event, byte port, uint16_t now) {
+  if (event->status == 0xF0) {
+    event->data_two = port;
+  }
+  midi_queue_push(&midi_events, port, event, now);
+}
+
+// queues every complete message in whatever `midi_port` has buffered, and
+// leaves any partial one in `parser` for next time. Never waits for a byte.
+// Stops once the port's queue is full, so the rest waits in the port's buffer,
+// and after a SysEx message, until it's been handled and its buffer is free.
+void read_midi_input(Stream *midi_port, midi_parser *parser, byte port) {
+  uint16_t now = micros();
+  midi_event event;
+
+  while (!midi_queue_full(&midi_events, port) && !parser->sysex_pending && midi_port->available() > 0) {
+    if (midi_parser_feed(parser, midi_port->read(), &event)) {
+      queue_midi_event(&event, port, now);
+    }
+  }
+}
+
+// The same for USB, a packet at a time: every packet is at most one event, so
+// there's nothing to re-frame (see src/usb_midi_packet.h). Packets we don't
+// get to wait in the USB endpoint, and the host waits with them.
+void read_usb_midi_input() {
+  uint16_t now = micros();
+  midi_event event;
+
+  while (!midi_queue_full(&midi_events, MIDI_PORT_USB) && !usb_midi_parser.sysex_pending) {
+    midiEventPacket_t received = MidiUSB.read();
+    if (received.header == 0) {
+      break; // nothing left
+    }
+    usb_midi_packet packet = { received.header, { received.byte1, received.byte2, received.byte3 } };
+    if (usb_midi_packet_read(&usb_midi_parser, &packet, &event)) {
+      queue_midi_event(&event, MIDI_PORT_USB, now);
+    }
+  }
+}
+
+void apply_pending_control_changes() {
+  for (byte i = 0; i < pending_ccs.length; i++) {
+    apply_control_change(midi_cc_lookup(pending_ccs.numbers[i]), pending_ccs.values[i]);
+  }
+  midi_cc_coalescer_clear(&pending_ccs);
+}
+
+// If `event` is a CC on our channel that doesn't have to be applied in order
+// (a continuous CC, or an LSB: see `midi_cc_coalesce()`), holds on to it and
+// returns true. Anything else is left for `handle_midi_event()`.
+bool coalesce_control_change(const midi_event *event) {
+  if (midi_event_opcode(event) != MIDI_CONTROL_CHANGE || midi_event_channel(event) != MIDI_CHANNEL) {
+    return false;
+  }
 
+  midi_cc cc = midi_cc_lookup(event->data_one);
+  byte result = midi_cc_coalesce(&cc, event->data_one, event->data_two, midi_cc_slots, &pending_ccs);
+  if (result == MIDI_CC_COALESCE_FULL) {
+    apply_pending_control_changes();
+    result = midi_cc_coalesce(&cc, event->data_one, event->data_two, midi_cc_slots, &pending_ccs);
+  }
+  return result == MIDI_CC_COALESCE_HELD;
+}
+
+// runs whatever control tasks are due, and sends what they wrote now, rather
+// than at the end of the loop. Only for inside the loop's transaction.
+void run_control_tasks() {
+  if (control_scheduler_run(&controls) > 0) {
+    sid_commit();
+    sid_begin();
+  }
+}
+
+// Reads both ports, then applies the longest-waiting events: a few per loop,
+// not counting LSBs, which are only stored, or continuous CCs, which only
+// keep their latest value until the next event that has to stay in order
+// (e.g. a note) or the end of the loop.
+// So a burst of automation costs one write per parameter per loop, and
+// doesn't hold up notes.
+void handle_midi_input() {
+  midi_event event;
+  byte applied = 0;
+
+  read_usb_midi_input();
+  read_midi_input(&Serial1, &serial_midi_parser, MIDI_PORT_DIN);
+
+  while (applied < MIDI_EVENTS_PER_LOOP && midi_queue_pop(&midi_events, micros(), &event)) {
+    if (coalesce_control_change(&event)) {
+      continue;
+    }
+    apply_pending_control_changes(); // they came first
+    handle_midi_event(&event);
+    run_control_tasks(); // so a burst of events can't hold up modulation
+    applied++;
+  }
+  apply_pending_control_changes();
+}
+
+// manually update oscillator frequencies to account for glide times.
+// Integer only: glide progress is in 1/256ths, frequencies are register values.
+void update_oscillator_frequencies() {
   unsigned long glide_duration_so_far_millis = (time_in_micros - glide_start_time_micros) / 1000;
-  float glide_percentage_progress;
+  unsigned int glide_progress = 256;
 
-  if (glide_time_millis > 0) {
-    glide_percentage_progress = glide_duration_so_far_millis / glide_time_millis;
-  } else {
-    glide_percentage_progress = 1.0;
+  if (glide_time_millis > 0 && glide_duration_so_far_millis < glide_time_millis) {
+    glide_progress = (glide_duration_so_far_millis * 256) / glide_time_millis;
   }
-  float glide_frequency_distance = 0.0;
-  float glide_hertz_to_add = 0.0;
-  float from_hertz = 0.0;
-  float to_hertz = 0.0;
 
   for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
     byte voice_note = oscillator_notes[i].number;
     if (voice_note != 0) {
       byte note_target = glide_time_millis > 0 && glide_to != 0 ? glide_to : voice_note;
-      to_hertz = note_number_to_frequency(note_target) * voice_frequency_mods[i];
+      word to_frequency = sid_note_register_word(note_target, voice_pitch_offsets[i]);
 
-      if (glide_percentage_progress >= 1.0) { // don't over-glide
-        sid_set_voice_frequency(i, to_hertz);
-        last_glide_update_micros = micros();
+      if (glide_progress >= 256) { // don't over-glide
+        sid_set_voice_frequency_register(i, to_frequency);
         continue;
       }
 
-      from_hertz = note_number_to_frequency(glide_from) * voice_frequency_mods[i];
-      glide_frequency_distance = to_hertz - from_hertz;
-      glide_hertz_to_add = glide_frequency_distance * glide_percentage_progress;
-      sid_set_voice_frequency(i, from_hertz + glide_hertz_to_add);
-      last_glide_update_micros = micros();
+      word from_frequency = sid_note_register_word(glide_from, voice_pitch_offsets[i]);
+      long glide_distance = (long)to_frequency - (long)from_frequency;
+      sid_set_voice_frequency_register(i, from_frequency + (glide_distance * (long)glide_progress) / 256);
     }
   }
 }
 
 void clean_slate() {
-  memset(sid_state_bytes, 0, 25 * sizeof(*sid_state_bytes));
-  memset(voice_detune_percents, 0, MAX_POLYPHONY*sizeof(*voice_detune_percents));
-  deque_empty(notes);
+  memset(sid_state_bytes, 0, sizeof(sid_state_bytes));
+  memset(voice_detune_amounts, 0, MAX_POLYPHONY*sizeof(*voice_detune_amounts));
   nullify_notes_playing();
 
   #if DEBUG_LOGGING
-    unsigned int dq_bytes = sizeof(deque);
-    unsigned int ht_bytes = sizeof(hash_table);
-    unsigned int db_bytes = sizeof(maybe_hash_table_element) * notes->ht->max_size;
-
-    printf("bytes allocated for deque/hash: %u + %u + %u = %u\n", dq_bytes, ht_bytes, db_bytes, dq_bytes + ht_bytes + db_bytes);
+    printf("bytes for held notes: %u\n", (unsigned int)sizeof(note_table));
   #endif
 
   initialize_glide_state();
   polyphony = 1;
+  note_priority = NOTE_PRIORITY_LAST;
+  voice_stealing = VOICE_ALLOCATOR_RELEASED_FIRST;
   glide_time_millis = DEFAULT_GLIDE_TIME_MILLIS;
-  legato_mode = (polyphony == 1) && (glide_time_millis > 0.01);
+  legato_mode = (polyphony == 1) && (glide_time_millis > 0);
   midi_pitch_bend_max_semitones = 5;
-  current_pitchbend_amount = 0.0;
+  pitchbend_amount = 0;
   detune_max_semitones = 5;
-  pw_v1     = DEFAULT_PULSE_WIDTH;
-  pw_v1_lsb = 0;
-  pw_v2     = DEFAULT_PULSE_WIDTH;
-  pw_v2_lsb = 0;
-  pw_v3     = DEFAULT_PULSE_WIDTH;
-  pw_v3_lsb = 0;
-  detune_v1_raw_word = 8192;
-  detune_v1_lsb      = 0;
-  detune_v2_raw_word = 8192;
-  detune_v2_lsb      = 0;
-  detune_v3_raw_word = 8192;
-  detune_v3_lsb      = 0;
-  filter_frequency = DEFAULT_FILTER_FREQUENCY;
-  filter_frequency_lsb = 0;
+  update_voice_pitch_offsets();
+  memset(midi_cc_slots, 0, sizeof(midi_cc_slots));
   rpn_value = 0;
   data_entry = 0;
   volume_modulation_mode_active = false;
   pulse_width_modulation_mode_active = false;
-  last_update = 0;
 
   sid_zero_all_registers();
   reset_voice_waveforms_to_default();
@@ -1031,35 +1408,22 @@ void clean_slate() {
   sid_set_volume(DEFAULT_VOLUME);
 }
 
-void setup() {
-  setup_stdin_stdout();
-  notes->stream = stdout;
-
-  DDRF |= 0B01110011; // initialize 5 PORTF pins as output (connected to A0-A4)
-  DDRB = 0B11111111; // initialize 8 PORTB pins as output (connected to D0-D7)
-  // technically SID allows us to read from its last 4 registers, but we don't
-  // need to, so we just always keep SID's R/W pin low (signifying "write"),
-  // which seems to work ok
-
-  pinMode(ARDUINO_SID_MASTER_CLOCK_PIN, OUTPUT);
-  pinMode(ARDUINO_SID_CHIP_SELECT_PIN, OUTPUT);
-  start_clock();
-  cs_high();
+// SID has a bug where its oscillators sometimes "leak" the sound of previous
+// notes. To work around this, we have to set each oscillator's frequency to 0
+// only when we are certain it's past its ADSR time. `voice_envelopes` worked
+// out when that is at note off, so this is a compare per voice.
+void envelope_task() {
+  note_ticks now_ticks = note_ticks_from_millis(millis());
 
-  clean_slate();
-}
-
-void loop () {
-  time_in_micros = micros();
-  time_in_seconds = (unsigned long) (time_in_micros / 1000000.0);
+  for (unsigned char i = 0; i < MAX_POLYPHONY; i++) {
+    // held notes can outlive 16-bit timestamps; their envelopes are in sustain
+    // long before NOTE_TICKS_MAX_AGE anyway
+    note_ticks_clamp_age(&oscillator_notes[i].on_time, now_ticks);
+    envelope_clamp_age(&voice_envelopes[i], now_ticks);
 
-  // SID has a bug where its oscillators sometimes "leak" the sound of previous
-  // notes. To work around this, we have to set each oscillator's frequency to 0
-  // only when we are certain it's past its ADSR time.
-  for (unsigned char i = 0; i < 3; i++) {
-    if (oscillator_notes[i].off_time > 0 && (time_in_micros > (oscillator_notes[i].off_time + get_release_seconds(i) * 1000000.0))) {
+    if (oscillator_notes[i].off_time != 0 && envelope_silent(&voice_envelopes[i], now_ticks)) {
       // we're past the release phase, so the voice can't be making any noise, so we must "fully" silence it
-      sid_set_voice_frequency(i, 0);
+      sid_set_voice_frequency_register(i, 0);
       oscillator_notes[i].on_time = 0;
       oscillator_notes[i].off_time = 0;
 
@@ -1067,96 +1431,154 @@ void loop () {
         printf("leak detector deleted note: %u\n", oscillator_notes[i].number);
       #endif
 
-      deque_remove_by_key(notes, oscillator_notes[i].number);
+      note_table_remove(&held_notes, oscillator_notes[i].number);
       oscillator_notes[i].number = 0;
+      voice_allocator_free(&voices, i);
     }
   }
+}
 
-  if (legato_mode &&
-      glide_time_millis > 0 &&
-      (oscillator_notes[0].number != 0 || oscillator_notes[1].number != 0 || oscillator_notes[2].number != 0 ) &&
-      ((last_glide_update_micros + UPDATE_EVERY_MICROS) <= time_in_micros))
-  {
+// glide is worked out from how long it's been going, so this only sets how
+// smooth it is
+void glide_task() {
+  if (legato_mode && glide_time_millis > 0 && any_oscillator_playing()) {
+    time_in_micros = micros();
     update_oscillator_frequencies();
   }
+}
 
-  // if any notes are playing in `volume_modulation_mode`, we have to implement
-  // ADSR stuff on our own.
-  if (
-    volume_modulation_mode_active &&
-    (oscillator_notes[0].number != 0 || oscillator_notes[1].number != 0 || oscillator_notes[2].number != 0 ) &&
-    ((time_in_micros - last_update) > UPDATE_EVERY_MICROS)) {
-    double volume = 0;
-    int oscillator_notes_count = 0;
-    for (int i = 0; i < 3; i++) {
-      oscillator_notes[i].number != 0 && oscillator_notes_count++;
-    }
+// retunes `voice_oscillators[voice]` if its note or pitch offset has changed
+// since the last time
+void tune_voice_oscillator(byte voice) {
+  byte note = oscillator_notes[voice].number;
+  long pitch_offset = voice_pitch_offsets[voice];
 
-    for (int i = 0; i < oscillator_notes_count; i++) {
-      int note = oscillator_notes[i].number;
-
-      if (note != 0) {
-        double note_frequency = note_number_to_frequency(note);
-        note_frequency = note_frequency * voice_frequency_mods[i];
-
-        double yt = sine_waveform(note_frequency, time_in_seconds, 0.5, 0);
-        yt *= linear_envelope(
-          get_attack_seconds(i),
-          get_decay_seconds(i),
-          get_sustain_percent(i),
-          get_release_seconds(i),
-          (time_in_micros - oscillator_notes[i].on_time) / 1000000.0,
-          -1
-        );
+  if (note != voice_oscillator_notes[voice] || pitch_offset != voice_oscillator_pitch_offsets[voice]) {
+    dds_set_register_word(&voice_oscillators[voice], sid_note_register_word(note, pitch_offset), MODULATION_TICK_MICROS);
+    voice_oscillator_notes[voice] = note;
+    voice_oscillator_pitch_offsets[voice] = pitch_offset;
+  }
+}
 
-        volume += (((yt + 0.5) * 15) / oscillator_notes_count);
-        // `+ 0.5` // center around 0
-        // `* 15`  // expand to [0..15]
-        // `/ 3`   // make room for potentially summing three voices together
-      }
+// the next sample of `voice`'s modulation waveform, shaped by its envelope:
+// [-127..126]. `ticks` is how many modulation ticks it's been since the last.
+int modulation_sample(byte voice, uint16_t ticks) {
+  tune_voice_oscillator(voice);
+  if (ticks > 1) {
+    dds_skip(&voice_oscillators[voice], ticks - 1); // the loop fell behind
+  }
+  return (dds_tick(&voice_oscillators[voice], DDS_SINE) * voice_modulation_levels[voice]) >> 8;
+}
+
+// the modulation modes' software envelopes and waveforms. Runs at audio rate
+// (see MODULATION_PERIOD_MICROS), so it's integer only.
+void modulation_task() {
+  uint16_t ticks = (controls.now - last_modulation_tick) / CONTROL_TICKS(MODULATION_PERIOD_MICROS);
+  last_modulation_tick = controls.now;
+
+  if (!(volume_modulation_mode_active || pulse_width_modulation_mode_active) || !any_oscillator_playing()) {
+    return;
+  }
+
+  note_ticks now_ticks = note_ticks_from_millis(millis());
+  if (now_ticks != voice_modulation_levels_at) {
+    for (byte i = 0; i < MAX_POLYPHONY; i++) {
+      voice_modulation_levels[i] = voice_envelope_level(i, now_ticks);
     }
+    voice_modulation_levels_at = now_ticks;
+  }
 
-    sid_set_volume((byte)volume);
-    last_update = micros();
+  // one sample per voice, whichever modes use it
+  int samples[MAX_POLYPHONY];
+  byte oscillator_notes_count = 0;
+  for (byte i = 0; i < MAX_POLYPHONY; i++) {
+    if (oscillator_notes[i].number != 0) {
+      samples[i] = modulation_sample(i, ticks);
+      oscillator_notes_count++;
+    }
   }
 
-  // same with `pulse_width_modulation_mode`
-  if (
-    pulse_width_modulation_mode_active &&
-    (oscillator_notes[0].number != 0 || oscillator_notes[1].number != 0 || oscillator_notes[2].number != 0 ) &&
-    ((time_in_micros - last_update) > UPDATE_EVERY_MICROS)) {
-    int oscillator_notes_count = 0;
-    for (int i = 0; i < 3; i++) {
+  // if any notes are playing in `volume_modulation_mode`, we have to implement
+  // ADSR stuff on our own.
+  if (volume_modulation_mode_active && oscillator_notes_count > 0) {
+    word mix = 0;
+    for (byte i = 0; i < MAX_POLYPHONY; i++) {
       if (oscillator_notes[i].number != 0) {
-        oscillator_notes_count++;
+        mix += samples[i] + 127; // centered on 127, so [0..253]
       }
     }
 
-    for (int i = 0; i < oscillator_notes_count; i++) {
-      int note = oscillator_notes[i].number;
-      double note_frequency = note_number_to_frequency(note);
-      note_frequency = note_frequency * voice_frequency_mods[i];
-
-      if (note != 0) {
-        double yt = sine_waveform(note_frequency, time_in_seconds, 0.5, 0);
-        yt *= linear_envelope(
-          get_attack_seconds(i),
-          get_decay_seconds(i),
-          get_sustain_percent(i),
-          get_release_seconds(i),
-          (time_in_micros - oscillator_notes[i].on_time) / 1000000.0,
-          -1
-        );
+    // [0..15], whether it's one voice or all of them
+    sid_set_volume(((uint32_t)mix * volume_modulation_scales[oscillator_notes_count]) >> 16);
+  }
 
-        sid_set_pulse_width(i, 4095.0 * yt);
+  // same with `pulse_width_modulation_mode`, around a 50% duty cycle. Only
+  // the 4-bit high byte moves (the low byte stays 0, so it's never rewritten),
+  // which keeps it to one write per voice: see MODULATION_WRITES_PER_TICK
+  if (pulse_width_modulation_mode_active) {
+    for (byte i = 0; i < MAX_POLYPHONY; i++) {
+      if (oscillator_notes[i].number != 0) {
+        sid_set_pulse_width(i, (word)(8 + (samples[i] >> 4)) << 8);
       }
     }
+  }
+}
+
+void setup() {
+  setup_stdin_stdout();
+  sid_bus = &avr_port_transport;
+  note_table_empty(&held_notes);
+  midi_parser_initialize(&usb_midi_parser);
+  midi_parser_initialize(&serial_midi_parser);
+  midi_parser_set_sysex_buffer(&usb_midi_parser, usb_sysex_buffer, sizeof(usb_sysex_buffer));
+  midi_parser_set_sysex_buffer(&serial_midi_parser, serial_sysex_buffer, sizeof(serial_sysex_buffer));
+  midi_queue_empty(&midi_events);
+  midi_cc_coalescer_initialize(&pending_ccs);
 
-    last_update = micros();
+  DDRF |= 0B01110011; // initialize 5 PORTF pins as output (connected to A0-A4)
+  DDRB = 0B11111111; // initialize 8 PORTB pins as output (connected to D0-D7)
+  // technically SID allows us to read from its last 4 registers, but we don't
+  // need to, so we just always keep SID's R/W pin low (signifying "write"),
+  // which seems to work ok
+
+  pinMode(ARDUINO_SID_MASTER_CLOCK_PIN, OUTPUT);
+  start_clock();
+
+  // every chip shares the bus, so every chip must be deselected before the
+  // first write to any of them
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    pinMode(ARDUINO_SID_CHIP_SELECT_PINS[chip], OUTPUT);
+    cs_high(chip);
+  }
+
+  clean_slate();
+
+  // from here on, register writes go through the queue
+  sid_queue_empty(&sid_write_queue);
+  start_bus_queue_timer();
+  sid_queue_enabled = true;
+
+  for (byte voices = 1; voices <= MAX_POLYPHONY; voices++) {
+    volume_modulation_scales[voices] = (15UL * 65536 + 253 * voices - 1) / (253 * voices);
   }
 
-  USBMIDI.poll();
+  control_scheduler_initialize(&controls);
+  control_scheduler_add(&controls, envelope_task, CONTROL_TICKS(ENVELOPE_PERIOD_MICROS));
+  control_scheduler_add(&controls, glide_task, CONTROL_TICKS(GLIDE_PERIOD_MICROS));
+  control_scheduler_add(&controls, modulation_task, CONTROL_TICKS(MODULATION_PERIOD_MICROS));
+  start_control_timer();
+}
+
+void loop () {
+  time_in_micros = micros();
+
+  // everything below only updates our register shadow; the SID sees each
+  // changed register once, at `sid_commit()` (or sooner, if a control task
+  // runs: see `run_control_tasks()`)
+  sid_begin();
+
+  run_control_tasks();
+  handle_midi_input();
 
-  handle_midi_input(&USBMIDI);
-  handle_midi_input(&Serial1);
+  sid_commit();
 }
@@ -0,0 +1,56 @@
+#ifndef BENCH_HELPER_H
+#define BENCH_HELPER_H
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define bench_cycles() __rdtsc()
+#else
+#define bench_cycles() 0ULL
+#endif
+
+// Host-side micro benchmarks. These don't predict AVR cycle counts, but they
+// do show relative costs between two implementations of the same thing.
+//
+// Each result is printed as one JSON object per line, so `make bench` output
+// can be diffed or fed to a script. `make bench` runs them with BENCH_COMMIT
+// set to the current commit, so lines from different commits in
+// bench_output.txt can be told apart.
+
+volatile uint32_t BENCH_SINK = 0; // keeps the optimizer from dropping work
+
+static double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// `extra` is more JSON fields (`"a": 1, "b": 2`) to put on the line, or ""
+static void bench_print(const char *name, unsigned long iterations, double ns, double cycles, const char *extra) {
+  const char *commit = getenv("BENCH_COMMIT");
+  printf("{\"bench\": \"%s\", \"commit\": \"%s\", \"iterations\": %lu, "
+         "\"ns_per_op\": %.2f, \"cycles_per_op\": %.1f%s%s}\n",
+         name, commit ? commit : "unknown", iterations, ns / iterations, cycles / iterations,
+         extra[0] ? ", " : "", extra);
+}
+
+#define bench_run_extra(name, iterations, body, extra) {                       \
+  double _start_ns = bench_now_ns();                                           \
+  unsigned long long _start_cycles = bench_cycles();                           \
+  for (unsigned long _i = 0; _i < (iterations); _i++) {                        \
+    body;                                                                      \
+  }                                                                            \
+  unsigned long long _cycles = bench_cycles() - _start_cycles;                 \
+  double _ns = bench_now_ns() - _start_ns;                                     \
+  bench_print((name), (iterations), _ns, (double)_cycles, (extra));            \
+}
+
+#define bench_run(name, iterations, body) bench_run_extra(name, iterations, body, "")
+
+#endif /* BENCH_HELPER_H */
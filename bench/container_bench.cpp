@@ -0,0 +1,184 @@
+#include "bench_helper.h"
+#include <new>
+#include "note_patterns.h"
+#include "../src/deque.h"
+
+// per-op cost of the held-note containers.
+//
+// The first three are a window of ~10 keys sliding through the note range, so
+// sets, removes and lookups all hit collisions. The rest replay the patterns
+// in note_patterns.h, and `BENCH_NOTE_RECORDING=path make bench` adds one
+// read from a file. Each replay also reports, from one untimed pass over the
+// pattern:
+// - max_probe/mean_probe: how far elements sat from their home slot
+// - full: note-ons the hash table refused, or the deque evicted for
+// - allocations: heap allocations during the timed run (should stay 0)
+// - bytes: the container's size
+
+const unsigned long ITERATIONS = 2000000;
+
+static unsigned long ALLOCATIONS = 0;
+
+void *operator new(size_t size) {
+  ALLOCATIONS++;
+  void *p = malloc(size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+static hash_table<unsigned char, note, 16> table;
+static deque<note, 16> notes;
+static note_pattern pattern;
+
+struct probe_stats {
+  unsigned int max;
+  unsigned long total; // summed over every element after every event
+  unsigned long elements;
+  unsigned long full;
+};
+
+template <typename V, unsigned int N>
+static void probe_stats_add(probe_stats *stats, const hash_table<unsigned char, V, N> *h) {
+  for (unsigned int slot = 0; slot < h->max_size; slot++) {
+    if (hash_table_slot_used(h, slot)) {
+      unsigned int length = hash_table_probe_length(h, slot);
+      stats->total += length;
+      stats->elements++;
+      stats->max = length > stats->max ? length : stats->max;
+    }
+  }
+}
+
+static void format_extra(char *extra, size_t size, const probe_stats *stats, unsigned long allocations, size_t bytes) {
+  snprintf(extra, size, "\"events\": %u, \"max_probe\": %u, \"mean_probe\": %.2f, \"full\": %lu, \"allocations\": %lu, \"bytes\": %lu",
+           pattern.length, stats->max, stats->elements ? (double)stats->total / stats->elements : 0.0,
+           stats->full, allocations, (unsigned long)bytes);
+}
+
+static void replay_hash_table() {
+  char name[64];
+  char extra[256];
+  probe_stats stats = {};
+  note n = { .number=0 };
+
+  hash_table_empty(&table);
+  for (unsigned int i = 0; i < pattern.length; i++) {
+    n.number = pattern.events[i].number;
+    if (pattern.events[i].on) {
+      stats.full += hash_table_set(&table, n.number, n) == NULL;
+    } else {
+      hash_table_remove(&table, n.number);
+    }
+    probe_stats_add(&stats, &table);
+  }
+
+  hash_table_empty(&table);
+  unsigned long allocations_before = ALLOCATIONS;
+  snprintf(name, sizeof(name), "hash_table/%s", pattern.name);
+  bench_run_extra(name, ITERATIONS, {
+    const note_event *event = &pattern.events[_i % pattern.length];
+    n.number = event->number;
+    if (event->on) {
+      BENCH_SINK += hash_table_set(&table, event->number, n) == NULL;
+    } else {
+      BENCH_SINK += hash_table_remove(&table, event->number).exists;
+    }
+  }, (format_extra(extra, sizeof(extra), &stats, ALLOCATIONS - allocations_before, sizeof(table)), extra));
+}
+
+static void replay_deque() {
+  char name[64];
+  char extra[256];
+  probe_stats stats = {};
+  note n = { .number=0 };
+
+  deque_empty(&notes);
+  for (unsigned int i = 0; i < pattern.length; i++) {
+    n.number = pattern.events[i].number;
+    if (pattern.events[i].on) {
+      bool evicts = deque_length(&notes) == notes.max_length && !deque_find_by_key(&notes, n.number);
+      stats.full += evicts;
+      deque_append_replace(&notes, n);
+    } else {
+      deque_remove_by_key(&notes, n.number);
+    }
+    probe_stats_add(&stats, &notes.ht);
+  }
+
+  deque_empty(&notes);
+  unsigned long allocations_before = ALLOCATIONS;
+  snprintf(name, sizeof(name), "deque/%s", pattern.name);
+  bench_run_extra(name, ITERATIONS, {
+    const note_event *event = &pattern.events[_i % pattern.length];
+    n.number = event->number;
+    if (event->on) {
+      deque_append_replace(&notes, n);
+    } else {
+      BENCH_SINK += deque_remove_by_key(&notes, event->number).exists;
+    }
+  }, (format_extra(extra, sizeof(extra), &stats, ALLOCATIONS - allocations_before, sizeof(notes)), extra));
+}
+
+static void replay() {
+  replay_hash_table();
+  replay_deque();
+}
+
+int main() {
+  note n = { .number=0 };
+
+  hash_table_initialize(&table);
+  bench_run("hash_table_set+remove", ITERATIONS, {
+    unsigned char key = (_i * 7) % 96;
+    hash_table_set(&table, key, n);
+    if (table.size > 10) {
+      hash_table_remove(&table, (key + 96 - 70) % 96);
+    }
+  });
+
+  hash_table_empty(&table);
+  for (unsigned int key = 0; key < 10; key++) {
+    hash_table_set(&table, key * 5, n);
+  }
+  bench_run("hash_table_get", ITERATIONS, {
+    BENCH_SINK += hash_table_get(&table, (_i * 5) % 60) != NULL;
+  });
+
+  deque_initialize(&notes, stdout, _note_indexer, _note_node_print_function);
+  bench_run("deque_append+remove_by_key", ITERATIONS, {
+    n.number = (_i * 7) % 96;
+    deque_append_replace(&notes, n);
+    if (deque_length(&notes) > 10) {
+      deque_remove_by_key(&notes, (n.number + 96 - 70) % 96);
+    }
+  });
+
+  note_pattern_trill(&pattern);
+  replay();
+  note_pattern_chords(&pattern);
+  replay();
+  note_pattern_pads(&pattern);
+  replay();
+
+  const char *recording = getenv("BENCH_NOTE_RECORDING");
+  if (recording && recording[0]) {
+    if (note_pattern_read(&pattern, recording)) {
+      replay();
+    } else {
+      fprintf(stderr, "couldn't read any notes from %s\n", recording);
+      return 1;
+    }
+  }
+
+  return 0;
+}
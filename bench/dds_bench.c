@@ -0,0 +1,28 @@
+#include "bench_helper.h"
+#include "../src/dds.h"
+
+// the modulation modes' sine, per voice per tick: float `sine_waveform()` vs.
+// a DDS tick
+
+const unsigned long ITERATIONS = 4000000;
+
+#define TICK_MICROS 64
+
+int main() {
+  dds_oscillator o;
+  dds_reset(&o);
+  dds_set_register_word(&o, 7382, TICK_MICROS); // A4
+
+  bench_run("modulation_sine/float", ITERATIONS, {
+    BENCH_SINK += (int)(127 * sine_waveform(440.0, _i * (TICK_MICROS / 1000000.0), 1.0, 0.0));
+  });
+  bench_run("modulation_sine/dds", ITERATIONS, {
+    BENCH_SINK += dds_tick(&o, DDS_SINE);
+  });
+  bench_run("modulation_sine/dds_with_increment", ITERATIONS, {
+    dds_set_register_word(&o, 7382 + (_i & 7), TICK_MICROS);
+    BENCH_SINK += dds_tick(&o, DDS_SINE);
+  });
+
+  return 0;
+}
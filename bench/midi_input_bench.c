@@ -0,0 +1,75 @@
+#include "bench_helper.h"
+#include "../src/usb_midi_packet.h"
+
+// USB-MIDI packets: flattened to bytes and re-parsed (what the USBMIDI
+// library's stream made us do) vs. decoded a packet at a time. Per packet,
+// i.e. per event for everything but SysEx.
+
+const unsigned long ITERATIONS = 4000000;
+
+#define PACKETS 8
+
+// a note, some CCs, a bend and a clock, the way a sequencer sends them
+static const usb_midi_packet TRAFFIC[PACKETS] = {
+  { 0x09, { 0x90, 60, 100 } },
+  { 0x0B, { 0xB0, 36, 64 } },
+  { 0x0B, { 0xB0, 44, 10 } },
+  { 0x0E, { 0xE0, 0x00, 0x40 } },
+  { 0x0F, { 0xF8, 0, 0 } },
+  { 0x0B, { 0xB0, 36, 65 } },
+  { 0x0C, { 0xC0, 3, 0 } },
+  { 0x08, { 0x80, 60, 0 } },
+};
+
+// a 49-byte patch dump's worth of SysEx packets
+#define SYSEX_PACKETS 17
+static usb_midi_packet SYSEX[SYSEX_PACKETS];
+
+static bool read_as_bytes(midi_parser *p, const usb_midi_packet *packet, midi_event *event) {
+  bool complete = false;
+  byte length = usb_midi_packet_length(packet);
+  for (byte i = 0; i < length; i++) {
+    complete = midi_parser_feed(p, packet->bytes[i], event) || complete;
+  }
+  return complete;
+}
+
+int main() {
+  midi_parser p;
+  midi_event event = { 0, 0, 0 };
+  byte buffer[64];
+  byte message[49] = { 0xF0, 0x7D, 0x01 };
+  message[48] = 0xF7;
+
+  for (byte offset = 0, i = 0; offset < sizeof(message); i++) {
+    offset += usb_midi_sysex_packet(message, sizeof(message), offset, &SYSEX[i]);
+  }
+
+  midi_parser_initialize(&p);
+  bench_run("usb_midi_events/bytes", ITERATIONS, {
+    BENCH_SINK += read_as_bytes(&p, &TRAFFIC[_i % PACKETS], &event) + event.data_two;
+  });
+  midi_parser_initialize(&p);
+  bench_run("usb_midi_events/packets", ITERATIONS, {
+    BENCH_SINK += usb_midi_packet_read(&p, &TRAFFIC[_i % PACKETS], &event) + event.data_two;
+  });
+
+  midi_parser_initialize(&p);
+  midi_parser_set_sysex_buffer(&p, buffer, sizeof(buffer));
+  bench_run("usb_midi_sysex/bytes", ITERATIONS, {
+    if (read_as_bytes(&p, &SYSEX[_i % SYSEX_PACKETS], &event)) {
+      midi_parser_release_sysex(&p);
+    }
+    BENCH_SINK += p.sysex_length;
+  });
+  midi_parser_initialize(&p);
+  midi_parser_set_sysex_buffer(&p, buffer, sizeof(buffer));
+  bench_run("usb_midi_sysex/packets", ITERATIONS, {
+    if (usb_midi_packet_read(&p, &SYSEX[_i % SYSEX_PACKETS], &event)) {
+      midi_parser_release_sysex(&p);
+    }
+    BENCH_SINK += p.sysex_length;
+  });
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef BENCH_NOTE_PATTERNS_H
+#define BENCH_NOTE_PATTERNS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Note-on/off streams to replay against the held-note containers, shaped like
+// what a player actually sends:
+// - trill: two notes alternating fast, each struck before the other lets go
+// - chords: 10 fingers down, then all up, moving around the keyboard
+// - pads: long notes that mostly aren't released, so a 16-note container has
+//   to evict to keep up
+// or a recording: a text file with one `on <note>` or `off <note>` per line.
+
+#define NOTE_PATTERN_MAX_EVENTS 4096
+
+struct note_event {
+  bool on;
+  unsigned char number;
+};
+typedef struct note_event note_event;
+
+struct note_pattern {
+  const char *name;
+  unsigned int length;
+  note_event events[NOTE_PATTERN_MAX_EVENTS];
+};
+typedef struct note_pattern note_pattern;
+
+static void _note_pattern_add(note_pattern *p, bool on, unsigned int number) {
+  if (p->length < NOTE_PATTERN_MAX_EVENTS) {
+    p->events[p->length++] = { on, (unsigned char)(number & 0x7F) };
+  }
+}
+
+// 60 and 62, then the next pair up, a semitone at a time
+void note_pattern_trill(note_pattern *p) {
+  p->name = "trill";
+  p->length = 0;
+  for (unsigned int pair = 0; pair < 24; pair++) {
+    unsigned int low = 48 + pair;
+    unsigned int high = low + 2;
+    _note_pattern_add(p, true, low);
+    for (unsigned int beat = 0; beat < 16; beat++) {
+      unsigned int struck = beat & 1 ? low : high;
+      unsigned int released = beat & 1 ? high : low;
+      _note_pattern_add(p, true, struck);
+      _note_pattern_add(p, false, released);
+    }
+    _note_pattern_add(p, false, low);
+  }
+}
+
+// two hands of five, rolled on and released in a different order
+void note_pattern_chords(note_pattern *p) {
+  static const unsigned char voicing[10] = { 0, 4, 7, 11, 14, 24, 28, 31, 35, 38 };
+
+  p->name = "chords";
+  p->length = 0;
+  for (unsigned int chord = 0; chord < 64; chord++) {
+    unsigned int root = 24 + (chord * 5) % 48; // round the circle of fourths
+    for (unsigned int finger = 0; finger < 10; finger++) {
+      _note_pattern_add(p, true, root + voicing[finger]);
+    }
+    for (unsigned int finger = 0; finger < 10; finger++) {
+      _note_pattern_add(p, false, root + voicing[(finger * 3) % 10]);
+    }
+  }
+}
+
+// a new pad note every step, and only one in four ever released: more notes
+// held than any 16-note container fits
+void note_pattern_pads(note_pattern *p) {
+  p->name = "pads";
+  p->length = 0;
+  for (unsigned int step = 0; step < 1024; step++) {
+    unsigned int number = 36 + (step * 7) % 60;
+    _note_pattern_add(p, true, number);
+    if (step % 4 == 3) {
+      _note_pattern_add(p, false, 36 + ((step - 2) * 7) % 60);
+    }
+  }
+}
+
+// returns false if `path` can't be read or has no events in it
+bool note_pattern_read(note_pattern *p, const char *path) {
+  FILE *stream = fopen(path, "r");
+  if (!stream) {
+    return false;
+  }
+
+  char kind[4];
+  unsigned int number;
+
+  p->name = "recording";
+  p->length = 0;
+  while (fscanf(stream, "%3s %u", kind, &number) == 2) {
+    _note_pattern_add(p, kind[1] == 'n', number);
+  }
+  fclose(stream);
+
+  return p->length > 0;
+}
+
+#endif /* BENCH_NOTE_PATTERNS_H */
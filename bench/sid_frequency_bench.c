@@ -0,0 +1,30 @@
+#include "bench_helper.h"
+#include "../src/sid.h"
+
+// float (the old note-on/pitchbend path) vs. integer register words
+
+void sid_bus_drain_start() {}
+
+const unsigned long ITERATIONS = 2000000;
+
+static word float_register_word(byte note, long pitch_offset) {
+  float hertz = note_number_to_frequency(note) * pow(2, pitch_offset / (float)SID_PITCH_OFFSET_OCTAVE);
+  return round(hertz / CLOCK_SIGNAL_FACTOR);
+}
+
+int main() {
+  bench_run("note_register_word/float", ITERATIONS, {
+    BENCH_SINK += float_register_word(_i % 96, 0);
+  });
+  bench_run("note_register_word/integer", ITERATIONS, {
+    BENCH_SINK += sid_note_register_word(_i % 96, 0);
+  });
+  bench_run("bent_register_word/float", ITERATIONS, {
+    BENCH_SINK += float_register_word(_i % 72, (long)(_i % 1024) - 512);
+  });
+  bench_run("bent_register_word/integer", ITERATIONS, {
+    BENCH_SINK += sid_note_register_word(_i % 72, (long)(_i % 1024) - 512);
+  });
+
+  return 0;
+}
@@ -0,0 +1,23 @@
+#include "bench_helper.h"
+#include "../src/sid.h"
+
+// runtime voice setters vs. sid_voice<V>'s compile-time addresses
+
+void sid_bus_drain_start() {}
+
+const unsigned long ITERATIONS = 2000000;
+
+int main() {
+  bench_run("voice_setters/runtime", ITERATIONS, {
+    sid_set_attack(2, _i);
+    sid_set_gate(2, _i & 1);
+    sid_set_pulse_width(2, _i);
+  });
+  bench_run("voice_setters/compile_time", ITERATIONS, {
+    sid_voice<2>::set_attack(_i);
+    sid_voice<2>::set_gate(_i & 1);
+    sid_voice<2>::set_pulse_width(_i);
+  });
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+#ifndef SRC_CONTROL_SCHEDULER_H
+#define SRC_CONTROL_SCHEDULER_H
+
+#include <stdbool.h>
+#include "util.h"
+
+// Control-rate tasks (glide, the modulation modes, envelope tracking), run
+// every so many ticks of a hardware timer rather than whenever the loop gets
+// round to comparing `micros()`.
+//
+// The timer ISR only calls `control_scheduler_tick()`, which bumps a byte, so
+// it's a few cycles and never touches anything the tasks do. The loop calls
+// `control_scheduler_run()` as often as it can (including between MIDI
+// events), and that runs each task whose time has come. Tasks write SID
+// registers, and only the loop may do that, so they can't run in the ISR.
+//
+// A task that's late by a whole period or more doesn't run twice to catch up:
+// it runs once, and the periods it missed are counted in its `overruns`. Each
+// task also keeps its longest run, in ticks of `control_scheduler_clock()`.
+//
+// Ticks are a byte, as in sid_queue.h, so the ISR and the loop never need to
+// turn interrupts off to share them. If the loop doesn't call
+// `control_scheduler_run()` for 255 ticks (a long synchronous bus drain, say),
+// the ISR stops counting rather than wrap, and flags it. The next run counts
+// that in `overflows`, which `control_scheduler_overruns()` includes, since
+// however many ticks were lost, every task missed some periods.
+
+#ifndef CONTROL_SCHEDULER_MAX_TASKS
+#define CONTROL_SCHEDULER_MAX_TASKS 4
+#endif
+
+// will be defined in SID.ino: a free-running 16-bit timer, for timing tasks
+extern uint16_t control_scheduler_clock();
+
+typedef void (*control_task_function)();
+
+struct control_task {
+  control_task_function run;
+  uint16_t period; // scheduler ticks
+  uint16_t due; // the tick it's next due at
+
+  // stats, since the last `control_scheduler_reset_stats()`
+  uint16_t longest_run; // `control_scheduler_clock()` ticks
+  uint32_t overruns; // periods it missed
+  uint32_t runs;
+};
+typedef struct control_task control_task;
+
+struct control_scheduler {
+  control_task tasks[CONTROL_SCHEDULER_MAX_TASKS];
+  byte length;
+  volatile byte ticks; // the ISR's count
+  volatile bool saturated; // the ISR had 255 ticks unseen, and dropped some
+  byte seen; // `ticks` when we last looked
+  uint32_t overflows; // runs that found `saturated`, since the last reset
+  uint16_t now; // ticks so far, without the byte's wrapping
+};
+typedef struct control_scheduler control_scheduler;
+
+void control_scheduler_initialize(control_scheduler *s);
+byte control_scheduler_add(control_scheduler *s, control_task_function run, uint16_t period);
+void control_scheduler_tick(control_scheduler *s);
+byte control_scheduler_run(control_scheduler *s);
+void control_scheduler_reset_stats(control_scheduler *s);
+uint32_t control_scheduler_overruns(const control_scheduler *s);
+
+// O(1)
+void control_scheduler_initialize(control_scheduler *s) {
+  s->length = 0;
+  s->ticks = 0;
+  s->saturated = false;
+  s->seen = 0;
+  s->overflows = 0;
+  s->now = 0;
+}
+
+// Runs `run` every `period` ticks (at least 1), starting a period from now.
+// Returns the task's index, for its stats, or CONTROL_SCHEDULER_MAX_TASKS if
+// there's no room.
+//
+// O(1)
+byte control_scheduler_add(control_scheduler *s, control_task_function run, uint16_t period) {
+  if (s->length == CONTROL_SCHEDULER_MAX_TASKS) {
+    return CONTROL_SCHEDULER_MAX_TASKS;
+  }
+
+  control_task *task = &s->tasks[s->length];
+  task->run = run;
+  task->period = period ? period : 1;
+  task->due = s->now + task->period;
+  task->longest_run = 0;
+  task->overruns = 0;
+  task->runs = 0;
+
+  return s->length++;
+}
+
+// the timer ISR's half. Stops at 255 unseen ticks rather than wrap to 0.
+//
+// O(1)
+void control_scheduler_tick(control_scheduler *s) {
+  if ((byte)(s->ticks - s->seen) == 255) {
+    s->saturated = true;
+    return;
+  }
+  s->ticks = s->ticks + 1;
+}
+
+// Runs every task that's due, in the order they were added. Returns how many
+// ran.
+//
+// O(tasks)
+byte control_scheduler_run(control_scheduler *s) {
+  byte ticks = s->ticks;
+  s->now += (byte)(ticks - s->seen);
+  s->seen = ticks;
+
+  // only after `seen` has caught up, so the ISR can't set it again meanwhile
+  if (s->saturated) {
+    s->saturated = false;
+    s->overflows++;
+  }
+
+  byte ran = 0;
+  for (byte i = 0; i < s->length; i++) {
+    control_task *task = &s->tasks[i];
+    uint16_t late = s->now - task->due;
+    if (late >= 0x8000) {
+      continue; // not due yet
+    }
+
+    uint16_t missed = late / task->period;
+    task->overruns += missed;
+    task->due += (missed + 1) * task->period;
+
+    uint16_t started = control_scheduler_clock();
+    task->run();
+    uint16_t took = control_scheduler_clock() - started;
+    if (took > task->longest_run) {
+      task->longest_run = took;
+    }
+    task->runs++;
+    ran++;
+  }
+
+  return ran;
+}
+
+// O(tasks)
+void control_scheduler_reset_stats(control_scheduler *s) {
+  s->overflows = 0;
+  for (byte i = 0; i < s->length; i++) {
+    s->tasks[i].longest_run = 0;
+    s->tasks[i].overruns = 0;
+    s->tasks[i].runs = 0;
+  }
+}
+
+// periods missed, by every task, plus the times the tick count saturated (an
+// unknown number of periods each)
+//
+// O(tasks)
+uint32_t control_scheduler_overruns(const control_scheduler *s) {
+  uint32_t overruns = s->overflows;
+  for (byte i = 0; i < s->length; i++) {
+    overruns += s->tasks[i].overruns;
+  }
+  return overruns;
+}
+
+#endif /* SRC_CONTROL_SCHEDULER_H */
@@ -0,0 +1,110 @@
+#ifndef SRC_DDS_H
+#define SRC_DDS_H
+
+#include "util.h"
+
+// Fixed-point direct digital synthesis, for the waveforms the modulation modes
+// need at control rate: a 32-bit phase accumulator per voice, of which the top
+// 8 bits index a 256-entry sine table in flash (triangle and saw are worked out
+// from the same bits, so they don't need a table).
+//
+// A tick is one 32-bit add and one table read, no float. The phase increment
+// comes straight from the voice's frequency register word: the SID's oscillator
+// runs at `word * 1MHz / 2^24` Hz, so over `tick_micros` it turns
+// `word * tick_micros / 2^24` cycles, which is `word * tick_micros * 256` in
+// 2^32ths of a cycle. That's exact; the only error is the table's.
+//
+// Waveforms are sampled at the tick rate, so anything above half of it aliases.
+
+#define DDS_SINE 0
+#define DDS_TRIANGLE 1
+#define DDS_SAW 2
+
+// 2^32ths of a cycle per microsecond, for a register word of 1
+#define DDS_PHASE_PER_WORD_MICROS 256UL
+
+struct dds_oscillator {
+  uint32_t phase; // 2^32ths of a cycle
+  uint32_t increment; // per tick
+};
+typedef struct dds_oscillator dds_oscillator;
+
+void dds_reset(dds_oscillator *o);
+void dds_set_register_word(dds_oscillator *o, word register_word, uint16_t tick_micros);
+int8_t dds_tick(dds_oscillator *o, byte waveform);
+void dds_skip(dds_oscillator *o, uint16_t ticks);
+int8_t dds_sample(uint32_t phase, byte waveform);
+
+// "private" below
+
+// round(127 * sin(2 * pi * i / 256))
+static const int8_t dds_sine_table[256] PROGMEM = {
+  0, 3, 6, 9, 12, 16, 19, 22, 25, 28, 31, 34, 37, 40, 43, 46,
+  49, 51, 54, 57, 60, 63, 65, 68, 71, 73, 76, 78, 81, 83, 85, 88,
+  90, 92, 94, 96, 98, 100, 102, 104, 106, 107, 109, 111, 112, 113, 115, 116,
+  117, 118, 120, 121, 122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127,
+  127, 127, 127, 127, 126, 126, 126, 125, 125, 124, 123, 122, 122, 121, 120, 118,
+  117, 116, 115, 113, 112, 111, 109, 107, 106, 104, 102, 100, 98, 96, 94, 92,
+  90, 88, 85, 83, 81, 78, 76, 73, 71, 68, 65, 63, 60, 57, 54, 51,
+  49, 46, 43, 40, 37, 34, 31, 28, 25, 22, 19, 16, 12, 9, 6, 3,
+  0, -3, -6, -9, -12, -16, -19, -22, -25, -28, -31, -34, -37, -40, -43, -46,
+  -49, -51, -54, -57, -60, -63, -65, -68, -71, -73, -76, -78, -81, -83, -85, -88,
+  -90, -92, -94, -96, -98, -100, -102, -104, -106, -107, -109, -111, -112, -113, -115, -116,
+  -117, -118, -120, -121, -122, -122, -123, -124, -125, -125, -126, -126, -126, -127, -127, -127,
+  -127, -127, -127, -127, -126, -126, -126, -125, -125, -124, -123, -122, -122, -121, -120, -118,
+  -117, -116, -115, -113, -112, -111, -109, -107, -106, -104, -102, -100, -98, -96, -94, -92,
+  -90, -88, -85, -83, -81, -78, -76, -73, -71, -68, -65, -63, -60, -57, -54, -51,
+  -49, -46, -43, -40, -37, -34, -31, -28, -25, -22, -19, -16, -12, -9, -6, -3,
+};
+
+// back to the start of a cycle, e.g. for a new note
+//
+// O(1)
+void dds_reset(dds_oscillator *o) {
+  o->phase = 0;
+}
+
+// `register_word` as in `sid_set_voice_frequency_register()`; `tick_micros`
+// is how far apart `dds_tick()` is called. The multiplication wraps for high
+// notes, which is fine: only the phase mod one cycle matters.
+//
+// O(1)
+void dds_set_register_word(dds_oscillator *o, word register_word, uint16_t tick_micros) {
+  o->increment = (uint32_t)register_word * (DDS_PHASE_PER_WORD_MICROS * tick_micros);
+}
+
+// returns the waveform at the current phase, in [-127..127], then advances it
+//
+// O(1)
+int8_t dds_tick(dds_oscillator *o, byte waveform) {
+  int8_t sample = dds_sample(o->phase, waveform);
+  o->phase += o->increment;
+  return sample;
+}
+
+// advances `ticks` ticks without sampling, e.g. for ticks a late caller missed
+//
+// O(1)
+void dds_skip(dds_oscillator *o, uint16_t ticks) {
+  o->phase += o->increment * ticks;
+}
+
+// All three start a cycle at 0 and rising, like sine.
+//
+// O(1)
+int8_t dds_sample(uint32_t phase, byte waveform) {
+  byte index = phase >> 24;
+
+  switch (waveform) {
+  case DDS_TRIANGLE: {
+    byte shifted = index + 64; // a quarter cycle on, so it starts at 0
+    return shifted < 128 ? 2 * shifted - 127 : 383 - 2 * shifted;
+  }
+  case DDS_SAW:
+    return index == 128 ? -127 : (int8_t)index;
+  default:
+    return (int8_t)pgm_read_byte(&dds_sine_table[index]);
+  }
+}
+
+#endif /* SRC_DDS_H */
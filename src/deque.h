@@ -1,12 +1,11 @@
 #ifndef SRC_DEQUE_H
 #define SRC_DEQUE_H
 
-#include <math.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <stdbool.h>
 #include "list_node.h"
 #include "hash_table.h"
+#include "note.h"
 
 // A double-ended queue that stores its elements in a hash map. All fixed-size.
 //
@@ -21,132 +20,109 @@
 // Having elements ordered by insertion, it's like a queue
 // Having elements uniquely indexed by `key`, it's like a hash
 // Has aspects of a sorted set?
-
-typedef struct deque deque;
+//
+// The element type and capacity are template parameters, and the nodes live in
+// the deque's own hash table, so `static deque<note, 16> notes;` is all the
+// memory it will ever use. Capacity must be a power of two (see hash_table.h).
 
 // A function that returns a unique key for a given list element.
 // This is how we'll insert the element into the hash map, so it's gotta be unique and idempotent.
-typedef unsigned int (node_index_function_t)(deque *dq, NODE_DATA n);
+// Keys are stored as bytes, and 255 is reserved (see hash_table.h).
+template <typename T>
+using node_index_function_t = unsigned int (T data);
 // function that prints a list element
-typedef void (node_print_function_t)(node *n, FILE *stream);
-// function that prints the whole list
-typedef void (deque_print_function)(deque *dq);
+template <typename T>
+using node_print_function_t = void (const T *data, FILE *stream);
 
+template <typename T, unsigned int CAPACITY>
 struct deque {
-  node *first;
-  node *last;
-  unsigned int max_length;
-  hash_table *ht;
+  static const unsigned int max_length = CAPACITY;
+  static_assert(CAPACITY < LIST_NODE_NONE, "node links are bytes, and LIST_NODE_NONE is taken");
+
+  uint8_t first; // slot in `ht`, or LIST_NODE_NONE
+  uint8_t last;
+  hash_table<unsigned char, node<T>, CAPACITY> ht;
   FILE *stream;
-  node_index_function_t *node_index_function;
-  node_print_function_t *node_print_function;
-  deque_print_function *root_print_function;
+  node_index_function_t<T> *node_index_function;
+  node_print_function_t<T> *node_print_function;
 };
 
+template <typename T>
 struct maybe_node_data {
   bool exists; // if `exists` is not `true`, then the value returned by `unwrap` is undefined.
-  NODE_DATA unwrap;
+  T unwrap;
 };
-typedef struct maybe_node_data maybe_node_data;
-
-deque *deque_initialize(unsigned int max_length, FILE *stream, node_index_function_t *node_indexer, node_print_function_t *node_printer);
-unsigned int deque_length(deque *dq);
-void deque_append_replace(deque *dq, NODE_DATA node_data);
-void deque_prepend_replace(deque *dq, NODE_DATA node_data);
-maybe_node_data deque_remove_first(deque *dq);
-maybe_node_data deque_remove_last(deque *dq);
-maybe_node_data deque_remove_by_key(deque *dq, unsigned int k);
-NODE_DATA *deque_find_by_key(deque *dq, unsigned int k);
-node *deque_find_node_by_key(deque *dq, unsigned int k);
-void deque_inspect(deque *dq);
-void deque_empty(deque *dq);
-void deque_free(deque *dq);
-// "private" below
-static maybe_node_data _deque_remove_helper(deque *dq, unsigned int key);
-static void _note_node_print_function(node *n, FILE *stream);
-static void _deque_inspect_nodes(deque *dq, node *n, node_print_function_t *print_node, FILE *stream, unsigned int iterations);
-static void _deque_root_print_function(deque *l);
 
-// BEGIN the section of code that stands for "generic" in this cursed language
-unsigned int _note_indexer(__attribute__ ((unused)) deque *dq, note n) {
+template <typename T, unsigned int N> void deque_initialize(deque<T, N> *dq, FILE *stream, node_index_function_t<T> *node_indexer, node_print_function_t<T> *node_printer);
+template <typename T, unsigned int N> unsigned int deque_length(const deque<T, N> *dq);
+template <typename T, unsigned int N> void deque_append_replace(deque<T, N> *dq, T node_data);
+template <typename T, unsigned int N> void deque_prepend_replace(deque<T, N> *dq, T node_data);
+template <typename T, unsigned int N> maybe_node_data<T> deque_remove_first(deque<T, N> *dq);
+template <typename T, unsigned int N> maybe_node_data<T> deque_remove_last(deque<T, N> *dq);
+template <typename T, unsigned int N> maybe_node_data<T> deque_remove_by_key(deque<T, N> *dq, unsigned int k);
+template <typename T, unsigned int N> T *deque_find_by_key(deque<T, N> *dq, unsigned int k);
+template <typename T, unsigned int N> node<T> *deque_find_node_by_key(deque<T, N> *dq, unsigned int k);
+template <typename T, unsigned int N> node<T> *deque_first_node(deque<T, N> *dq);
+template <typename T, unsigned int N> node<T> *deque_last_node(deque<T, N> *dq);
+template <typename T, unsigned int N> node<T> *deque_next_node(deque<T, N> *dq, const node<T> *n);
+template <typename T, unsigned int N> node<T> *deque_previous_node(deque<T, N> *dq, const node<T> *n);
+template <typename T, unsigned int N> void deque_inspect(deque<T, N> *dq);
+template <typename T, unsigned int N> void deque_empty(deque<T, N> *dq);
+// "private" below
+template <typename T, unsigned int N> static node<T> *_deque_node_at(deque<T, N> *dq, uint8_t slot);
+template <typename T, unsigned int N> static node<T> *_deque_insert(deque<T, N> *dq, T node_data, bool evict_first);
+template <typename T, unsigned int N> static maybe_node_data<T> _deque_remove_helper(deque<T, N> *dq, unsigned int key);
+template <typename T, unsigned int N> static void _deque_inspect_nodes(deque<T, N> *dq);
+template <typename T, unsigned int N> static void _deque_root_print_function(deque<T, N> *dq);
+template <typename T, unsigned int N> static void _deque_node_moved(void *context, unsigned int from, unsigned int to);
+
+// BEGIN the note-specific section
+unsigned int _note_indexer(note n) {
   return n.number;
 }
 
-NODE_DATA node_data_init() {
-  NODE_DATA nd = {.number=0, .on_time=0, .off_time=0, .voiced_by_oscillator=0};
+note node_data_init() {
+  note nd = {.number=0, .voiced_by_oscillator=0, .on_time=0, .off_time=0};
   return(nd);
 }
 
-static void _note_node_print_function(node *n, FILE *stream) {
-  if (!n) {
-    fprintf(stream, "%s", "NONE");
-    return;
-  }
-  node *next = n->next;
-  node *previous = n->previous;
-
-  char data_as_string[5];
-  char next_as_string[5];
-  char previous_as_string[5];
-
-  snprintf(data_as_string, sizeof(data_as_string), "%i", n->data.number);
-
-  if (next) {
-    snprintf(next_as_string, sizeof(next_as_string), "%i", next->data.number);
-  } else {
-    snprintf(next_as_string, sizeof(next_as_string), "%s", "_");
-  }
-
-  if (previous) {
-    snprintf(previous_as_string, sizeof(previous_as_string), "%i", previous->data.number);
-  } else {
-    snprintf(previous_as_string, sizeof(previous_as_string), "%s", "_");
-  }
-
-  fprintf(stream, "(#%s %s< >%s)", data_as_string, previous_as_string, next_as_string);
+static void _note_node_print_function(const note *n, FILE *stream) {
+  fprintf(stream, "%i", n->number);
 }
-// END the section of code that stands for "generic" in this cursed language
+// END the note-specific section
 
 // O(n)
-void deque_inspect(deque *dq) {
+template <typename T, unsigned int N>
+void deque_inspect(deque<T, N> *dq) {
   _deque_root_print_function(dq);
-  _deque_inspect_nodes(dq, dq->first, dq->node_print_function, dq->stream, 0);
+  _deque_inspect_nodes(dq);
   fprintf(dq->stream, "%s", "\n");
 }
 
-// O(1)
-void deque_empty(deque *dq) {
-  dq->first = NULL;
-  dq->last = NULL;
-  hash_table_empty(dq->ht);
+// O(n)
+template <typename T, unsigned int N>
+void deque_empty(deque<T, N> *dq) {
+  dq->first = LIST_NODE_NONE;
+  dq->last = LIST_NODE_NONE;
+  hash_table_empty(&dq->ht);
 }
 
 // O(n)
-deque *deque_initialize(unsigned int max_length, FILE *stream, node_index_function_t *node_indexer, node_print_function_t *node_printer) {
-  deque *dq = (deque *)malloc(sizeof(deque));
-  dq->max_length = max_length;
-  dq->first = NULL;
-  dq->last = NULL;
-  dq->ht = hash_table_initialize(dq->max_length); // sizeof(ht) + array[max_length] of nodes
+template <typename T, unsigned int N>
+void deque_initialize(deque<T, N> *dq, FILE *stream, node_index_function_t<T> *node_indexer, node_print_function_t<T> *node_printer) {
+  hash_table_initialize(&dq->ht);
+  dq->ht.moved = _deque_node_moved<T, N>; // removals shift nodes around in the hash's array
+  dq->ht.moved_context = dq;
   dq->stream = stream;
   dq->node_index_function = node_indexer;
   dq->node_print_function = node_printer;
-  dq->root_print_function = _deque_root_print_function;
   deque_empty(dq);
-  return dq;
 }
 
 // O(1)
-unsigned int deque_length(deque *dq) {
-  return dq->ht->size;
-}
-
-// O(1)
-void deque_free(deque *dq) {
-  if (dq->ht) {
-    hash_table_free(dq->ht);
-  }
-  free(dq);
+template <typename T, unsigned int N>
+unsigned int deque_length(const deque<T, N> *dq) {
+  return dq->ht.size;
 }
 
 // Adds the element to the front of the queue. If the queue contains an element
@@ -154,43 +130,19 @@ void deque_free(deque *dq) {
 // capacity, the oldest element will be replaced.
 //
 // O(1)
-void deque_append_replace(deque *dq, NODE_DATA node_data) {
-  unsigned int key = dq->node_index_function(dq, node_data);
-  node *new_node = NULL;
-  node *former_lasts_previous = dq->last ? dq->last->previous : NULL;
-
-  while (new_node == NULL) {
-    new_node = hash_table_set(
-      dq->ht,
-      key,
-      (node){ .data=node_data, .previous=dq->last, .next=NULL, .key=key }
-    );
-
-    // `hash_table_set` returns NULL to signal it's out of space and couldn't
-    // add the element without evicting another one. So it's up to us to choose.
-    // Here we choose to evict the *oldest* element from the list and then retry
-    if (!new_node) {
-      deque_remove_first(dq);
-    }
-  }
-
-  node *last = dq->last;
-
-  if (!last) {
-    dq->last = new_node;
-    dq->first = new_node;
-    return;
-  }
-
-  if (last->key == new_node->key) { // we replaced a node that had the same key.
-    new_node->next = NULL;
-    new_node->previous = former_lasts_previous; // to avoid having self-referential links in the list
+template <typename T, unsigned int N>
+void deque_append_replace(deque<T, N> *dq, T node_data) {
+  node<T> *new_node = _deque_insert(dq, node_data, true);
+  uint8_t slot = hash_table_slot_of(&dq->ht, new_node);
+
+  new_node->previous = dq->last;
+  new_node->next = LIST_NODE_NONE;
+  if (dq->last == LIST_NODE_NONE) {
+    dq->first = slot;
   } else {
-    last->next = new_node;
-    new_node->previous = last;
+    _deque_node_at(dq, dq->last)->next = slot;
   }
-
-  dq->last = new_node;
+  dq->last = slot;
 }
 
 // Adds the element to the back of the queue. If the queue contains an element
@@ -198,155 +150,207 @@ void deque_append_replace(deque *dq, NODE_DATA node_data) {
 // capacity, the newest element will be replaced.
 //
 // O(1)
-void deque_prepend_replace(deque *dq, NODE_DATA node_data) {
-  unsigned int key = dq->node_index_function(dq, node_data);
-  node *new_node = NULL;
-  node *former_firsts_next = dq->first ? dq->first->next : NULL;
-
-  while (new_node == NULL) {
-    new_node = hash_table_set(
-      dq->ht,
-      key,
-      (node){ .data=node_data, .previous=NULL, .next=dq->first, .key=key }
-    );
-
-    // `hash_table_set` returns NULL to signal it's out of space and couldn't
-    // add the element without evicting another one. So it's up to us to choose.
-    // Here we choose to evict the *newest* element from the list and then retry
-    // NB: if this loops more than once, something went extremely wrong
-    if (!new_node) {
-      deque_remove_last(dq);
-    }
-  }
-
-  node *first = dq->first;
-
-  if (!first) {
-    dq->first = new_node;
-    dq->last = new_node;
-    return;
-  }
-
-  if (first->key == new_node->key) { // we replaced a node that had the same key.
-    new_node->previous = NULL;
-    new_node->next = former_firsts_next; // to avoid having self-referential links in the list
+template <typename T, unsigned int N>
+void deque_prepend_replace(deque<T, N> *dq, T node_data) {
+  node<T> *new_node = _deque_insert(dq, node_data, false);
+  uint8_t slot = hash_table_slot_of(&dq->ht, new_node);
+
+  new_node->previous = LIST_NODE_NONE;
+  new_node->next = dq->first;
+  if (dq->first == LIST_NODE_NONE) {
+    dq->last = slot;
   } else {
-    first->previous = new_node;
-    new_node->next = first;
+    _deque_node_at(dq, dq->first)->previous = slot;
   }
-
-  dq->first = new_node;
+  dq->first = slot;
 }
 
 // O(1)
-maybe_node_data deque_remove_first(deque *dq) {
-  node *first = dq->first;
-  if (first == NULL) {
-    return (maybe_node_data){ .exists=false };
+template <typename T, unsigned int N>
+maybe_node_data<T> deque_remove_first(deque<T, N> *dq) {
+  if (dq->first == LIST_NODE_NONE) {
+    return { false, T() };
   }
-  node *next = dq->first->next;
-  NODE_DATA value = first->data;
-
-  maybe_hash_table_val removed = hash_table_remove(dq->ht, first->key);
-
-  if (!removed.exists) { exit(EXIT_FAILURE); } // well this is unexpected!
-
-  if (next) {
-    dq->first = next;
-  } else {
-    dq->first = NULL;
-    dq->last = NULL;
-  }
-
-  return (maybe_node_data){ .exists=true, .unwrap=value };
+  return _deque_remove_helper(dq, dq->ht.array[dq->first].key);
 }
 
 // O(1)
-maybe_node_data deque_remove_last(deque *dq) {
-  node *last = dq->last;
-  if (last == NULL) {
-    return (maybe_node_data){ .exists=false };
+template <typename T, unsigned int N>
+maybe_node_data<T> deque_remove_last(deque<T, N> *dq) {
+  if (dq->last == LIST_NODE_NONE) {
+    return { false, T() };
   }
-  node *previous = dq->last->previous;
-
-  NODE_DATA value = last->data;
+  return _deque_remove_helper(dq, dq->ht.array[dq->last].key);
+}
 
-  maybe_hash_table_val removed = hash_table_remove(dq->ht, last->key);
+// O(1)
+template <typename T, unsigned int N>
+maybe_node_data<T> deque_remove_by_key(deque<T, N> *dq, unsigned int key) {
+  return _deque_remove_helper(dq, key);
+}
 
-  if (!removed.exists) { exit(EXIT_FAILURE); } // well this is unexpected!
+// O(1)
+template <typename T, unsigned int N>
+T *deque_find_by_key(deque<T, N> *dq, unsigned int key) {
+  node<T> *result = hash_table_get(&dq->ht, (unsigned char)key);
+  return(result ? &result->data : NULL);
+}
 
-  if (previous) {
-    dq->last = previous;
-  } else {
-    dq->first = NULL;
-    dq->last = NULL;
-  }
+// O(1)
+template <typename T, unsigned int N>
+node<T> *deque_find_node_by_key(deque<T, N> *dq, unsigned int key) {
+  return hash_table_get(&dq->ht, (unsigned char)key);
+}
 
-  return (maybe_node_data){ .exists=true, .unwrap=value };
+// The oldest node, or NULL. Like any pointer into the deque, it's only good
+// until the next change to it.
+//
+// O(1)
+template <typename T, unsigned int N>
+node<T> *deque_first_node(deque<T, N> *dq) {
+  return _deque_node_at(dq, dq->first);
 }
 
+// the newest node, or NULL
+//
 // O(1)
-maybe_node_data deque_remove_by_key(deque *dq, unsigned int key) {
-  return _deque_remove_helper(dq, key);
+template <typename T, unsigned int N>
+node<T> *deque_last_node(deque<T, N> *dq) {
+  return _deque_node_at(dq, dq->last);
 }
 
+// the next-newer node, or NULL
+//
 // O(1)
-NODE_DATA *deque_find_by_key(deque *dq, unsigned int key) {
-  HASH_TABLE_VAL *result = hash_table_get(dq->ht, key);
-  return(result ? &result->data : NULL);
+template <typename T, unsigned int N>
+node<T> *deque_next_node(deque<T, N> *dq, const node<T> *n) {
+  return _deque_node_at(dq, n->next);
 }
 
+// the next-older node, or NULL
+//
 // O(1)
-node *deque_find_node_by_key(deque *dq, unsigned int key) {
-  HASH_TABLE_VAL *result = hash_table_get(dq->ht, key);
-  return(result ? result : NULL);
+template <typename T, unsigned int N>
+node<T> *deque_previous_node(deque<T, N> *dq, const node<T> *n) {
+  return _deque_node_at(dq, n->previous);
 }
 
 // private below
-static maybe_node_data _deque_remove_helper(deque *dq, unsigned int key) {
-  maybe_hash_table_val removed = hash_table_remove(dq->ht, key);
-  if (!removed.exists) {
-    return (maybe_node_data){ .exists=false };
-  }
+template <typename T, unsigned int N>
+static node<T> *_deque_node_at(deque<T, N> *dq, uint8_t slot) {
+  return slot == LIST_NODE_NONE ? NULL : &dq->ht.array[slot].value;
+}
+
+// Stores `node_data` in the hash, unlinked. An element with the same key is
+// removed first, so it can't end up linked to itself; if the hash is full, the
+// oldest (`evict_first`) or newest element makes room.
+template <typename T, unsigned int N>
+static node<T> *_deque_insert(deque<T, N> *dq, T node_data, bool evict_first) {
+  unsigned int key = dq->node_index_function(node_data);
+  node<T> *new_node = NULL;
 
-  node *next = removed.unwrap.next;
-  node *previous = removed.unwrap.previous;
+  _deque_remove_helper(dq, key);
 
-  if (previous) {
-    previous->next = next;
+  while (new_node == NULL) {
+    node<T> unlinked = { node_data, LIST_NODE_NONE, LIST_NODE_NONE };
+    new_node = hash_table_set(&dq->ht, (unsigned char)key, unlinked);
+
+    // `hash_table_set` returns NULL to signal it's out of space and couldn't
+    // add the element without evicting another one. So it's up to us to choose.
+    // NB: if this loops more than once, something went extremely wrong
+    if (!new_node) {
+      if (evict_first) {
+        deque_remove_first(dq);
+      } else {
+        deque_remove_last(dq);
+      }
+    }
   }
-  if (next) {
-    next->previous = previous;
+
+  return new_node;
+}
+
+template <typename T, unsigned int N>
+static maybe_node_data<T> _deque_remove_helper(deque<T, N> *dq, unsigned int key) {
+  node<T> *removed = hash_table_get(&dq->ht, (unsigned char)key);
+  if (!removed) {
+    return { false, T() };
   }
 
-  if (previous == NULL) { // it was the first node
+  // unlink first: removing it from the hash may move its neighbours
+  uint8_t next = removed->next;
+  uint8_t previous = removed->previous;
+
+  if (previous == LIST_NODE_NONE) { // it was the first node
     dq->first = next;
+  } else {
+    _deque_node_at(dq, previous)->next = next;
   }
-  if (next == NULL) { // it was the last node
+  if (next == LIST_NODE_NONE) { // it was the last node
     dq->last = previous;
+  } else {
+    _deque_node_at(dq, next)->previous = previous;
   }
 
-  return (maybe_node_data){ .exists=true, .unwrap=removed.unwrap.data };
+  maybe_hash_table_val<node<T>> value = hash_table_remove(&dq->ht, (unsigned char)key);
+  return { true, value.unwrap.data };
 }
 
-static void _deque_inspect_nodes(deque *dq, node *n, node_print_function_t *print_node, FILE *stream, unsigned int iterations) {
-  if (n == NULL) {
-    return;
-  }
-  if (iterations > dq->max_length) {
-    fprintf(stream, "⚠️ INFINITE LOOP DETECTED in deque!\n");
-    return;
+// `hash_table_remove` shifted a node from slot `from` to slot `to`. Its own
+// links are still right, but its neighbours (or the ends) point at `from`.
+template <typename T, unsigned int N>
+static void _deque_node_moved(void *context, unsigned int from, unsigned int to) {
+  deque<T, N> *dq = (deque<T, N> *)context;
+  node<T> *n = _deque_node_at(dq, to);
+
+  if (n->previous == LIST_NODE_NONE) {
+    dq->first = to;
+  } else {
+    _deque_node_at(dq, n->previous)->next = to;
   }
-  print_node(n, stream);
-  if (n->next) {
-    fprintf(stream, "%s", "-");
-    _deque_inspect_nodes(dq, n->next, print_node, stream, ++iterations);
+  if (n->next == LIST_NODE_NONE) {
+    dq->last = to;
   } else {
-    return;
+    _deque_node_at(dq, n->next)->previous = to;
+  }
+  (void)from;
+}
+
+template <typename T, unsigned int N>
+static void _deque_inspect_nodes(deque<T, N> *dq) {
+  unsigned int iterations = 0;
+
+  for (node<T> *n = deque_first_node(dq); n; n = deque_next_node(dq, n)) {
+    if (iterations++ > dq->max_length) {
+      fprintf(dq->stream, "⚠️ INFINITE LOOP DETECTED in deque!\n");
+      return;
+    }
+    node<T> *previous = deque_previous_node(dq, n);
+    node<T> *next = deque_next_node(dq, n);
+
+    if (previous) {
+      fprintf(dq->stream, "%s", "-");
+    }
+    fprintf(dq->stream, "%s", "(#");
+    dq->node_print_function(&n->data, dq->stream);
+    fprintf(dq->stream, "%s", " ");
+    if (previous) {
+      dq->node_print_function(&previous->data, dq->stream);
+    } else {
+      fprintf(dq->stream, "%s", "_");
+    }
+    fprintf(dq->stream, "%s", "< >");
+    if (next) {
+      dq->node_print_function(&next->data, dq->stream);
+    } else {
+      fprintf(dq->stream, "%s", "_");
+    }
+    fprintf(dq->stream, "%s", ")");
   }
 }
 
-static void _deque_root_print_function(deque *dq) {
+template <typename T, unsigned int N>
+static void _deque_root_print_function(deque<T, N> *dq) {
   fprintf(dq->stream, "dq(%d/%d): ", deque_length(dq), dq->max_length);
 }
 
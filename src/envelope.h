@@ -0,0 +1,206 @@
+#ifndef SRC_ENVELOPE_H
+#define SRC_ENVELOPE_H
+
+#include <stdbool.h>
+#include "note.h"
+#include "util.h"
+
+// What a SID voice's envelope generator is doing, worked out on our side from
+// the gate flips and the AD/SR registers, without reading anything back from
+// the chip. All integer math.
+//
+// The SID's envelope is an 8-bit level driven by a rate counter:
+// - attack counts the level up by 1 every `envelope_rate_periods[attack]`
+//   cycles of the SID's 1MHz clock, until it hits 255
+// - decay and release count it down, with the period multiplied by 1, 2, 4, 8,
+//   16 or 30 depending on the level, which approximates an exponential curve.
+//   Decay stops at the sustain level (the sustain nibble * 17), release at 0
+// - a gate flip starts attack or release from whatever the level is, so the
+//   release time depends on how far the envelope got
+//
+// From that, `envelope_level()` estimates the current level, and
+// `envelope_gate()` works out the tick the voice goes silent, once per note
+// off, so checking for it (`envelope_silent()`) is a compare.
+//
+// Times are note_ticks (ms), so the same wraparound rules apply (see note.h):
+// call `envelope_clamp_age()` every so often. The longest envelope (8s attack,
+// 24s decay) is well under NOTE_TICKS_MAX_AGE, so clamping doesn't change any
+// level we'd report.
+
+#define ENVELOPE_CYCLES_PER_TICK 1000UL // the SID clock is 1MHz, ticks are 1ms
+#define ENVELOPE_LEVEL_MAX 255
+
+// SID clock cycles per envelope step, by AD/SR nibble
+const uint16_t envelope_rate_periods[16] PROGMEM = {
+  9, 32, 63, 95, 149, 220, 267, 313, 392, 977, 1954, 3126, 3907, 11720, 19532, 31251
+};
+
+struct envelope {
+  bool gate;
+  byte start_level;    // the level at `since`
+  note_ticks since;    // when the gate last flipped. 0 if it never has
+  note_ticks silent_at; // when release reaches 0. 0 while gated, or if already silent
+};
+typedef struct envelope envelope;
+
+void envelope_reset(envelope *e);
+void envelope_gate(envelope *e, bool on, note_ticks now, byte attack_decay, byte sustain_release);
+byte envelope_level(const envelope *e, note_ticks now, byte attack_decay, byte sustain_release);
+bool envelope_silent(const envelope *e, note_ticks now);
+void envelope_clamp_age(envelope *e, note_ticks now);
+unsigned long envelope_release_cycles(byte release, byte from_level);
+// "private" below
+static unsigned int _envelope_decay_units(byte from_level, byte to_level);
+static byte _envelope_decay_by(byte from_level, byte floor_level, unsigned long units);
+static byte _envelope_decay_multiplier(byte level);
+
+// silent, released, and no history
+//
+// O(1)
+void envelope_reset(envelope *e) {
+  e->gate = false;
+  e->start_level = 0;
+  e->since = 0;
+  e->silent_at = 0;
+}
+
+// call with the gate's new state whenever it's written to the chip. Does
+// nothing if the gate didn't actually change.
+//
+// O(1)
+void envelope_gate(envelope *e, bool on, note_ticks now, byte attack_decay, byte sustain_release) {
+  if (on == e->gate) {
+    return;
+  }
+
+  e->start_level = envelope_level(e, now, attack_decay, sustain_release);
+  e->gate = on;
+  e->since = now;
+  e->silent_at = 0;
+
+  if (!on && e->start_level > 0) {
+    unsigned long cycles = envelope_release_cycles(lowNibble(sustain_release), e->start_level);
+    note_ticks ticks = (cycles + ENVELOPE_CYCLES_PER_TICK - 1) / ENVELOPE_CYCLES_PER_TICK;
+    e->silent_at = (note_ticks)(now + ticks);
+    if (e->silent_at == 0) {
+      e->silent_at = 1; // 0 means "no deadline"; a tick late is fine
+    }
+  }
+}
+
+// the level the envelope is at, [0..255]
+//
+// O(1)
+byte envelope_level(const envelope *e, note_ticks now, byte attack_decay, byte sustain_release) {
+  if (e->since == 0) {
+    return 0;
+  }
+
+  unsigned long cycles = (unsigned long)note_ticks_since(now, e->since) * ENVELOPE_CYCLES_PER_TICK;
+
+  if (!e->gate) {
+    uint16_t period = pgm_read_word(&envelope_rate_periods[lowNibble(sustain_release)]);
+    return _envelope_decay_by(e->start_level, 0, cycles / period);
+  }
+
+  // attack, from wherever the last release left off
+  uint16_t attack_period = pgm_read_word(&envelope_rate_periods[highNibble(attack_decay)]);
+  unsigned long attack_steps = ENVELOPE_LEVEL_MAX - e->start_level;
+  unsigned long attack_cycles = attack_steps * attack_period;
+  if (cycles < attack_cycles) {
+    return e->start_level + cycles / attack_period;
+  }
+
+  // then decay, down to sustain
+  uint16_t decay_period = pgm_read_word(&envelope_rate_periods[lowNibble(attack_decay)]);
+  byte sustain_level = highNibble(sustain_release) * 17;
+  return _envelope_decay_by(ENVELOPE_LEVEL_MAX, sustain_level, (cycles - attack_cycles) / decay_period);
+}
+
+// whether the release that started at the last gate off has reached 0 by now
+//
+// O(1)
+bool envelope_silent(const envelope *e, note_ticks now) {
+  if (e->gate) {
+    return false;
+  }
+  if (e->silent_at == 0) {
+    return true;
+  }
+  return note_ticks_since(now, e->silent_at) < 0x8000; // i.e. `now` is at or past it
+}
+
+// keeps `since` and `silent_at` from wrapping around while a note is held, or
+// long after it went silent; see note.h
+//
+// O(1)
+void envelope_clamp_age(envelope *e, note_ticks now) {
+  note_ticks_clamp_age(&e->since, now);
+  if (e->silent_at != 0 && envelope_silent(e, now)) {
+    e->silent_at = 0; // so it can't look like it's in the future once `now` wraps
+  }
+}
+
+// SID clock cycles for a release at `release` (the SR register's low nibble)
+// to get from `from_level` to 0. 24s at most.
+//
+// O(1)
+unsigned long envelope_release_cycles(byte release, byte from_level) {
+  uint16_t period = pgm_read_word(&envelope_rate_periods[lowNibble(release)]);
+  return (unsigned long)period * _envelope_decay_units(from_level, 0);
+}
+
+// private below
+
+// the decay period multiplier for a step down from `level`
+static byte _envelope_decay_multiplier(byte level) {
+  if (level > 93) { return 1; }
+  if (level > 54) { return 2; }
+  if (level > 26) { return 4; }
+  if (level > 14) { return 8; }
+  if (level > 6) { return 16; }
+  return 30;
+}
+
+// the levels at which the multiplier changes, from the top
+static const byte _envelope_decay_segment_floors[6] = { 93, 54, 26, 14, 6, 0 };
+
+// how many periods decaying from `from_level` to `to_level` takes
+static unsigned int _envelope_decay_units(byte from_level, byte to_level) {
+  unsigned int units = 0;
+
+  for (byte i = 0; i < 6 && from_level > to_level; i++) {
+    byte floor_level = _envelope_decay_segment_floors[i];
+    if (from_level <= floor_level) {
+      continue;
+    }
+    byte stop = floor_level > to_level ? floor_level : to_level;
+    units += (unsigned int)(from_level - stop) * _envelope_decay_multiplier(from_level);
+    from_level = stop;
+  }
+
+  return units;
+}
+
+// the level after decaying from `from_level` for `units` periods, never going
+// below `floor_level`
+static byte _envelope_decay_by(byte from_level, byte floor_level, unsigned long units) {
+  for (byte i = 0; i < 6 && from_level > floor_level; i++) {
+    byte segment_floor = _envelope_decay_segment_floors[i];
+    if (from_level <= segment_floor) {
+      continue;
+    }
+    byte stop = segment_floor > floor_level ? segment_floor : floor_level;
+    byte multiplier = _envelope_decay_multiplier(from_level);
+    unsigned long cost = (unsigned long)(from_level - stop) * multiplier;
+    if (units < cost) {
+      return from_level - units / multiplier;
+    }
+    units -= cost;
+    from_level = stop;
+  }
+
+  return from_level > floor_level ? from_level : floor_level;
+}
+
+#endif /* SRC_ENVELOPE_H */
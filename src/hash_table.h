@@ -2,41 +2,43 @@
 #define SRC_HASH_TABLE_H
 
 #include <stdio.h>
-#include <stdlib.h>
 #include <stdbool.h>
-#include "list_node.h"
+#include <stddef.h>
+#include <string.h>
 
 // A simple fixed-size hash table using open addressing.
 // intended for storing small-ish data, because all data is stored
 // directly in the hash's array. no pointers.
-
-// begin "generic" section
-#ifndef HASH_TABLE_KEY
-#define HASH_TABLE_KEY unsigned char
-#endif
-
-#ifndef HASH_TABLE_VAL
-#define HASH_TABLE_VAL node
-#endif
-// end "generic" section
-
+//
+// The key type, value type and capacity are template parameters, so a table
+// is one plain struct: declare it static and there's no heap involved. The
+// capacity must be a power of two, which makes `hash()` and every wraparound a
+// mask instead of a modulo (the AVR has no divide instruction).
+//
+// Collisions are resolved by linear probing, and removal uses backward-shift
+// deletion: the entries after the hole that would be closer to their home slot
+// are shifted back into it. So there are no tombstones, every probe sequence
+// stays unbroken, and lookups only ever scan up to the next empty slot.
+//
+// Shifting moves values, so pointers returned by `hash_table_get` and
+// `hash_table_set` are only good until the next `hash_table_remove`. If you
+// keep track of values by slot (like `deque` does), set `moved` to be told
+// where they went.
+//
+// There's no per-slot "exists" flag: a free slot holds `empty_key` (all bits
+// set, e.g. 255 for byte keys), so that one key value can't be stored.
+
+template <typename K, typename V>
 struct hash_table_element {
-  HASH_TABLE_KEY key;
-  HASH_TABLE_VAL value;
-};
-typedef struct hash_table_element hash_table_element;
-
-struct maybe_hash_table_element {
-  bool exists; // if `exists` is not `true`, then the value returned by `unwrap` is undefined.
-  hash_table_element unwrap;
+  K key; // `empty_key` if the slot is free
+  V value;
 };
-typedef struct maybe_hash_table_element maybe_hash_table_element;
 
+template <typename V>
 struct maybe_hash_table_val {
   bool exists; // if `exists` is not `true`, then the value returned by `unwrap` is undefined.
-  HASH_TABLE_VAL unwrap;
+  V unwrap;
 };
-typedef struct maybe_hash_table_val maybe_hash_table_val;
 
 struct maybe_uint {
   bool exists;
@@ -44,75 +46,98 @@ struct maybe_uint {
 };
 typedef struct maybe_uint maybe_uint;
 
+template <typename K, typename V, unsigned int CAPACITY>
 struct hash_table {
-  maybe_hash_table_element *array;
+  static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "hash_table capacity must be a power of two");
+  static const unsigned int max_size = CAPACITY;
+  static const unsigned int mask = CAPACITY - 1;
+  typedef K key_type; // so keys passed to the functions below convert, instead of deducing K
+  static constexpr K empty_key = (K)~(K)0;
+
+  hash_table_element<K, V> array[CAPACITY];
   unsigned int size;
-  unsigned int max_size;
+  // optional: called right after `hash_table_remove` shifted a value from slot
+  // `from` to slot `to`
+  void (*moved)(void *context, unsigned int from, unsigned int to);
+  void *moved_context;
 };
-typedef struct hash_table hash_table;
-
-hash_table *hash_table_initialize(unsigned int max_size);
-void hash_table_free(hash_table *h);
-HASH_TABLE_VAL *hash_table_set(hash_table *h, HASH_TABLE_KEY key, HASH_TABLE_VAL value);
-HASH_TABLE_VAL *hash_table_get(hash_table *h, HASH_TABLE_KEY key);
-maybe_hash_table_val hash_table_remove(hash_table *h, HASH_TABLE_KEY key);
-void hash_table_empty(hash_table *h);
-void hash_table_element_inspect(const hash_table_element *e);
-void hash_table_inspect(const hash_table *h);
-float hash_table_load_factor(hash_table *h);
-float hash_table_collision_ratio(hash_table *h);
-static HASH_TABLE_KEY hash(const hash_table *h, HASH_TABLE_KEY key);
-static unsigned int hash_table_num_collisions(hash_table *h);
-static maybe_uint _find_slot(const hash_table *h, HASH_TABLE_KEY key);
-
-hash_table *hash_table_initialize(unsigned int max_size) {
-  hash_table *h = (hash_table *) malloc(sizeof(hash_table));
-  h->max_size = max_size;
-  h->array = (maybe_hash_table_element *) malloc(sizeof(maybe_hash_table_element) * max_size);
+
+// histogram buckets for `hash_table_probe_histogram`. The last bucket counts
+// every probe length from there up.
+#define HASH_TABLE_PROBE_HISTOGRAM_SIZE 8
+
+template <typename K, typename V, unsigned int N> void hash_table_initialize(hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> V *hash_table_set(hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key, V value);
+template <typename K, typename V, unsigned int N> V *hash_table_get(hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key);
+template <typename K, typename V, unsigned int N> maybe_hash_table_val<V> hash_table_remove(hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key);
+template <typename K, typename V, unsigned int N> void hash_table_empty(hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> bool hash_table_slot_used(const hash_table<K, V, N> *h, unsigned int slot);
+template <typename K, typename V, unsigned int N> unsigned int hash_table_slot_of(const hash_table<K, V, N> *h, const V *value);
+template <typename K, typename V> void hash_table_element_inspect(const hash_table_element<K, V> *e);
+template <typename K, typename V, unsigned int N> void hash_table_inspect(const hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> float hash_table_load_factor(const hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> float hash_table_collision_ratio(const hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> unsigned int hash_table_probe_length(const hash_table<K, V, N> *h, unsigned int slot);
+template <typename K, typename V, unsigned int N> unsigned int hash_table_max_probe_length(const hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> void hash_table_probe_histogram(const hash_table<K, V, N> *h, unsigned int histogram[HASH_TABLE_PROBE_HISTOGRAM_SIZE]);
+template <typename K, typename V, unsigned int N> static unsigned int hash(const hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key);
+template <typename K, typename V, unsigned int N> static unsigned int hash_table_num_collisions(const hash_table<K, V, N> *h);
+template <typename K, typename V, unsigned int N> static maybe_uint _find_slot(const hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key);
+
+template <typename K, typename V, unsigned int N>
+void hash_table_initialize(hash_table<K, V, N> *h) {
+  h->moved = NULL;
+  h->moved_context = NULL;
   hash_table_empty(h);
-  return h;
 }
 
-static HASH_TABLE_KEY hash(const hash_table *h, HASH_TABLE_KEY key) {
-  return(key % h->max_size); // yes folks it's just that simple
+template <typename K, typename V, unsigned int N>
+static unsigned int hash(__attribute__ ((unused)) const hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key) {
+  return((unsigned int)key & hash_table<K, V, N>::mask); // yes folks it's just that simple
 }
 
-HASH_TABLE_VAL *hash_table_get(hash_table *h, HASH_TABLE_KEY key) {
+template <typename K, typename V, unsigned int N>
+V *hash_table_get(hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key) {
   maybe_uint slot = _find_slot(h, key);
 
   if (slot.exists) {
-    maybe_hash_table_element element = h->array[slot.unwrap];
-    if (element.exists) {
-      return &h->array[slot.unwrap].unwrap.value;
+    if (hash_table_slot_used(h, slot.unwrap)) {
+      return &h->array[slot.unwrap].value;
     }
   }
 
   return NULL;
 }
 
-HASH_TABLE_VAL *hash_table_set(hash_table *h, HASH_TABLE_KEY key, HASH_TABLE_VAL value) {
+template <typename K, typename V, unsigned int N>
+V *hash_table_set(hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key, V value) {
+  if (key == h->empty_key) {
+    return NULL; // reserved, see above
+  }
+
   maybe_uint slot = _find_slot(h, key);
 
   if (slot.exists) {
-    if (!h->array[slot.unwrap].exists) { // increment hashtable size only if nothing was already there
+    if (!hash_table_slot_used(h, slot.unwrap)) { // increment hashtable size only if nothing was already there
       h->size++;
     }
-    maybe_hash_table_element e = { .exists=true, .unwrap={ .key=key, .value=value } };
-    h->array[slot.unwrap] = e;
-    return &h->array[slot.unwrap].unwrap.value;
+    h->array[slot.unwrap].key = key;
+    h->array[slot.unwrap].value = value;
+    return &h->array[slot.unwrap].value;
   } else {
     return NULL; // array is full. value was not set.
   }
 }
 
-static maybe_uint _find_slot(const hash_table *h, HASH_TABLE_KEY key) {
+template <typename K, typename V, unsigned int N>
+static maybe_uint _find_slot(const hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key) {
   unsigned int index = hash(h, key);
 
-  for (unsigned int i = index, max = index + h->max_size; i < max; i++) {
-    maybe_hash_table_element maybe = h->array[i % h->max_size];
+  for (unsigned int i = 0; i < N; i++, index = (index + 1) & h->mask) {
+    K here = h->array[index].key;
 
-    if (!maybe.exists || maybe.unwrap.key == key) {
-      return (maybe_uint){ .exists=true, .unwrap=i % h->max_size };
+    if (here == h->empty_key || here == key) {
+      return { true, index };
     }
   }
 
@@ -120,108 +145,158 @@ static maybe_uint _find_slot(const hash_table *h, HASH_TABLE_KEY key) {
   // that's bad obviously, but since we're a fixed-size hash table, best to just
   // signal that failure to the caller so they can choose which element to
   // replace.
-  return (maybe_uint){ .exists=false }; // alternative: `return index;`
+  return { false, 0 }; // alternative: `return index;`
 }
 
-maybe_hash_table_val hash_table_remove(hash_table *h, HASH_TABLE_KEY key) {
-  unsigned int index = hash(h, key);
-  maybe_hash_table_element null_element = { .exists=false };
-  maybe_hash_table_val found = { .exists=false };
-  unsigned int found_index = 0;
-  maybe_hash_table_element swap_places_with = { .exists=false };
-  unsigned int swap_places_with_index = 0;
-
-  for (unsigned int i = index, max = index + h->max_size; i < max; i++) {
-    unsigned int this_index = i % h->max_size;
-    maybe_hash_table_element maybe = h->array[this_index];
-
-    if (!maybe.exists) {
-      break;
-    }
-    if (maybe.unwrap.key == key) {
-      found = (maybe_hash_table_val) { .exists=true, .unwrap=maybe.unwrap.value };
-      found_index = this_index;
-    }
-    if (hash(h, maybe.unwrap.key) == hash(h, key)) {
-      swap_places_with.exists = true;
-      swap_places_with.unwrap = maybe.unwrap;
-      swap_places_with_index = this_index;
-    }
+template <typename K, typename V, unsigned int N>
+maybe_hash_table_val<V> hash_table_remove(hash_table<K, V, N> *h, typename hash_table<K, V, N>::key_type key) {
+  maybe_uint slot = _find_slot(h, key);
+
+  if (!slot.exists || !hash_table_slot_used(h, slot.unwrap)) {
+    return { false, V() };
   }
 
-  if (found.exists) {
-    if (swap_places_with.exists) {
-      h->array[found_index] = swap_places_with;
-      h->array[swap_places_with_index] = null_element;
-    } else {
-      h->array[found_index] = null_element;
+  maybe_hash_table_val<V> found = { true, h->array[slot.unwrap].value };
+  unsigned int hole = slot.unwrap;
+  h->array[hole].key = h->empty_key; // so the walk below stops here, even in a full table
+
+  // walk the rest of the run, shifting back every entry whose home slot isn't
+  // between the hole and where it sits now (cyclically). Those are exactly the
+  // entries whose probe sequence passes through the hole.
+  for (unsigned int i = (hole + 1) & h->mask; hash_table_slot_used(h, i); i = (i + 1) & h->mask) {
+    unsigned int home = hash(h, h->array[i].key);
+    bool home_is_after_hole = ((home - hole - 1) & h->mask) < ((i - hole) & h->mask);
+
+    if (!home_is_after_hole) {
+      h->array[hole] = h->array[i];
+      h->array[i].key = h->empty_key;
+      if (h->moved) {
+        h->moved(h->moved_context, i, hole);
+      }
+      hole = i;
     }
-    h->size--;
   }
 
+  h->size--;
+
   return found;
 }
 
-float hash_table_load_factor(hash_table *h) {
+template <typename K, typename V, unsigned int N>
+float hash_table_load_factor(const hash_table<K, V, N> *h) {
   return((float)h->size / h->max_size);
 }
 
-static unsigned int hash_table_num_collisions(hash_table *h) {
+// the number of elements that aren't in their home slot
+template <typename K, typename V, unsigned int N>
+static unsigned int hash_table_num_collisions(const hash_table<K, V, N> *h) {
   unsigned int num_collisions = 0;
-  for (unsigned int i = 0; i < h->size; i++) {
-    if (h->array[i].exists) {
-      hash_table_element e = h->array[i].unwrap;
-
-      if (hash(h, e.key) != i) {
-        maybe_hash_table_element in_our_spot = h->array[hash(h, e.key)];
-
-        if (in_our_spot.exists) {
-          num_collisions++;
-        }
-      }
+  for (unsigned int i = 0; i < N; i++) {
+    if (hash_table_probe_length(h, i) > 1) {
+      num_collisions++;
     }
   }
 
   return num_collisions;
 }
 
-float hash_table_collision_ratio(hash_table *h) {
+template <typename K, typename V, unsigned int N>
+float hash_table_collision_ratio(const hash_table<K, V, N> *h) {
+  if (h->size == 0) {
+    return 0.0;
+  }
   return((float) hash_table_num_collisions(h) / (float)h->size);
 }
 
-void hash_table_empty(hash_table *h) {
-  for (unsigned int i = 0; i < h->max_size; i++) {
-    h->array[i].exists = false;
+// how many slots a lookup of the element in `slot` has to look at: 1 if it's in
+// its home slot. 0 if `slot` is empty.
+template <typename K, typename V, unsigned int N>
+unsigned int hash_table_probe_length(const hash_table<K, V, N> *h, unsigned int slot) {
+  if (!hash_table_slot_used(h, slot)) {
+    return 0;
+  }
+  unsigned int home = hash(h, h->array[slot].key);
+  return ((slot - home) & h->mask) + 1;
+}
+
+// the longest lookup in the table, in slots
+template <typename K, typename V, unsigned int N>
+unsigned int hash_table_max_probe_length(const hash_table<K, V, N> *h) {
+  unsigned int longest = 0;
+  for (unsigned int i = 0; i < N; i++) {
+    unsigned int length = hash_table_probe_length(h, i);
+    if (length > longest) {
+      longest = length;
+    }
+  }
+
+  return longest;
+}
+
+// `histogram[n]` gets the number of elements with a probe length of n + 1
+template <typename K, typename V, unsigned int N>
+void hash_table_probe_histogram(const hash_table<K, V, N> *h, unsigned int histogram[HASH_TABLE_PROBE_HISTOGRAM_SIZE]) {
+  memset(histogram, 0, sizeof(unsigned int) * HASH_TABLE_PROBE_HISTOGRAM_SIZE);
+
+  for (unsigned int i = 0; i < N; i++) {
+    unsigned int length = hash_table_probe_length(h, i);
+    if (length > 0) {
+      histogram[(length > HASH_TABLE_PROBE_HISTOGRAM_SIZE ? HASH_TABLE_PROBE_HISTOGRAM_SIZE : length) - 1]++;
+    }
+  }
+}
+
+template <typename K, typename V, unsigned int N>
+void hash_table_empty(hash_table<K, V, N> *h) {
+  for (unsigned int i = 0; i < N; i++) {
+    h->array[i].key = h->empty_key;
   }
   h->size = 0;
 }
 
-void hash_table_element_inspect(const hash_table_element *e) {
+template <typename K, typename V, unsigned int N>
+bool hash_table_slot_used(const hash_table<K, V, N> *h, unsigned int slot) {
+  return h->array[slot].key != h->empty_key;
+}
+
+// the slot a pointer from `hash_table_get` or `hash_table_set` points into
+template <typename K, typename V, unsigned int N>
+unsigned int hash_table_slot_of(const hash_table<K, V, N> *h, const V *value) {
+  typedef hash_table_element<K, V> element_type;
+  const char *element = (const char *)value - offsetof(element_type, value);
+  return (const element_type *)element - h->array;
+}
+
+template <typename K, typename V>
+void hash_table_element_inspect(const hash_table_element<K, V> *e) {
   if (e) {
-    // fprintf(stdout, "{k:%u,v:%u} ", e->key, e->value.data.number);
-    fprintf(stdout, "{k:%u,v:*},", e->key);
+    fprintf(stdout, "{k:%u,v:*},", (unsigned int)e->key);
   } else {
     fprintf(stdout, "{},");
   }
 }
 
-void hash_table_inspect(const hash_table *h) {
+template <typename K, typename V, unsigned int N>
+void hash_table_inspect(const hash_table<K, V, N> *h) {
   fprintf(stdout, "h(%u/%u): { ", h->size, h->max_size);
 
-  for (unsigned int i = 0; i < h->max_size; i++) {
-    if (h->array[i].exists) {
-      hash_table_element_inspect(&h->array[i].unwrap);
+  for (unsigned int i = 0; i < N; i++) {
+    if (hash_table_slot_used(h, i)) {
+      hash_table_element_inspect(&h->array[i]);
     } else {
-      hash_table_element_inspect(NULL);
+      hash_table_element_inspect<K, V>(NULL);
     }
   }
 
   fprintf(stdout, " }\n");
-}
 
-void hash_table_free(hash_table *h) {
-  free(h->array);
-  free(h);
+  unsigned int histogram[HASH_TABLE_PROBE_HISTOGRAM_SIZE];
+  hash_table_probe_histogram(h, histogram);
+  fprintf(stdout, "probes(max %u): {", hash_table_max_probe_length(h));
+  for (unsigned int i = 0; i < HASH_TABLE_PROBE_HISTOGRAM_SIZE; i++) {
+    fprintf(stdout, i == 0 ? " %u" : ", %u", histogram[i]);
+  }
+  fprintf(stdout, " }\n");
 }
 
 #endif /* SRC_HASH_TABLE_H */
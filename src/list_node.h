@@ -1,24 +1,21 @@
 #ifndef SRC_LIST_NODE_H
 #define SRC_LIST_NODE_H
 
-#include <stdbool.h>
-#include "note.h"
+#include <stdint.h>
 
-// a node in a doubly-linked list
+// a node in a doubly-linked list of `T`s
+//
+// The links are slot indices into whatever array holds the nodes (for `deque`,
+// its hash table), not pointers: one byte each instead of two on the AVR (and
+// eight here), and they survive the array shuffling its slots around.
 
-// BEGIN "generic section" for this cursed language
-#ifndef NODE_DATA
-#define NODE_DATA struct note
-#endif
-// END "generic section"
-
-typedef struct node node;
+#define LIST_NODE_NONE 0xFF // "no node": the end of the list
 
+template <typename T>
 struct node {
-  NODE_DATA data;
-  node *previous;
-  node *next;
-  unsigned int key;
+  T data;
+  uint8_t previous;
+  uint8_t next;
 };
 
 #endif /* SRC_LIST_NODE_H */
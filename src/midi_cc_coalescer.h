@@ -0,0 +1,73 @@
+#ifndef SRC_MIDI_CC_COALESCER_H
+#define SRC_MIDI_CC_COALESCER_H
+
+#include <stdbool.h>
+#include "util.h"
+
+// Continuous CCs waiting to be applied, latest value per CC number.
+//
+// Automation (filter cutoff, pulse width...) can send a CC far more often than
+// it's worth writing to the SID. Rather than apply each one, the caller adds
+// it here, and a later value for the same CC replaces the pending one. The
+// caller applies what's pending, in the order the CCs first arrived, before
+// any event whose order matters (a note, a toggle) and at the end of each
+// pass through `loop()` (see `handle_midi_input()` in SID.ino). So the result
+// is the same as applying everything in order, just without the values nobody
+// would have heard.
+//
+// Values are already decoded (see `midi_cc_decode()`), so an MSB keeps the LSB
+// it was sent with, even if another LSB comes before it's applied.
+
+#define MIDI_CC_COALESCER_SIZE 8
+
+struct midi_cc_coalescer {
+  byte numbers[MIDI_CC_COALESCER_SIZE]; // pending CCs, oldest first
+  word values[MIDI_CC_COALESCER_SIZE];
+  byte length;
+  uint32_t merged; // CCs replaced before they were applied, since the last reset
+};
+typedef struct midi_cc_coalescer midi_cc_coalescer;
+
+void midi_cc_coalescer_initialize(midi_cc_coalescer *c);
+void midi_cc_coalescer_clear(midi_cc_coalescer *c);
+bool midi_cc_coalescer_add(midi_cc_coalescer *c, byte number, word value);
+
+// nothing pending, and no merges counted
+//
+// O(1)
+void midi_cc_coalescer_initialize(midi_cc_coalescer *c) {
+  c->length = 0;
+  c->merged = 0;
+}
+
+// call once everything pending has been applied
+//
+// O(1)
+void midi_cc_coalescer_clear(midi_cc_coalescer *c) {
+  c->length = 0;
+}
+
+// Replaces CC `number`'s pending value, or queues it. Returns false if it's
+// not pending and there's no room; apply what's pending, clear, and add again.
+//
+// O(MIDI_CC_COALESCER_SIZE)
+bool midi_cc_coalescer_add(midi_cc_coalescer *c, byte number, word value) {
+  for (byte i = 0; i < c->length; i++) {
+    if (c->numbers[i] == number) {
+      c->values[i] = value;
+      c->merged++;
+      return true;
+    }
+  }
+
+  if (c->length == MIDI_CC_COALESCER_SIZE) {
+    return false;
+  }
+
+  c->numbers[c->length] = number;
+  c->values[c->length] = value;
+  c->length++;
+  return true;
+}
+
+#endif /* SRC_MIDI_CC_COALESCER_H */
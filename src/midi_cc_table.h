@@ -0,0 +1,275 @@
+#ifndef SRC_MIDI_CC_TABLE_H
+#define SRC_MIDI_CC_TABLE_H
+
+#include <stdbool.h>
+#include "midi_cc_coalescer.h"
+#include "midi_constants.h"
+#include "sid.h"
+#include "util.h"
+
+// What each of the 128 CC numbers does, as a table in flash, built at compile
+// time from the numbers in midi_constants.h. Looking up a CC is one indexed
+// read, however many CCs we implement, and a handful of handlers (one per
+// `kind`) cover what used to be a case per CC per voice.
+//
+// Each entry is 2 bytes, so the table is 256, and says:
+// - kind: which parameter the CC sets (MIDI_CC_*), or MIDI_CC_NONE
+// - voice: for per-voice parameters, [0..2]
+// - bits: how wide the parameter is. 1-bit parameters are on at 127 and off
+//   otherwise, up to 7 bits the value is scaled down (e.g. >> 3 for 4 bits),
+//   and wider ones are 14-bit MSB/LSB pairs (below)
+// - argument: the LSB slot, for pairs; the waveform or filter mode bit >> 4,
+//   for MIDI_CC_WAVEFORM and MIDI_CC_FILTER_MODE (they're all in the high
+//   nibble of their registers)
+//
+// MSB/LSB pairs: the LSB CC (kind MIDI_CC_LSB) stores its value in a slot and
+// doesn't change anything on the SID. The MSB CC combines its value with that
+// slot's into `bits` bits and applies it. So a controller sends the LSB first,
+// and the MSB on its own still works (with whatever LSB was last sent).
+
+#define MIDI_CC_NONE 0
+#define MIDI_CC_WAVEFORM 1
+#define MIDI_CC_RING_MOD 2
+#define MIDI_CC_SYNC 3
+#define MIDI_CC_TEST 4
+#define MIDI_CC_VOICE_FILTER 5
+#define MIDI_CC_PULSE_WIDTH 6
+#define MIDI_CC_ATTACK 7
+#define MIDI_CC_DECAY 8
+#define MIDI_CC_SUSTAIN 9
+#define MIDI_CC_RELEASE 10
+#define MIDI_CC_DETUNE 11
+#define MIDI_CC_FILTER_MODE 12
+#define MIDI_CC_FILTER_FREQUENCY 13
+#define MIDI_CC_FILTER_RESONANCE 14
+#define MIDI_CC_VOLUME 15
+#define MIDI_CC_GLIDE_TIME 16
+#define MIDI_CC_LSB 17
+#define MIDI_CC_RPN_MSB 18
+#define MIDI_CC_RPN_LSB 19
+#define MIDI_CC_DATA_ENTRY 20
+#define MIDI_CC_VOLUME_MODULATION_MODE 21
+#define MIDI_CC_PULSE_WIDTH_MODULATION_MODE 22
+#define MIDI_CC_ALL_TEST_BITS 23
+#define MIDI_CC_STATE_DUMP 24
+#define MIDI_CC_ALL_SOUND_OFF 25
+#define MIDI_CC_RESET_ALL_CONTROLLERS 26
+#define MIDI_CC_ALL_NOTES_OFF 27
+
+// LSB slots, one per MSB/LSB pair
+#define MIDI_CC_SLOT_PULSE_WIDTH 0 // + voice
+#define MIDI_CC_SLOT_DETUNE 3 // + voice
+#define MIDI_CC_SLOT_FILTER_FREQUENCY 6
+#define MIDI_CC_SLOT_GLIDE_TIME 7
+#define MIDI_CC_SLOTS 8
+
+// what `midi_cc_coalesce()` did with a CC
+#define MIDI_CC_COALESCE_IN_ORDER 0 // nothing: apply it in order with everything else
+#define MIDI_CC_COALESCE_HELD 1 // stored (an LSB) or pending (a continuous CC)
+#define MIDI_CC_COALESCE_FULL 2 // nothing: apply what's pending, clear, and try again
+
+struct midi_cc {
+  byte kind : 5;
+  byte voice : 3;
+  byte bits : 4;
+  byte argument : 4;
+};
+typedef struct midi_cc midi_cc;
+static_assert(sizeof(midi_cc) == 2, "midi_cc should pack into 2 bytes");
+
+struct midi_cc_table {
+  midi_cc entries[128];
+  byte collisions; // CCs given two meanings; has to be 0
+};
+typedef struct midi_cc_table midi_cc_table;
+
+constexpr midi_cc_table midi_cc_table_build();
+midi_cc midi_cc_lookup(byte number);
+bool midi_cc_decode(const midi_cc *cc, byte value, byte *slots, word *decoded);
+bool midi_cc_continuous(const midi_cc *cc);
+byte midi_cc_coalesce(const midi_cc *cc, byte number, byte value, byte *slots, midi_cc_coalescer *pending);
+// "private" below
+static constexpr void _midi_cc_set(midi_cc_table *t, byte number, byte kind, byte voice, byte bits, byte argument);
+static constexpr void _midi_cc_set_voice(midi_cc_table *t, byte voice, const byte *numbers, byte pulse_width_lsb, byte detune, byte detune_lsb);
+
+// private, but up here: the table is built from these at compile time, so
+// they have to be defined before it
+
+static constexpr void _midi_cc_set(midi_cc_table *t, byte number, byte kind, byte voice, byte bits, byte argument) {
+  if (t->entries[number].kind != MIDI_CC_NONE) {
+    t->collisions++;
+  }
+  t->entries[number] = { kind, voice, bits, argument };
+}
+
+// `numbers` are the voice's CCs in the order they're listed in
+// midi_constants.h: 4 waveforms, ring mod, sync, test, filter, pulse width,
+// then ADSR
+static constexpr void _midi_cc_set_voice(midi_cc_table *t, byte voice, const byte *numbers, byte pulse_width_lsb, byte detune, byte detune_lsb) {
+  const byte waveforms[] = { SID_TRIANGLE, SID_RAMP, SID_SQUARE, SID_NOISE };
+  for (byte i = 0; i < 4; i++) {
+    _midi_cc_set(t, numbers[i], MIDI_CC_WAVEFORM, voice, 1, waveforms[i] >> 4);
+  }
+  _midi_cc_set(t, numbers[4], MIDI_CC_RING_MOD, voice, 1, 0);
+  _midi_cc_set(t, numbers[5], MIDI_CC_SYNC, voice, 1, 0);
+  _midi_cc_set(t, numbers[6], MIDI_CC_TEST, voice, 1, 0);
+  _midi_cc_set(t, numbers[7], MIDI_CC_VOICE_FILTER, voice, 1, 0);
+  _midi_cc_set(t, numbers[8], MIDI_CC_PULSE_WIDTH, voice, 12, MIDI_CC_SLOT_PULSE_WIDTH + voice);
+  _midi_cc_set(t, pulse_width_lsb, MIDI_CC_LSB, voice, 12, MIDI_CC_SLOT_PULSE_WIDTH + voice);
+  _midi_cc_set(t, numbers[9], MIDI_CC_ATTACK, voice, 4, 0);
+  _midi_cc_set(t, numbers[10], MIDI_CC_DECAY, voice, 4, 0);
+  _midi_cc_set(t, numbers[11], MIDI_CC_SUSTAIN, voice, 4, 0);
+  _midi_cc_set(t, numbers[12], MIDI_CC_RELEASE, voice, 4, 0);
+  _midi_cc_set(t, detune, MIDI_CC_DETUNE, voice, 14, MIDI_CC_SLOT_DETUNE + voice);
+  _midi_cc_set(t, detune_lsb, MIDI_CC_LSB, voice, 14, MIDI_CC_SLOT_DETUNE + voice);
+}
+
+// O(1), at compile time
+constexpr midi_cc_table midi_cc_table_build() {
+  midi_cc_table t = {};
+
+  const byte voice_one[] = {
+    MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_TRIANGLE, MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_RAMP,
+    MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_SQUARE, MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_NOISE,
+    MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_ONE,
+    MIDI_CONTROL_CHANGE_SET_TEST_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_ONE,
+    MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_ONE,
+    MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_ONE,
+    MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_ONE
+  };
+  const byte voice_two[] = {
+    MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_TRIANGLE, MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_RAMP,
+    MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_SQUARE, MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_NOISE,
+    MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_TWO, MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_TWO,
+    MIDI_CONTROL_CHANGE_SET_TEST_VOICE_TWO, MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_TWO,
+    MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_TWO,
+    MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_TWO, MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_TWO,
+    MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_TWO, MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_TWO
+  };
+  const byte voice_three[] = {
+    MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_TRIANGLE, MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_RAMP,
+    MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_SQUARE, MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_NOISE,
+    MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_THREE, MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_THREE,
+    MIDI_CONTROL_CHANGE_SET_TEST_VOICE_THREE, MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_THREE,
+    MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_THREE,
+    MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_THREE, MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_THREE,
+    MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_THREE, MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_THREE
+  };
+
+  _midi_cc_set_voice(&t, 0, voice_one, MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_ONE,
+                     MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_ONE);
+  _midi_cc_set_voice(&t, 1, voice_two, MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_TWO,
+                     MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_TWO, MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_TWO);
+  _midi_cc_set_voice(&t, 2, voice_three, MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_THREE,
+                     MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_THREE, MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_THREE);
+
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_LP, MIDI_CC_FILTER_MODE, 0, 1, SID_FILTER_LP >> 4);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_BP, MIDI_CC_FILTER_MODE, 0, 1, SID_FILTER_BP >> 4);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_HP, MIDI_CC_FILTER_MODE, 0, 1, SID_FILTER_HP >> 4);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY, MIDI_CC_FILTER_FREQUENCY, 0, 11, MIDI_CC_SLOT_FILTER_FREQUENCY);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY_LSB, MIDI_CC_LSB, 0, 11, MIDI_CC_SLOT_FILTER_FREQUENCY);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_SET_FILTER_RESONANCE, MIDI_CC_FILTER_RESONANCE, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_SET_VOLUME, MIDI_CC_VOLUME, 0, 4, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_SET_GLIDE_TIME, MIDI_CC_GLIDE_TIME, 0, 14, MIDI_CC_SLOT_GLIDE_TIME);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_SET_GLIDE_TIME_LSB, MIDI_CC_LSB, 0, 14, MIDI_CC_SLOT_GLIDE_TIME);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_RPN_MSB, MIDI_CC_RPN_MSB, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_RPN_LSB, MIDI_CC_RPN_LSB, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_DATA_ENTRY, MIDI_CC_DATA_ENTRY, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_TOGGLE_VOLUME_MODULATION_MODE, MIDI_CC_VOLUME_MODULATION_MODE, 0, 1, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_TOGGLE_PULSE_WIDTH_MODULATION_MODE, MIDI_CC_PULSE_WIDTH_MODULATION_MODE, 0, 1, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_TOGGLE_ALL_TEST_BITS, MIDI_CC_ALL_TEST_BITS, 0, 1, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_STATE_DUMP, MIDI_CC_STATE_DUMP, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_ALL_SOUND_OFF, MIDI_CC_ALL_SOUND_OFF, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_RESET_ALL_CONTROLLERS, MIDI_CC_RESET_ALL_CONTROLLERS, 0, 7, 0);
+  _midi_cc_set(&t, MIDI_CONTROL_CHANGE_ALL_NOTES_OFF, MIDI_CC_ALL_NOTES_OFF, 0, 7, 0);
+
+  return t;
+}
+
+static_assert(midi_cc_table_build().collisions == 0, "two CCs in midi_constants.h have the same number");
+
+const midi_cc_table midi_cc_table_P PROGMEM = midi_cc_table_build();
+
+// what CC `number` does
+//
+// O(1)
+midi_cc midi_cc_lookup(byte number) {
+  uint16_t packed = pgm_read_word(&midi_cc_table_P.entries[number & 0x7F]);
+  midi_cc cc;
+  memcpy(&cc, &packed, sizeof(cc));
+  return cc;
+}
+
+// Turns a CC value into `cc`'s parameter value: 0 or 1 for 1-bit parameters,
+// scaled down for ones up to 7 bits, or combined with the stored LSB for
+// pairs. Returns false if there's nothing to apply: an LSB, which is stored in
+// `slots` (MIDI_CC_SLOTS of them) for its MSB to pick up, or an unused CC.
+//
+// O(1)
+bool midi_cc_decode(const midi_cc *cc, byte value, byte *slots, word *decoded) {
+  value &= 0x7F;
+
+  if (cc->kind == MIDI_CC_NONE) {
+    return false;
+  }
+  if (cc->kind == MIDI_CC_LSB) {
+    slots[cc->argument] = value;
+    return false;
+  }
+
+  if (cc->bits == 1) {
+    *decoded = value == 127;
+  } else if (cc->bits <= 7) {
+    *decoded = value >> (7 - cc->bits);
+  } else {
+    byte lsb_bits = cc->bits - 7;
+    *decoded = ((word)value << lsb_bits) | (slots[cc->argument] & ((1 << lsb_bits) - 1));
+  }
+  return true;
+}
+
+// whether `cc` sets a parameter that only its latest value matters for (a
+// level, a time, a frequency), as opposed to a toggle or a mode, so it can be
+// coalesced (see midi_cc_coalescer.h)
+//
+// O(1)
+bool midi_cc_continuous(const midi_cc *cc) {
+  switch (cc->kind) {
+  case MIDI_CC_PULSE_WIDTH:
+  case MIDI_CC_ATTACK:
+  case MIDI_CC_DECAY:
+  case MIDI_CC_SUSTAIN:
+  case MIDI_CC_RELEASE:
+  case MIDI_CC_DETUNE:
+  case MIDI_CC_FILTER_FREQUENCY:
+  case MIDI_CC_FILTER_RESONANCE:
+  case MIDI_CC_VOLUME:
+  case MIDI_CC_GLIDE_TIME:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Holds on to CC `number` (looked up as `cc`) if it doesn't have to be applied
+// in order. An LSB only goes into `slots`, since it doesn't change anything on
+// its own; a continuous CC's decoded value goes into `pending`. Either way it
+// doesn't flush what's pending: a pending MSB already has its LSB in its value.
+//
+// O(MIDI_CC_COALESCER_SIZE)
+byte midi_cc_coalesce(const midi_cc *cc, byte number, byte value, byte *slots, midi_cc_coalescer *pending) {
+  word decoded = 0;
+
+  if (cc->kind == MIDI_CC_LSB) {
+    midi_cc_decode(cc, value, slots, &decoded);
+    return MIDI_CC_COALESCE_HELD;
+  }
+  if (!midi_cc_continuous(cc)) {
+    return MIDI_CC_COALESCE_IN_ORDER;
+  }
+
+  midi_cc_decode(cc, value, slots, &decoded);
+  return midi_cc_coalescer_add(pending, number, decoded) ? MIDI_CC_COALESCE_HELD : MIDI_CC_COALESCE_FULL;
+}
+
+#endif /* SRC_MIDI_CC_TABLE_H */
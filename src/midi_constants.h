@@ -74,6 +74,9 @@ const byte MIDI_CONTROL_CHANGE_SET_GLIDE_TIME_LSB                   = 124; // 7-
 const byte MIDI_CONTROL_CHANGE_SET_GLIDE_TIME                       = 125; // 7-bit value (14-bit total)
 const byte MIDI_CONTROL_CHANGE_TOGGLE_ALL_TEST_BITS                 = 126; // 1-bit value
 const byte MIDI_CONTROL_CHANGE_STATE_DUMP                           = 127; // 7-bit value
+const byte MIDI_STATE_DUMP_HUMAN                                    = 127; // CC 127 values
+const byte MIDI_STATE_DUMP_RESET_TELEMETRY                          = 0;   // bus telemetry (SID_TELEMETRY) and MIDI queue stats
+const byte MIDI_STATE_DUMP_SYSEX                                    = 1;   // the patch, as a SysEx dump (see src/sysex.h), on USB
 
 const byte MIDI_CONTROL_CHANGE_TOGGLE_VOLUME_MODULATION_MODE        = 84; // 1-bit value
 const byte MIDI_CONTROL_CHANGE_TOGGLE_PULSE_WIDTH_MODULATION_MODE   = 83; // 1-bit value
@@ -87,13 +90,22 @@ const byte MIDI_RPN_MASTER_FINE_TUNING                              = 1;
 const byte MIDI_RPN_MASTER_COARSE_TUNING                            = 2;
 const word MIDI_RPN_NULL                                            = 16383;
 
-// below are CC numbers that are defined and we don't implement, but repurposing
-// them in the future might have weird consequences, so we shouldn't
-const byte MIDI_CONTROL_CHANGE_ALL_NOTES_OFF                        = 123;
+// channel mode messages: what a DAW sends when it stops, or when you hit panic
+const byte MIDI_CONTROL_CHANGE_ALL_SOUND_OFF                        = 120; // silences every voice now
+const byte MIDI_CONTROL_CHANGE_RESET_ALL_CONTROLLERS                = 121; // pitch bend and RPN, not the patch
+const byte MIDI_CONTROL_CHANGE_ALL_NOTES_OFF                        = 123; // releases every voice
 
 const byte MIDI_CHANNEL = 0; // "channel 1" (zero-indexed)
 const byte MIDI_PROGRAM_CHANGE_SET_GLOBAL_MODE_PARAPHONIC           = 0;
 const byte MIDI_PROGRAM_CHANGE_SET_GLOBAL_MODE_MONOPHONIC_UNISON    = 1;
+const byte MIDI_PROGRAM_CHANGE_SET_NOTE_PRIORITY_LAST               = 2; // mono: the newest held note sounds
+const byte MIDI_PROGRAM_CHANGE_SET_NOTE_PRIORITY_LOWEST             = 3; // mono: the lowest held note sounds
+const byte MIDI_PROGRAM_CHANGE_SET_NOTE_PRIORITY_HIGHEST            = 4; // mono: the highest held note sounds
+const byte MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_OLDEST            = 5; // paraphonic, all voices busy: steal the longest-playing one
+const byte MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_QUIETEST          = 6; // ...the quietest one
+const byte MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_RELEASED_FIRST    = 7; // ...the quietest released one, or else the oldest
+const byte MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_ROUND_ROBIN       = 8; // the next free voice after the last one used, or else the one after it
+const byte MIDI_PROGRAM_CHANGE_SET_VOICE_STEALING_SAME_NOTE         = 9; // ...one already playing the note, or else released-first
 const byte MIDI_PROGRAM_CHANGE_HARDWARE_RESET                       = 127;
 
 #endif /* SRC_MIDI_CONSTANTS_H */
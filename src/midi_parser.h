@@ -0,0 +1,196 @@
+#ifndef SRC_MIDI_PARSER_H
+#define SRC_MIDI_PARSER_H
+
+#include <stdbool.h>
+#include "util.h"
+
+// Turns a MIDI byte stream into complete messages, one byte at a time, so the
+// caller can hand it whatever's arrived and get on with its loop. One parser
+// per port: each one keeps the partial message and running status for its own
+// stream.
+//
+// Handles what DIN gear actually sends:
+// - running status: a channel message's status byte can be left off when it's
+//   the same as the last one, so `90 3C 40 3E 40` is two note ons
+// - System Real-Time bytes (F8-FF) can come in between any two bytes, even in
+//   the middle of another message. They're events of their own and don't
+//   touch the message they interrupted
+// - System Common messages (F1-F6) and SysEx (F0 ... F7) cancel running
+//   status
+// - data bytes with no status to go with them (e.g. we came in halfway through
+//   a message) are dropped
+//
+// SysEx is skipped, unless the parser's been given a buffer with
+// `midi_parser_set_sysex_buffer()`. Then a complete SysEx message that fits is
+// an event too: status F0, `data_one` its length. The message (without the F0
+// and F7) is in the buffer, and stays there until `midi_parser_release_sysex()`;
+// don't feed the parser any more bytes until then.
+
+struct midi_event {
+  byte status; // with the channel in the low nibble, for channel messages
+  byte data_one; // 0 if the message doesn't have one
+  byte data_two;
+};
+typedef struct midi_event midi_event;
+
+struct midi_parser {
+  byte status; // the message being read, or running status. 0 if none
+  byte data_one;
+  byte data_count; // data bytes of `status` read so far
+  bool in_sysex;
+  byte *sysex; // NULL to skip SysEx
+  byte sysex_size;
+  byte sysex_length; // bytes in `sysex` so far, or 0xFF if they didn't fit
+  bool sysex_pending; // a complete message is in `sysex`
+};
+typedef struct midi_parser midi_parser;
+
+void midi_parser_initialize(midi_parser *p);
+bool midi_parser_feed(midi_parser *p, byte b, midi_event *event);
+void midi_parser_set_sysex_buffer(midi_parser *p, byte *buffer, byte size);
+void midi_parser_release_sysex(midi_parser *p);
+byte midi_event_opcode(const midi_event *event);
+byte midi_event_channel(const midi_event *event);
+// "private" below
+static byte _midi_data_length(byte status);
+
+// O(1)
+void midi_parser_initialize(midi_parser *p) {
+  p->status = 0;
+  p->data_one = 0;
+  p->data_count = 0;
+  p->in_sysex = false;
+  p->sysex = NULL;
+  p->sysex_size = 0;
+  p->sysex_length = 0;
+  p->sysex_pending = false;
+}
+
+// Reads one byte. Returns true, and fills in `event`, if that completed a
+// message; `event` isn't touched otherwise.
+//
+// O(1)
+bool midi_parser_feed(midi_parser *p, byte b, midi_event *event) {
+  if (b >= 0xF8) { // System Real-Time: goes straight through
+    event->status = b;
+    event->data_one = 0;
+    event->data_two = 0;
+    return true;
+  }
+
+  if (b & 0x80) {
+    bool sysex_complete = p->in_sysex && b == 0xF7 && p->sysex && p->sysex_length != 0xFF;
+    p->in_sysex = (b == 0xF0);
+    p->data_count = 0;
+
+    if (sysex_complete) {
+      p->status = 0;
+      p->sysex_pending = true;
+      event->status = 0xF0;
+      event->data_one = p->sysex_length;
+      event->data_two = 0;
+      return true;
+    }
+    p->sysex_length = 0;
+
+    if (b >= 0xF0 && _midi_data_length(b) == 0) {
+      p->status = 0; // no running status after system messages
+      if (b == 0xF6) { // tune request: complete already
+        event->status = b;
+        event->data_one = 0;
+        event->data_two = 0;
+        return true;
+      }
+      return false; // SysEx start/end, or undefined
+    }
+
+    p->status = b;
+    return false;
+  }
+
+  if (p->in_sysex) {
+    if (p->sysex && p->sysex_length < p->sysex_size) {
+      p->sysex[p->sysex_length++] = b;
+    } else {
+      p->sysex_length = 0xFF; // too long: the whole message is dropped
+    }
+    return false;
+  }
+
+  if (p->status == 0) {
+    return false;
+  }
+
+  byte length = _midi_data_length(p->status);
+
+  if (p->data_count == 0 && length == 2) {
+    p->data_one = b;
+    p->data_count = 1;
+    return false;
+  }
+
+  event->status = p->status;
+  event->data_one = length == 2 ? p->data_one : b;
+  event->data_two = length == 2 ? b : 0;
+  p->data_count = 0;
+  if (p->status >= 0xF0) {
+    p->status = 0; // system common messages don't run
+  }
+  return true;
+}
+
+// Collect SysEx messages of up to `size` bytes (not counting F0 and F7) in
+// `buffer`, rather than skip them. `size` has to be under 255.
+//
+// O(1)
+void midi_parser_set_sysex_buffer(midi_parser *p, byte *buffer, byte size) {
+  p->sysex = buffer;
+  p->sysex_size = size;
+  p->sysex_length = 0;
+  p->sysex_pending = false;
+}
+
+// done with the SysEx message in the buffer
+//
+// O(1)
+void midi_parser_release_sysex(midi_parser *p) {
+  p->sysex_pending = false;
+  p->sysex_length = 0;
+}
+
+// e.g. MIDI_NOTE_ON for a note on on any channel
+//
+// O(1)
+byte midi_event_opcode(const midi_event *event) {
+  return event->status >> 4;
+}
+
+// O(1)
+byte midi_event_channel(const midi_event *event) {
+  return event->status & 0B00001111;
+}
+
+// private below
+
+// how many data bytes follow `status`
+static byte _midi_data_length(byte status) {
+  switch (status >> 4) {
+  case 0xC: // program change
+  case 0xD: // channel pressure
+    return 1;
+  case 0xF:
+    switch (status) {
+    case 0xF1: // time code quarter frame
+    case 0xF3: // song select
+      return 1;
+    case 0xF2: // song position
+      return 2;
+    default:
+      return 0;
+    }
+  default:
+    return 2;
+  }
+}
+
+#endif /* SRC_MIDI_PARSER_H */
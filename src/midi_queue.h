@@ -0,0 +1,180 @@
+#ifndef SRC_MIDI_QUEUE_H
+#define SRC_MIDI_QUEUE_H
+
+#include <stdbool.h>
+#include "midi_parser.h"
+#include "util.h"
+
+// Parsed MIDI events from every input port, each stamped with when we read it,
+// waiting to be applied.
+//
+// Each port has its own FIFO, so events from one port stay in order. Popping
+// takes the oldest head across the ports. If two ports' heads arrived at the
+// same time, the port that didn't go last goes first, so a busy port can't
+// starve the other one.
+//
+// Times are the low 16 bits of micros(), and ages are differences, so an event
+// shouldn't wait in here longer than 65ms; with the queue popped every loop,
+// it won't. Latency (arrival to pop) is in microseconds.
+//
+// The size is per port and must be a power of two, so wrapping is a mask. One
+// slot is always left empty, as in sid_queue.h. A full port should stop being
+// read, rather than drop an event: its bytes wait in the port's own buffer.
+
+#ifndef MIDI_QUEUE_SIZE
+#define MIDI_QUEUE_SIZE 8
+#endif
+
+#if (MIDI_QUEUE_SIZE & (MIDI_QUEUE_SIZE - 1)) != 0 || MIDI_QUEUE_SIZE > 128
+#error "MIDI_QUEUE_SIZE must be a power of two no larger than 128"
+#endif
+
+#define MIDI_QUEUE_PORTS 2
+const byte MIDI_QUEUE_MASK = MIDI_QUEUE_SIZE - 1;
+
+struct timed_midi_event {
+  midi_event event;
+  uint16_t arrived; // micros(), low 16 bits
+};
+typedef struct timed_midi_event timed_midi_event;
+
+struct midi_port_queue {
+  timed_midi_event events[MIDI_QUEUE_SIZE];
+  byte head; // next slot to fill
+  byte tail; // next slot to pop
+};
+typedef struct midi_port_queue midi_port_queue;
+
+struct midi_queue {
+  midi_port_queue ports[MIDI_QUEUE_PORTS];
+  byte last_port; // the port popped last, to break ties
+
+  // stats, since the last `midi_queue_reset_stats()`
+  byte max_depth; // high-water mark, all ports together
+  uint16_t max_latency; // micros
+  uint32_t total_latency; // micros, for the mean
+  uint32_t popped;
+};
+typedef struct midi_queue midi_queue;
+
+void midi_queue_empty(midi_queue *q);
+void midi_queue_reset_stats(midi_queue *q);
+byte midi_queue_depth(const midi_queue *q);
+bool midi_queue_full(const midi_queue *q, byte port);
+bool midi_queue_push(midi_queue *q, byte port, const midi_event *event, uint16_t now);
+bool midi_queue_pop(midi_queue *q, uint16_t now, midi_event *out);
+uint16_t midi_queue_mean_latency(const midi_queue *q);
+// "private" below
+static byte _midi_port_queue_depth(const midi_port_queue *p);
+
+// O(1)
+void midi_queue_empty(midi_queue *q) {
+  for (byte port = 0; port < MIDI_QUEUE_PORTS; port++) {
+    q->ports[port].head = 0;
+    q->ports[port].tail = 0;
+  }
+  q->last_port = MIDI_QUEUE_PORTS - 1; // so port 0 goes first
+  midi_queue_reset_stats(q);
+}
+
+// O(1)
+void midi_queue_reset_stats(midi_queue *q) {
+  q->max_depth = 0;
+  q->max_latency = 0;
+  q->total_latency = 0;
+  q->popped = 0;
+}
+
+// events waiting, across every port
+//
+// O(ports)
+byte midi_queue_depth(const midi_queue *q) {
+  byte depth = 0;
+  for (byte port = 0; port < MIDI_QUEUE_PORTS; port++) {
+    depth += _midi_port_queue_depth(&q->ports[port]);
+  }
+  return depth;
+}
+
+// whether `port` has no room for another event
+//
+// O(1)
+bool midi_queue_full(const midi_queue *q, byte port) {
+  return _midi_port_queue_depth(&q->ports[port]) == MIDI_QUEUE_SIZE - 1;
+}
+
+// Returns false if `port` is full.
+//
+// O(ports)
+bool midi_queue_push(midi_queue *q, byte port, const midi_event *event, uint16_t now) {
+  midi_port_queue *p = &q->ports[port];
+
+  if (midi_queue_full(q, port)) {
+    return false;
+  }
+
+  p->events[p->head].event = *event;
+  p->events[p->head].arrived = now;
+  p->head = (p->head + 1) & MIDI_QUEUE_MASK;
+
+  byte depth = midi_queue_depth(q);
+  if (depth > q->max_depth) {
+    q->max_depth = depth;
+  }
+
+  return true;
+}
+
+// The event that's waited longest, across every port. Returns false if
+// there's nothing waiting.
+//
+// O(ports)
+bool midi_queue_pop(midi_queue *q, uint16_t now, midi_event *out) {
+  byte oldest = MIDI_QUEUE_PORTS;
+  uint16_t oldest_age = 0;
+
+  for (byte n = 1; n <= MIDI_QUEUE_PORTS; n++) {
+    byte port = (q->last_port + n) % MIDI_QUEUE_PORTS; // the last port popped is checked last
+    const midi_port_queue *p = &q->ports[port];
+    if (p->head == p->tail) {
+      continue;
+    }
+    uint16_t age = now - p->events[p->tail].arrived;
+    if (oldest == MIDI_QUEUE_PORTS || age > oldest_age) {
+      oldest = port;
+      oldest_age = age;
+    }
+  }
+
+  if (oldest == MIDI_QUEUE_PORTS) {
+    return false;
+  }
+
+  midi_port_queue *p = &q->ports[oldest];
+  *out = p->events[p->tail].event;
+  p->tail = (p->tail + 1) & MIDI_QUEUE_MASK;
+  q->last_port = oldest;
+
+  if (oldest_age > q->max_latency) {
+    q->max_latency = oldest_age;
+  }
+  q->total_latency += oldest_age;
+  q->popped++;
+
+  return true;
+}
+
+// micros from arrival to pop, on average
+//
+// O(1)
+uint16_t midi_queue_mean_latency(const midi_queue *q) {
+  return q->popped ? q->total_latency / q->popped : 0;
+}
+
+// private below
+
+static byte _midi_port_queue_depth(const midi_port_queue *p) {
+  return (byte)(p->head - p->tail) & MIDI_QUEUE_MASK;
+}
+
+#endif /* SRC_MIDI_QUEUE_H */
@@ -2,21 +2,51 @@
 #define SRC_NOTE_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// Note timestamps are 16-bit milliseconds ("ticks"), which is 2 bytes a
+// timestamp instead of 4 but wraps every ~65s. So:
+// - 0 means "never"; `note_ticks_from_millis` never returns it
+// - only ever compare ticks by subtracting them (`note_ticks_since`)
+// - anything that needs ages past NOTE_TICKS_MAX_AGE has to clamp them with
+//   `note_ticks_clamp_age` before they wrap
+typedef uint16_t note_ticks;
+
+#define NOTE_TICKS_PER_SECOND 1000
+#define NOTE_TICKS_MAX_AGE 60000
 
 struct note {
   unsigned char number;
   // The midi note number.
-  unsigned long on_time;
-  // The time we got the midi "note on" message. 0 if none so far
-  unsigned long off_time;
-  // The time we got the midi "note off" message. 0 if none so far
   unsigned char voiced_by_oscillator;
   // The oscillator currently sounding the note.
   // -1 if no oscillator is voicing it (e.g. in a legato run, with 5 notes held
   // down, only the last one should be voiced. But we need to keep track of all
   // the "held" notes in case the user releases some of them.)
+  note_ticks on_time;
+  // The time we got the midi "note on" message. 0 if none so far
+  note_ticks off_time;
+  // The time we got the midi "note off" message. 0 if none so far
 };
 
 typedef struct note note;
 
+static inline note_ticks note_ticks_from_millis(unsigned long millis) {
+  note_ticks ticks = (note_ticks)millis;
+  return ticks ? ticks : 1;
+}
+
+// how long ago `then` was, correct across wraparound
+static inline note_ticks note_ticks_since(note_ticks now, note_ticks then) {
+  return (note_ticks)(now - then);
+}
+
+// moves `*then` forward so it never looks older than NOTE_TICKS_MAX_AGE. Call
+// it at least once every few seconds on timestamps that can get that old.
+static inline void note_ticks_clamp_age(note_ticks *then, note_ticks now) {
+  if (*then != 0 && note_ticks_since(now, *then) > NOTE_TICKS_MAX_AGE) {
+    *then = note_ticks_from_millis((note_ticks)(now - NOTE_TICKS_MAX_AGE));
+  }
+}
+
 #endif /* SRC_NOTE_H */
@@ -0,0 +1,60 @@
+#ifndef SRC_NOTE_PRIORITY_H
+#define SRC_NOTE_PRIORITY_H
+
+#include "note_table.h"
+
+// Which held note a mono voice should be playing:
+// - NOTE_PRIORITY_LAST: the most recently pressed
+// - NOTE_PRIORITY_LOWEST: the lowest, like most analog monosynths (good for
+//   bass lines: a passing higher note never steals the root)
+// - NOTE_PRIORITY_HIGHEST: the highest (good for leads over a held drone)
+//
+// Every lookup is O(1) on the note_table, so a fast trill costs the same with
+// one note held as with twenty, and the same notes held always give the same
+// answer whatever order they came in (except for NOTE_PRIORITY_LAST, where the
+// order is the point).
+
+#define NOTE_PRIORITY_LAST 0
+#define NOTE_PRIORITY_LOWEST 1
+#define NOTE_PRIORITY_HIGHEST 2
+
+byte note_priority_select(const note_table *t, byte priority);
+byte note_priority_select_without(const note_table *t, byte priority, byte released);
+
+// the held note that should sound, or NOTE_TABLE_NONE if none are held
+//
+// O(1)
+byte note_priority_select(const note_table *t, byte priority) {
+  switch (priority) {
+  case NOTE_PRIORITY_LOWEST:
+    return note_table_lowest_from(t, 0);
+  case NOTE_PRIORITY_HIGHEST:
+    return note_table_highest_from(t, NOTE_TABLE_SIZE - 1);
+  default:
+    return note_table_last(t);
+  }
+}
+
+// the held note that should sound once `released` is let go (whether or not
+// it's been removed from `t` yet), or NOTE_TABLE_NONE
+//
+// O(1)
+byte note_priority_select_without(const note_table *t, byte priority, byte released) {
+  released &= 0x7F;
+  byte selected = note_priority_select(t, priority);
+
+  if (selected != released) {
+    return selected;
+  }
+
+  switch (priority) {
+  case NOTE_PRIORITY_LOWEST:
+    return note_table_lowest_from(t, released + 1);
+  case NOTE_PRIORITY_HIGHEST:
+    return released == 0 ? NOTE_TABLE_NONE : note_table_highest_from(t, released - 1);
+  default:
+    return note_table_previous(t, released);
+  }
+}
+
+#endif /* SRC_NOTE_PRIORITY_H */
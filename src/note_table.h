@@ -0,0 +1,249 @@
+#ifndef SRC_NOTE_TABLE_H
+#define SRC_NOTE_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "util.h"
+
+// The notes being held down, in the order they were pressed. Fixed-size, no
+// heap, no hashing.
+//
+// Keys are MIDI note numbers, so rather than hashing them we index straight
+// into arrays of NOTE_TABLE_SIZE:
+// - `held` is a 128-bit presence bitmap: lookup is a shift and a mask
+// - `held_bytes` has a bit set for each byte of `held` that isn't 0, so the
+//   lowest or highest held note is two count-trailing/leading-zeros away,
+//   however many notes are held
+// - `previous`/`next` link the held notes into a doubly-linked list by note
+//   number, which keeps insertion order: O(1) oldest/newest, append, prepend,
+//   and removal by note number
+//
+// The list is circular through one extra slot, NOTE_TABLE_NONE: its `next` is
+// the oldest note and its `previous` the newest. That way linking and unlinking
+// never have to special-case the ends, and `note_table_first()` on an empty
+// table returns NOTE_TABLE_NONE without a branch.
+//
+// Note numbers are masked to 7 bits, so anything a MIDI parser hands us is a
+// valid index.
+//
+// RAM: 16 + 2 + 129 + 129 + 1 = 277 bytes on the AVR, with no allocator overhead.
+// The deque + hash table it replaced took 16 + 6 + 16 * 18 = 310 bytes of heap
+// for at most 16 notes.
+
+#define NOTE_TABLE_SIZE 128
+#define NOTE_TABLE_NONE NOTE_TABLE_SIZE // the sentinel slot; never a note
+
+struct note_table {
+  byte held[NOTE_TABLE_SIZE / 8];
+  uint16_t held_bytes;
+  byte previous[NOTE_TABLE_SIZE + 1];
+  byte next[NOTE_TABLE_SIZE + 1];
+  byte length;
+};
+typedef struct note_table note_table;
+
+void note_table_empty(note_table *t);
+bool note_table_contains(const note_table *t, byte note);
+void note_table_append(note_table *t, byte note);
+void note_table_prepend(note_table *t, byte note);
+bool note_table_remove(note_table *t, byte note);
+byte note_table_remove_first(note_table *t);
+byte note_table_remove_last(note_table *t);
+byte note_table_first(const note_table *t);
+byte note_table_last(const note_table *t);
+byte note_table_previous(const note_table *t, byte note);
+byte note_table_next(const note_table *t, byte note);
+byte note_table_lowest_from(const note_table *t, unsigned int from);
+byte note_table_highest_from(const note_table *t, unsigned int from);
+void note_table_inspect(const note_table *t, FILE *stream);
+// "private" below
+static inline void _note_table_link(note_table *t, byte note, byte previous, byte next);
+static inline void _note_table_unlink(note_table *t, byte note);
+static inline byte _note_table_top_bit(unsigned int bits);
+
+// O(NOTE_TABLE_SIZE / 8)
+void note_table_empty(note_table *t) {
+  memset(t->held, 0, sizeof(t->held));
+  t->held_bytes = 0;
+  t->previous[NOTE_TABLE_NONE] = NOTE_TABLE_NONE;
+  t->next[NOTE_TABLE_NONE] = NOTE_TABLE_NONE;
+  t->length = 0;
+}
+
+// O(1)
+bool note_table_contains(const note_table *t, byte note) {
+  note &= 0x7F;
+  return (t->held[note >> 3] >> (note & 7)) & 1;
+}
+
+// Makes `note` the newest note. If it's already held, it's moved, not
+// duplicated.
+//
+// O(1)
+void note_table_append(note_table *t, byte note) {
+  note &= 0x7F;
+  _note_table_unlink(t, note);
+  _note_table_link(t, note, t->previous[NOTE_TABLE_NONE], NOTE_TABLE_NONE);
+}
+
+// Makes `note` the oldest note. If it's already held, it's moved, not
+// duplicated.
+//
+// O(1)
+void note_table_prepend(note_table *t, byte note) {
+  note &= 0x7F;
+  _note_table_unlink(t, note);
+  _note_table_link(t, note, NOTE_TABLE_NONE, t->next[NOTE_TABLE_NONE]);
+}
+
+// returns whether `note` was held
+//
+// O(1)
+bool note_table_remove(note_table *t, byte note) {
+  note &= 0x7F;
+  bool was_held = note_table_contains(t, note);
+  _note_table_unlink(t, note);
+  return was_held;
+}
+
+// returns the oldest note, or NOTE_TABLE_NONE if there are none
+//
+// O(1)
+byte note_table_remove_first(note_table *t) {
+  byte first = t->next[NOTE_TABLE_NONE];
+  if (first != NOTE_TABLE_NONE) {
+    _note_table_unlink(t, first);
+  }
+  return first;
+}
+
+// returns the newest note, or NOTE_TABLE_NONE if there are none
+//
+// O(1)
+byte note_table_remove_last(note_table *t) {
+  byte last = t->previous[NOTE_TABLE_NONE];
+  if (last != NOTE_TABLE_NONE) {
+    _note_table_unlink(t, last);
+  }
+  return last;
+}
+
+// the oldest note, or NOTE_TABLE_NONE
+//
+// O(1)
+byte note_table_first(const note_table *t) {
+  return t->next[NOTE_TABLE_NONE];
+}
+
+// the newest note, or NOTE_TABLE_NONE
+//
+// O(1)
+byte note_table_last(const note_table *t) {
+  return t->previous[NOTE_TABLE_NONE];
+}
+
+// the next-older held note, or NOTE_TABLE_NONE. `note` must be held.
+//
+// O(1)
+byte note_table_previous(const note_table *t, byte note) {
+  return t->previous[note & 0x7F];
+}
+
+// the next-newer held note, or NOTE_TABLE_NONE. `note` must be held.
+//
+// O(1)
+byte note_table_next(const note_table *t, byte note) {
+  return t->next[note & 0x7F];
+}
+
+// the lowest held note that's `from` or higher, or NOTE_TABLE_NONE. So
+// `note_table_lowest_from(t, 0)` is the lowest note held.
+//
+// O(1)
+byte note_table_lowest_from(const note_table *t, unsigned int from) {
+  if (from >= NOTE_TABLE_SIZE) {
+    return NOTE_TABLE_NONE;
+  }
+
+  byte i = from >> 3;
+  byte bits = t->held[i] & (byte)(0xFF << (from & 7));
+  if (bits) {
+    return (i << 3) + __builtin_ctz(bits);
+  }
+
+  uint16_t above = t->held_bytes & (uint16_t)(0xFFFEu << i);
+  if (!above) {
+    return NOTE_TABLE_NONE;
+  }
+  i = __builtin_ctz(above);
+  return (i << 3) + __builtin_ctz(t->held[i]);
+}
+
+// the highest held note that's `from` or lower, or NOTE_TABLE_NONE. So
+// `note_table_highest_from(t, NOTE_TABLE_SIZE - 1)` is the highest note held.
+//
+// O(1)
+byte note_table_highest_from(const note_table *t, unsigned int from) {
+  if (from >= NOTE_TABLE_SIZE) {
+    from = NOTE_TABLE_SIZE - 1;
+  }
+
+  byte i = from >> 3;
+  byte bits = t->held[i] & (byte)(0xFF >> (7 - (from & 7)));
+  if (bits) {
+    return (i << 3) + _note_table_top_bit(bits);
+  }
+
+  uint16_t below = t->held_bytes & (uint16_t)((1u << i) - 1);
+  if (!below) {
+    return NOTE_TABLE_NONE;
+  }
+  i = _note_table_top_bit(below);
+  return (i << 3) + _note_table_top_bit(t->held[i]);
+}
+
+// O(n)
+void note_table_inspect(const note_table *t, FILE *stream) {
+  fprintf(stream, "nt(%u): ", t->length);
+
+  for (byte n = note_table_first(t); n != NOTE_TABLE_NONE; n = note_table_next(t, n)) {
+    fprintf(stream, n == note_table_first(t) ? "%u" : "-%u", n);
+  }
+
+  fprintf(stream, "%s", "\n");
+}
+
+// private below
+
+// `note` must not be held
+static inline void _note_table_link(note_table *t, byte note, byte previous, byte next) {
+  t->previous[note] = previous;
+  t->next[note] = next;
+  t->next[previous] = note;
+  t->previous[next] = note;
+  t->held[note >> 3] |= (1 << (note & 7));
+  t->held_bytes |= (uint16_t)(1u << (note >> 3));
+  t->length++;
+}
+
+// does nothing if `note` isn't held
+static inline void _note_table_unlink(note_table *t, byte note) {
+  if (!note_table_contains(t, note)) {
+    return;
+  }
+  t->next[t->previous[note]] = t->next[note];
+  t->previous[t->next[note]] = t->previous[note];
+  t->held[note >> 3] &= ~(1 << (note & 7));
+  if (!t->held[note >> 3]) {
+    t->held_bytes &= (uint16_t)~(1u << (note >> 3));
+  }
+  t->length--;
+}
+
+// `bits` must not be 0
+static inline byte _note_table_top_bit(unsigned int bits) {
+  return (sizeof(unsigned int) * 8 - 1) - __builtin_clz(bits);
+}
+
+#endif /* SRC_NOTE_TABLE_H */
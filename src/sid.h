@@ -2,23 +2,14 @@
 #define SRC_SID_H
 
 #include <stdbool.h>
+#include "sid_queue.h"
+#include "sid_transport.h"
 #include "util.h"
 
 // will be defined in SID.ino
-extern void clock_high();
-extern void clock_low();
-extern void cs_high();
-extern void cs_low();
-
-// hack to get this running in test environments. PORT* are defined in avr/*.h
-#ifndef PORTB
-  byte PORTB = 0B00000000;
-#endif /* PORTB */
-
-#ifndef PORTF
-  byte PORTF = 0B00000000;
-#endif /* PORTF */
+extern void sid_bus_drain_start(); // (re)arms the ISR that calls `sid_queue_drain_one`
 
+// hack to get this running in test environments
 #ifndef cli
   void cli() {};
 #endif
@@ -27,6 +18,25 @@ extern void cs_low();
   void sei() {};
 #endif
 
+// how many SIDs share the data/address bus, each with its own CS line. Voices
+// are numbered across chips: voice 3 is the first voice of the second chip.
+// Filter and volume registers are global, so setters write them on every chip.
+#ifndef SID_NUM_CHIPS
+#define SID_NUM_CHIPS 1
+#endif
+
+#if SID_NUM_CHIPS < 1 || SID_NUM_CHIPS > 4
+#error "SID_NUM_CHIPS must be between 1 and 4 (two chip bits in a bus address)"
+#endif
+
+#define SID_VOICES (3 * SID_NUM_CHIPS)
+
+// the firmware defines SID_AVR_BUS_INLINE so register writes skip `sid_bus`
+// and go straight to the port pins
+#ifdef SID_AVR_BUS_INLINE
+#include "sid_avr_bus.h"
+#endif
+
 const byte SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO   = 0;
 const byte SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI   = 1;
 const byte SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_LO = 2;
@@ -64,6 +74,45 @@ const float SID_MAX_OSCILLATOR_HERTZ = 3951.06;
 // SID expects a 1Mhz clock signal on which to calculate oscillator frequencies
 const float CLOCK_SIGNAL_FACTOR = 0.059604644775390625;
 
+// `note_frequency_lookup_table` divided by CLOCK_SIGNAL_FACTOR: the value each
+// midi note needs in a voice's frequency registers. B7 (95) is just above what
+// a 1MHz SID can play, so it's clamped to the highest register value.
+const uint16_t sid_note_register_words[96] PROGMEM = {
+    274,   291,   308,   326,   346,   366,   388,   411,
+    435,   461,   489,   518,   549,   581,   616,   652,
+    691,   732,   776,   822,   871,   923,   978,  1036,
+   1097,  1163,  1232,  1305,  1383,  1465,  1552,  1644,
+   1742,  1845,  1955,  2071,  2195,  2325,  2463,  2610,
+   2765,  2930,  3104,  3288,  3484,  3691,  3910,  4143,
+   4389,  4650,  4927,  5220,  5530,  5859,  6207,  6577,
+   6968,  7382,  7821,  8286,  8779,  9301,  9854, 10440,
+  11060, 11718, 12415, 13153, 13935, 14764, 15642, 16572,
+  17557, 18601, 19708, 20879, 22121, 23436, 24830, 26306,
+  27871, 29528, 31284, 33144, 35115, 37203, 39415, 41759,
+  44242, 46873, 49660, 52613, 55741, 59056, 62567, 65535,
+};
+
+// pitch offsets (bend, detune) are in 1/256ths of a semitone, so they can be
+// added together and scaled without ever leaving integer math
+const long SID_PITCH_OFFSET_SEMITONE = 256;
+const long SID_PITCH_OFFSET_OCTAVE = 12 * SID_PITCH_OFFSET_SEMITONE;
+
+// C7 is the highest C whose register value fits in 16 bits, so it's our most
+// precise reference for computing any other pitch. Lower octaves are shifts.
+const uint32_t SID_C7_REGISTER_WORD = 35114;
+
+// (2^(i/48) - 1) in Q15, for i = 0..48: one octave in quarter-semitone steps.
+// Linear interpolation between neighbours is good to ~0.05 cents.
+const uint16_t sid_octave_fraction_q15[49] PROGMEM = {
+      0,   477,   960,  1451,  1948,  2453,  2966,  3486,
+   4013,  4548,  5091,  5641,  6200,  6767,  7342,  7925,
+   8517,  9118,  9727, 10345, 10972, 11608, 12254, 12909,
+  13573, 14247, 14931, 15625, 16329, 17043, 17767, 18502,
+  19248, 20005, 20772, 21551, 22341, 23143, 23956, 24781,
+  25618, 26467, 27329, 28203, 29090, 29989, 30902, 31828,
+  32768,
+};
+
 const float sid_attack_values_to_seconds[16] = {
   0.002,
   0.008,
@@ -105,9 +154,44 @@ const float sid_decay_and_release_values_to_seconds[16] = {
 // since we have to set all the bits in a register byte at once,
 // we must maintain a copy of the register's state so we don't clobber bits
 // (SID actually has 28 registers but we don't use the last 4. hence 25)
-byte sid_state_bytes[25] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-
+//
+// Indexed by bus address, so each chip gets a 32-byte stride (see
+// sid_transport.h). The last chip only needs its 25.
+#define SID_STATE_SIZE (((SID_NUM_CHIPS - 1) << 5) + 25)
+byte sid_state_bytes[SID_STATE_SIZE] = {0};
+
+#include "sid_telemetry.h"
+
+// transactions: between `sid_begin()` and `sid_commit()`, `sid_transfer` only
+// updates `sid_state_bytes` and marks the register dirty (one bit per
+// register, one mask per chip). `sid_commit()` then sends each dirty register
+// to the SID once, all inside a single critical section.
+uint32_t sid_dirty_registers[SID_NUM_CHIPS] = {0};
+byte sid_transaction_depth = 0;
+
+// bits in a voice control register that the SID reacts to on an *edge*
+// (e.g. gate off -> on retriggers the envelope). If one of these flips while
+// the register is already dirty we flush the pending value first, otherwise the
+// two writes would coalesce and the edge would never reach the chip.
+const byte SID_EDGE_BITS = SID_GATE | SID_TEST;
+const uint32_t SID_VOICE_CONTROL_REGISTERS =
+  (1UL << (0 * 7 + SID_REGISTER_OFFSET_VOICE_CONTROL)) |
+  (1UL << (1 * 7 + SID_REGISTER_OFFSET_VOICE_CONTROL)) |
+  (1UL << (2 * 7 + SID_REGISTER_OFFSET_VOICE_CONTROL));
+
+// where register writes end up. See sid_transport.h.
+sid_transport *sid_bus = &sid_null_transport;
+
+// when enabled, register writes go into `sid_write_queue` and an ISR puts them
+// on the bus at a fixed rate, instead of the main loop bit-banging them inline
+bool sid_queue_enabled = false;
+sid_queue sid_write_queue;
+
+byte sid_voice_address(byte voice, byte offset);
 void sid_transfer(byte address, byte data);
+void sid_begin();
+void sid_commit();
+bool sid_queue_drain_one();
 void sid_zero_all_registers();
 void sid_set_volume(byte level);
 void sid_set_waveform(byte voice, byte waveform_mask, bool on);
@@ -124,7 +208,10 @@ void sid_set_filter_resonance(byte amount);
 void sid_set_filter(byte voice, bool on);
 void sid_set_filter_mode(byte mode, bool on);
 void sid_set_voice_frequency(byte voice, float hertz);
+void sid_set_voice_frequency_register(byte voice, word frequency); // 16-bit value
 void sid_set_gate(byte voice, bool state);
+word sid_pitch_register_word(long pitch);
+word sid_note_register_word(byte note, long pitch_offset);
 // NB: getters return our current tally of what we've sent to the SID. We can't actually read register values from SID.
 word get_voice_frequency_register_value(byte voice);
 float get_voice_frequency(byte voice);
@@ -143,193 +230,297 @@ byte get_filter_resonance();
 byte get_volume();
 bool get_filter_enabled_for_voice(byte voice);
 
+// "private": puts one byte on the bus. Caller is responsible for interrupts.
+static inline void _sid_bus_write(byte address, byte data) {
+  uint16_t started = _sid_telemetry_bus_write_begin();
+
+#ifdef SID_AVR_BUS_INLINE
+  sid_avr_bus_write(address, data);
+#else
+  sid_bus->write(sid_bus->context, address, data);
+#endif
+
+  _sid_telemetry_bus_write_end(address, started);
+}
+
+// "private": `cli()`/`sei()`, plus measuring the window in between
+static inline void _sid_interrupts_off() {
+  cli(); // same as `noInterrupts()`
+  sid_telemetry_critical_begin();
+}
+
+static inline void _sid_interrupts_on() {
+  sid_telemetry_critical_end();
+  sei(); // same as `interrupts()`
+}
+
+// "private": hands one write to the bus-drain ISR
+static void _sid_enqueue(byte address, byte data) {
+  // the ISR can't keep up, so drain the oldest write ourselves. That keeps the
+  // writes in order and bounds how long we wait.
+  while (!sid_queue_push(&sid_write_queue, address, data)) {
+    _sid_interrupts_off();
+    sid_queue_drain_one();
+    _sid_interrupts_on();
+  }
+
+  sid_bus_drain_start();
+}
+
+// "private": queued or inline, depending on `sid_queue_enabled`
+static void _sid_write(byte address, byte data) {
+  if (sid_queue_enabled) {
+    _sid_enqueue(address, data);
+    return;
+  }
+
+  _sid_interrupts_off();
+  _sid_bus_write(address, data);
+  _sid_interrupts_on();
+}
+
+// Called from the bus-drain ISR (interrupts already off). Returns false once the
+// queue is empty so the ISR can disarm itself.
+bool sid_queue_drain_one() {
+  sid_write w;
+
+  if (!sid_queue_pop(&sid_write_queue, &w)) {
+    return false;
+  }
+
+  _sid_bus_write(w.address, w.data);
+  return true;
+}
+
+// the bus address of one of a voice's registers
+byte sid_voice_address(byte voice, byte offset) {
+#if SID_NUM_CHIPS == 1
+  return (voice * 7) + offset;
+#else
+  return sid_chip_address(voice / 3, ((voice % 3) * 7) + offset);
+#endif
+}
+
 void sid_transfer(byte address, byte data) {
-  address &= 0B00011111;
+  byte chip = sid_address_chip(address);
+  if (chip >= SID_NUM_CHIPS) {
+    return;
+  }
 
   // optimization: don't send anything if SID already has that data in that register
   if (sid_state_bytes[address] == data) {
+    _sid_telemetry_suppressed();
     return;
   }
 
-  // PORTF is a weird 6-bit register (8 bits, but bits 2 and 3 don't exist)
-  //
-  // Port F Data Register — PORTF
-  // bit  7    6    5    4    3    2    1    0
-  //      F7   F6   F5   F4   -    -    F1   F0
-  //
-  // addr -    A4   A3   A2   -    -    A1   A0
+  if (sid_transaction_depth > 0) {
+    uint32_t bit = 1UL << sid_address_register(address);
 
-  byte data_for_port_f = ((address << 2) & 0B01110000) | (address & 0B00000011);
+    if ((sid_dirty_registers[chip] & bit) &&
+        (SID_VOICE_CONTROL_REGISTERS & bit) &&
+        ((sid_state_bytes[address] ^ data) & SID_EDGE_BITS)) {
+      _sid_write(address, sid_state_bytes[address]);
+    } else if (sid_dirty_registers[chip] & bit) {
+      _sid_telemetry_coalesced();
+    }
 
-  cli(); // same as `noInterrupts()`
+    sid_state_bytes[address] = data;
+    sid_dirty_registers[chip] |= bit;
+    return;
+  }
 
-  clock_high();
-  clock_low();
+  _sid_write(address, data);
+
+  sid_state_bytes[address] = data;
+}
 
-  PORTF = data_for_port_f;
-  PORTB = data;
+// transactions nest; only the outermost `sid_commit()` touches the bus
+void sid_begin() {
+  sid_transaction_depth++;
+}
 
-  cs_low();
-  clock_high();
+void sid_commit() {
+  if (sid_transaction_depth == 0 || --sid_transaction_depth > 0) {
+    return;
+  }
 
-  clock_low();
-  cs_high();
+  if (!sid_queue_enabled) {
+    _sid_interrupts_off();
+  }
 
-  sei(); // same as `interrupts()`
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    uint32_t dirty = sid_dirty_registers[chip];
 
-  sid_state_bytes[address] = data;
+    for (byte reg = 0; dirty != 0; reg++, dirty >>= 1) {
+      if (dirty & 1) {
+        byte address = sid_chip_address(chip, reg);
+
+        if (sid_queue_enabled) {
+          _sid_enqueue(address, sid_state_bytes[address]);
+        } else {
+          _sid_bus_write(address, sid_state_bytes[address]);
+        }
+      }
+    }
+
+    sid_dirty_registers[chip] = 0;
+  }
+
+  if (!sid_queue_enabled) {
+    _sid_interrupts_on();
+  }
 }
 
 void sid_zero_all_registers() {
-  for (byte i = 0; i < 25; i++) {
-    sid_transfer(i, 0B00000000);
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    for (byte i = 0; i < 25; i++) {
+      sid_transfer(sid_chip_address(chip, i), 0B00000000);
+    }
   }
 }
 
 void sid_set_volume(byte level) {
-  byte address = SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME;
-  byte data = (sid_state_bytes[address] & 0B11110000) | (level & 0B00001111);
-  sid_transfer(address, data);
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    byte address = sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME);
+    byte data = (sid_state_bytes[address] & 0B11110000) | (level & 0B00001111);
+    sid_transfer(address, data);
+  }
 }
 
-void sid_zero_waveform(byte voice) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL;
-  byte data = sid_state_bytes[address] & 0B00001111;
-  sid_transfer(address, data);
-};
-
-// waveform bits are additive!
-// e.g. turning on square and noise results in some combination of the two
-void sid_set_waveform(byte voice, byte waveform_mask, bool on) {
-  waveform_mask &= 0B11110000; // ensure we can't overwrite the last nibble, which contains data unrelated to the voice's waveform
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL;
+// "private": the register-level halves of the voice setters. The setters below
+// resolve a runtime voice to an address and call these; `sid_voice<V>` (C++
+// only, at the end of this file) calls them with compile-time addresses.
+static inline void _sid_set_bits(byte address, byte mask, bool on) {
   byte data = sid_state_bytes[address];
 
   if (on) {
-    data |= waveform_mask;
+    data |= mask;
   } else {
-    data &= ~waveform_mask;
+    data &= ~mask;
   }
 
   sid_transfer(address, data);
 }
 
- // ring mod repurposes the output of the triangle oscillator
-void sid_set_ring_mod(byte voice, bool on) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL;
-  byte data = sid_state_bytes[address];
-
-  if (on) {
-    data |= SID_RING;
-  } else {
-    data &= ~SID_RING;
-  }
+static inline void _sid_set_high_nibble(byte address, byte value) {
+  byte data = sid_state_bytes[address] & 0B00001111;
+  data |= (value << 4);
+  sid_transfer(address, data);
+}
 
+static inline void _sid_set_low_nibble(byte address, byte value) {
+  byte data = sid_state_bytes[address] & 0B11110000;
+  data |= (value & 0B00001111);
   sid_transfer(address, data);
 }
 
-void sid_set_test(byte voice, bool on) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL;
-  byte data = sid_state_bytes[address];
+// `address_lo` is the voice's PULSE_WIDTH_LO register; HI follows it
+static inline void _sid_set_pulse_width_at(byte address_lo, word hertz) { // 12-bit value
+  byte hi = highByte(hertz) & 0B00001111;
+  byte lo = lowByte(hertz);
+  sid_transfer(address_lo + 1, hi);
+  sid_transfer(address_lo, lo);
+}
 
-  if (on) {
-    data |= SID_TEST;
+// `address_lo` is the voice's FREQUENCY_LO register; HI follows it
+static inline void _sid_set_frequency_register_at(byte address_lo, word frequency) {
+  byte hiFrequency = highByte(frequency);
+  byte loFrequency = lowByte(frequency);
+
+  // optimization: if the voice's frequency hasn't changed, don't send it
+  if (hiFrequency != sid_state_bytes[address_lo + 1]) {
+    sid_transfer(address_lo + 1, hiFrequency);
+  } else {
+    _sid_telemetry_suppressed();
+  }
+
+  if (loFrequency != sid_state_bytes[address_lo]) {
+    sid_transfer(address_lo, loFrequency);
   } else {
-    data &= ~SID_TEST;
+    _sid_telemetry_suppressed();
   }
+}
 
+void sid_zero_waveform(byte voice) {
+  byte address = sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL);
+  byte data = sid_state_bytes[address] & 0B00001111;
   sid_transfer(address, data);
+};
+
+// waveform bits are additive!
+// e.g. turning on square and noise results in some combination of the two
+void sid_set_waveform(byte voice, byte waveform_mask, bool on) {
+  waveform_mask &= 0B11110000; // ensure we can't overwrite the last nibble, which contains data unrelated to the voice's waveform
+  _sid_set_bits(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL), waveform_mask, on);
 }
 
-void sid_set_sync(byte voice, bool on) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL;
-  byte data = sid_state_bytes[address];
+ // ring mod repurposes the output of the triangle oscillator
+void sid_set_ring_mod(byte voice, bool on) {
+  _sid_set_bits(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL), SID_RING, on);
+}
 
-  if (on) {
-    data |= SID_SYNC;
-  } else {
-    data &= ~SID_SYNC;
-  }
+void sid_set_test(byte voice, bool on) {
+  _sid_set_bits(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL), SID_TEST, on);
+}
 
-  sid_transfer(address, data);
+void sid_set_sync(byte voice, bool on) {
+  _sid_set_bits(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL), SID_SYNC, on);
 }
 
 void sid_set_attack(byte voice, byte attack) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD;
-  byte data = sid_state_bytes[address] & 0B00001111;
-  data |= (attack << 4);
-  sid_transfer(address, data);
+  _sid_set_high_nibble(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD), attack);
 }
 
 void sid_set_decay(byte voice, byte decay) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD;
-  byte data = sid_state_bytes[address] & 0B11110000;
-  data |= (decay & 0B00001111);
-  sid_transfer(address, data);
+  _sid_set_low_nibble(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD), decay);
 }
 
 void sid_set_sustain(byte voice, byte sustain) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR;
-  byte data = sid_state_bytes[address] & 0B00001111;
-  data |= (sustain << 4);
-  sid_transfer(address, data);
+  _sid_set_high_nibble(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR), sustain);
 }
 
 void sid_set_release(byte voice, byte release) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR;
-  byte data = sid_state_bytes[address] & 0B11110000;
-  data |= (release & 0B00001111);
-  sid_transfer(address, data);
+  _sid_set_low_nibble(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR), release);
 }
 
 void sid_set_pulse_width(byte voice, word hertz) { // 12-bit value
-  byte hi = highByte(hertz) & 0B00001111;
-  byte lo = lowByte(hertz);
-  byte address_hi = (voice * 7) + SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_HI;
-  byte address_lo = (voice * 7) + SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_LO;
-  sid_transfer(address_hi, hi);
-  sid_transfer(address_lo, lo);
+  _sid_set_pulse_width_at(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_LO), hertz);
 }
 
 void sid_set_filter_frequency(word hertz) { // 11-bit value
   byte hi = highByte(hertz << 5);
   byte lo = lowByte(hertz) & 0B00000111;
-  sid_transfer(SID_REGISTER_ADDRESS_FILTER_FREQUENCY_HI, hi);
-  sid_transfer(SID_REGISTER_ADDRESS_FILTER_FREQUENCY_LO, lo);
+
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    sid_transfer(sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_FREQUENCY_HI), hi);
+    sid_transfer(sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_FREQUENCY_LO), lo);
+  }
 }
 
 void sid_set_filter_resonance(byte amount) {
-  byte address = SID_REGISTER_ADDRESS_FILTER_RESONANCE;
-  byte data = (sid_state_bytes[address] & 0B00001111) | (amount << 4);
-  sid_transfer(address, data);
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    byte address = sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_RESONANCE);
+    byte data = (sid_state_bytes[address] & 0B00001111) | (amount << 4);
+    sid_transfer(address, data);
+  }
+}
+
+// "private": routes voices (or EXT IN) of one chip through its filter
+static void _sid_set_filter_routing(byte chip, byte voice_filter_mask, bool on) {
+  _sid_set_bits(sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_RESONANCE), voice_filter_mask, on);
 }
 
 void sid_set_filter(byte voice, bool on) {
-  voice = constrain(voice, 0, 3); // allow `3` to mean "ext filt on/off"
+  voice = constrain(voice, 0, SID_VOICES); // allow `SID_VOICES` to mean "ext filt on/off"
 
-  byte address = SID_REGISTER_ADDRESS_FILTER_RESONANCE;
-  byte data = sid_state_bytes[address];
-  byte voice_filter_mask = 0;
-
-  if (voice == 0) {
-    voice_filter_mask = SID_FILTER_VOICE1;
-  } else if(voice == 1) {
-    voice_filter_mask = SID_FILTER_VOICE2;
-  } else if(voice == 2) {
-    voice_filter_mask = SID_FILTER_VOICE3;
-  } else if(voice == 3) { // allow `3` to mean "ext filt on/off"
-    voice_filter_mask = SID_FILTER_EXT;
-  } else {
+  if (voice == SID_VOICES) { // ext filt on/off, for every chip
+    for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+      _sid_set_filter_routing(chip, SID_FILTER_EXT, on);
+    }
     return;
   }
 
-  if (on) {
-    data |= voice_filter_mask;
-  } else {
-    data &= ~voice_filter_mask;
-  }
-
-  sid_transfer(address, data);
+  _sid_set_filter_routing(voice / 3, SID_FILTER_VOICE1 << (voice % 3), on);
 }
 
 // filter modes are additive (e.g. you can set LP & HP simultaneously)
@@ -338,53 +529,83 @@ void sid_set_filter(byte voice, bool on) {
 // const byte SID_FILTER_BP     = 0B00100000;
 // const byte SID_FILTER_LP     = 0B00010000;
 void sid_set_filter_mode(byte mode, bool on) {
-  byte address = SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME;
-  byte data = sid_state_bytes[address];
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    byte address = sid_chip_address(chip, SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME);
+    byte data = sid_state_bytes[address];
 
-  if (on) {
-    data |= mode;
-  } else {
-    data &= ~mode;
-  }
+    if (on) {
+      data |= mode;
+    } else {
+      data &= ~mode;
+    }
 
-  sid_transfer(address, data);
+    sid_transfer(address, data);
+  }
 }
 
 void sid_set_voice_frequency(byte voice, float hertz) {
-  word frequency = round(hertz / CLOCK_SIGNAL_FACTOR);
-  byte hiFrequency = highByte(frequency);
-  byte loFrequency = lowByte(frequency);
+  sid_set_voice_frequency_register(voice, round(hertz / CLOCK_SIGNAL_FACTOR));
+}
 
-  // optimization: if the voice's frequency hasn't changed, don't send it
-  word prev = get_voice_frequency_register_value(voice);
-  if (hiFrequency != highByte(prev)) {
-    byte hiAddress = (voice * 7) + SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI;
-    sid_transfer(hiAddress, hiFrequency);
+void sid_set_voice_frequency_register(byte voice, word frequency) {
+  _sid_set_frequency_register_at(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO), frequency);
+}
+
+// the frequency register value for an absolute pitch, in 1/256ths of a
+// semitone above C0 (midi note 0). Integer only: one Q15 multiply and a shift.
+// Clamps to the SID's range.
+word sid_pitch_register_word(long pitch) {
+  signed char octave = 0;
+
+  while (pitch < 0) {
+    pitch += SID_PITCH_OFFSET_OCTAVE;
+    octave--;
+  }
+  while (pitch >= SID_PITCH_OFFSET_OCTAVE) {
+    pitch -= SID_PITCH_OFFSET_OCTAVE;
+    octave++;
   }
 
-  if (loFrequency != lowByte(prev)) {
-    byte loAddress = (voice * 7) + SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO;
-    sid_transfer(loAddress, loFrequency);
+  byte step = pitch >> 6; // quarter semitones
+  byte fine = pitch & 0B00111111;
+  uint16_t lo = pgm_read_word(&sid_octave_fraction_q15[step]);
+  uint16_t hi = pgm_read_word(&sid_octave_fraction_q15[step + 1]);
+  uint32_t ratio_q15 = 32768UL + lo + (((uint32_t)(hi - lo) * fine) >> 6);
+  uint32_t frequency = (SID_C7_REGISTER_WORD * ratio_q15 + 16384) >> 15;
+
+  if (octave > 7) {
+    if (octave >= 7 + 16 || frequency > (0xFFFFUL >> (octave - 7))) {
+      return 0xFFFF;
+    }
+    frequency <<= (octave - 7);
+  } else if (octave < 7) {
+    if (octave < 7 - 16) {
+      return 0;
+    }
+    frequency = (frequency + (1UL << (6 - octave))) >> (7 - octave);
   }
-}
 
-void sid_set_gate(byte voice, bool state) {
-  byte address = (voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL;
-  byte data = sid_state_bytes[address];
+  return frequency > 0xFFFF ? 0xFFFF : frequency;
+}
 
-  if (state) {
-    data |= SID_GATE;
-  } else {
-    data &= ~SID_GATE;
+// the frequency register value for a midi note, shifted by `pitch_offset`
+// 1/256ths of a semitone
+word sid_note_register_word(byte note, long pitch_offset) {
+  if (pitch_offset == 0 && note < 96) {
+    return pgm_read_word(&sid_note_register_words[note]);
   }
 
-  sid_transfer(address, data);
+  return sid_pitch_register_word(((long)note * SID_PITCH_OFFSET_SEMITONE) + pitch_offset);
+}
+
+void sid_set_gate(byte voice, bool state) {
+  _sid_set_bits(sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL), SID_GATE, state);
 }
 
 word get_voice_frequency_register_value(byte voice) {
-  word value = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI];
+  word value = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI)];
   value <<= 8;
-  value += sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO];
+  value += sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO)];
   return value;
 }
 
@@ -394,55 +615,55 @@ float get_voice_frequency(byte voice) {
 }
 
 word get_voice_pulse_width(byte voice) {
-  word pulse_width = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_HI];
+  word pulse_width = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_HI)];
   pulse_width <<= 8;
-  pulse_width += sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_LO];
+  pulse_width += sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_LO)];
   return(pulse_width);
 }
 
 byte get_voice_waveform(byte voice) {
-  byte control_register = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL];
+  byte control_register = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL)];
   return((control_register & 0B11110000) >> 4);
 }
 
 bool get_voice_test_bit(byte voice) {
-  byte control_register = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL];
+  byte control_register = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL)];
   return((control_register & SID_TEST) != 0);
 }
 
 bool get_voice_ring_mod(byte voice) {
-  byte control_register = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL];
+  byte control_register = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL)];
   return((control_register & SID_RING) != 0);
 }
 
 bool get_voice_sync(byte voice) {
-  byte control_register = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL];
+  byte control_register = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL)];
   return((control_register & SID_SYNC) != 0);
 }
 
 bool get_voice_gate(byte voice) {
-  byte control_register = sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL];
+  byte control_register = sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_CONTROL)];
   return((control_register & SID_GATE) != 0);
 }
 
 float get_attack_seconds(byte voice) {
-  byte value = highNibble(sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD]);
+  byte value = highNibble(sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
   return(sid_attack_values_to_seconds[value]);
 }
 
 float get_decay_seconds(byte voice) {
-  byte value = lowNibble(sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD]);
+  byte value = lowNibble(sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
   return(sid_decay_and_release_values_to_seconds[value]);
 }
 
 // returns float [0..1]
 float get_sustain_percent(byte voice) {
-  byte value = highNibble(sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR]);
+  byte value = highNibble(sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR)]);
   return((float) value / 15.0);
 }
 
 float get_release_seconds(byte voice) {
-  byte value = lowNibble(sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR]);
+  byte value = lowNibble(sid_state_bytes[sid_voice_address(voice, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR)]);
   return(sid_decay_and_release_values_to_seconds[value]);
 }
 
@@ -464,10 +685,66 @@ byte get_volume() {
 }
 
 bool get_filter_enabled_for_voice(byte voice) {
-  byte bits = sid_state_bytes[SID_REGISTER_ADDRESS_FILTER_RESONANCE] & 0B00000111;
-  bits >>= voice;
-  bits <<= (8 - (voice + 1));
-  return(bits != 0);
-}
+  byte bits = sid_state_bytes[sid_chip_address(voice / 3, SID_REGISTER_ADDRESS_FILTER_RESONANCE)] & 0B00000111;
+  return((bits & (SID_FILTER_VOICE1 << (voice % 3))) != 0);
+}
+
+#ifdef __cplusplus
+// Compile-time voice accessors: `sid_voice<1>::set_attack(9)` does what
+// `sid_set_attack(1, 9)` does, but the register address, chip and masks are
+// constants, so there's no `voice * 7` (or `/ 3`, `% 3` with several chips) at
+// runtime. Use these where the voice is known at compile time, like the CC
+// switch in SID.ino; anything that picks a voice at runtime (e.g. note
+// allocation) keeps using the functions above.
+template <byte VOICE>
+struct sid_voice {
+  static_assert(VOICE < SID_VOICES, "no such voice");
+
+  static constexpr byte CHIP = VOICE / 3;
+  static constexpr byte FILTER_MASK = SID_FILTER_VOICE1 << (VOICE % 3);
+
+  static constexpr byte address(byte offset) {
+    return (CHIP << SID_ADDRESS_CHIP_SHIFT) | (((VOICE % 3) * 7) + offset);
+  }
+
+  static void set_waveform(byte waveform_mask, bool on) {
+    _sid_set_bits(address(SID_REGISTER_OFFSET_VOICE_CONTROL), waveform_mask & 0B11110000, on);
+  }
+  static void set_ring_mod(bool on) { _sid_set_bits(address(SID_REGISTER_OFFSET_VOICE_CONTROL), SID_RING, on); }
+  static void set_test(bool on) { _sid_set_bits(address(SID_REGISTER_OFFSET_VOICE_CONTROL), SID_TEST, on); }
+  static void set_sync(bool on) { _sid_set_bits(address(SID_REGISTER_OFFSET_VOICE_CONTROL), SID_SYNC, on); }
+  static void set_gate(bool on) { _sid_set_bits(address(SID_REGISTER_OFFSET_VOICE_CONTROL), SID_GATE, on); }
+  static void set_attack(byte attack) { _sid_set_high_nibble(address(SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD), attack); }
+  static void set_decay(byte decay) { _sid_set_low_nibble(address(SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD), decay); }
+  static void set_sustain(byte sustain) { _sid_set_high_nibble(address(SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR), sustain); }
+  static void set_release(byte release) { _sid_set_low_nibble(address(SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR), release); }
+  static void set_pulse_width(word hertz) { _sid_set_pulse_width_at(address(SID_REGISTER_OFFSET_VOICE_PULSE_WIDTH_LO), hertz); }
+  static void set_frequency_register(word frequency) {
+    _sid_set_frequency_register_at(address(SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO), frequency);
+  }
+  static void set_filter(bool on) {
+    _sid_set_bits((CHIP << SID_ADDRESS_CHIP_SHIFT) | SID_REGISTER_ADDRESS_FILTER_RESONANCE, FILTER_MASK, on);
+  }
+
+  static bool gate() { return (sid_state_bytes[address(SID_REGISTER_OFFSET_VOICE_CONTROL)] & SID_GATE) != 0; }
+};
+
+// calls `f(sid_voice<VOICE>())` for VOICE and the same voice on every later
+// chip, e.g. for mono mode, where every chip plays a copy of the same patch
+template <byte VOICE, bool = (VOICE < SID_VOICES)>
+struct sid_voice_on_every_chip {
+  template <typename F>
+  static void apply(F f) {
+    f(sid_voice<VOICE>());
+    sid_voice_on_every_chip<VOICE + 3>::apply(f);
+  }
+};
+
+template <byte VOICE>
+struct sid_voice_on_every_chip<VOICE, false> {
+  template <typename F>
+  static void apply(F) {}
+};
+#endif /* __cplusplus */
 
 #endif /* SRC_SID_H */
@@ -0,0 +1,73 @@
+#ifndef SRC_SID_AVR_BUS_H
+#define SRC_SID_AVR_BUS_H
+
+#include "sid_transport.h"
+#include "util.h"
+
+// The SID bus on the Arduino Micro, as one forced-inline write.
+//
+// Wiring:
+// - PORTB: D0-D7
+// - PORTF: A0-A4 (PORTF has no bits 2 and 3, see below)
+// - PC6 (pin 5): Ø2. Timer 3 toggles it in hardware (`start_clock()` in
+//   SID.ino), so we never drive it; we only read it back through PINC to stay
+//   in phase with it
+// - CS: one line per chip, see `sid_chip_select_ports`
+//
+// The SID latches a write on the falling edge of Ø2 while CS is low. Ø2 runs at
+// 1MHz, which is 8 CPU cycles per phase, so rather than toggling the clock we:
+// wait for a falling edge, put address, data and CS on the pins during the low
+// phase that follows, hold them through the high phase, and release CS after the
+// next falling edge.
+//
+// Cycle budget (16MHz): finding the first falling edge waits at most 16 cycles,
+// the write itself is one Ø2 period (16 cycles), plus a handful of `out`s.
+// Roughly 40 cycles worst case, with no calls and no SREG juggling.
+//
+// Callers must have interrupts disabled (every path in sid.h does), and Timer 3
+// must be running, or this waits forever.
+
+// the port register and bit behind each of SID.ino's ARDUINO_SID_CHIP_SELECT_PINS
+volatile uint8_t * const sid_chip_select_ports[] = { &PORTC, &PORTD, &PORTD };
+const byte sid_chip_select_masks[] = { 0B10000000, 0B00010000, 0B10000000 };
+
+const byte SID_AVR_CLOCK_MASK = 0B01000000; // PC6 / OC3A
+
+__attribute__((always_inline)) static inline void sid_avr_bus_write(byte address, byte data) {
+#if SID_NUM_CHIPS == 1
+  const byte chip = 0; // lets the compiler turn CS into plain `out`s on PORTC
+#else
+  byte chip = sid_address_chip(address);
+#endif
+  volatile uint8_t *cs_port = sid_chip_select_ports[chip];
+  byte reg = sid_address_register(address);
+
+  // PORTF is a weird 6-bit register (8 bits, but bits 2 and 3 don't exist)
+  //
+  // Port F Data Register — PORTF
+  // bit  7    6    5    4    3    2    1    0
+  //      F7   F6   F5   F4   -    -    F1   F0
+  //
+  // addr -    A4   A3   A2   -    -    A1   A0
+  byte data_for_port_f = ((reg << 2) & 0B01110000) | (reg & 0B00000011);
+
+  // precompute both CS states so the timed part is stores only
+  byte cs_high = *cs_port | sid_chip_select_masks[chip];
+  byte cs_low = cs_high & ~sid_chip_select_masks[chip];
+
+  // sync to a falling edge: the whole low phase is ours
+  while (!(PINC & SID_AVR_CLOCK_MASK)) {}
+  while (PINC & SID_AVR_CLOCK_MASK) {}
+
+  PORTF = data_for_port_f;
+  PORTB = data;
+  *cs_port = cs_low;
+
+  // through the high phase; the SID latches on the falling edge that ends it
+  while (!(PINC & SID_AVR_CLOCK_MASK)) {}
+  while (PINC & SID_AVR_CLOCK_MASK) {}
+
+  *cs_port = cs_high;
+}
+
+#endif /* SRC_SID_AVR_BUS_H */
@@ -0,0 +1,101 @@
+#ifndef SRC_SID_QUEUE_H
+#define SRC_SID_QUEUE_H
+
+#include <stdbool.h>
+#include "util.h"
+
+// A single-producer/single-consumer ring buffer of pending SID register writes.
+//
+// The main loop is the only producer (it moves `head`), the bus-drain ISR is the
+// only consumer (it moves `tail`). Both indices are single bytes, so reading or
+// writing one is atomic on the AVR and neither side ever has to disable
+// interrupts to touch the queue.
+//
+// One slot is always left empty so that `head == tail` unambiguously means
+// "empty". The size must be a power of two so wrapping is a mask.
+
+#ifndef SID_QUEUE_SIZE
+#define SID_QUEUE_SIZE 32
+#endif
+
+#if (SID_QUEUE_SIZE & (SID_QUEUE_SIZE - 1)) != 0 || SID_QUEUE_SIZE > 128
+#error "SID_QUEUE_SIZE must be a power of two no larger than 128"
+#endif
+
+const byte SID_QUEUE_MASK = SID_QUEUE_SIZE - 1;
+
+struct sid_write {
+  byte address;
+  byte data;
+};
+typedef struct sid_write sid_write;
+
+struct sid_queue {
+  sid_write writes[SID_QUEUE_SIZE];
+  volatile byte head; // next slot the producer fills
+  volatile byte tail; // next slot the consumer drains
+  byte max_depth;     // high-water mark, for tuning SID_QUEUE_SIZE
+  unsigned int overflows; // pushes that found the queue full
+};
+typedef struct sid_queue sid_queue;
+
+void sid_queue_empty(sid_queue *q);
+byte sid_queue_depth(const sid_queue *q);
+bool sid_queue_push(sid_queue *q, byte address, byte data);
+bool sid_queue_pop(sid_queue *q, sid_write *out);
+
+// O(1)
+void sid_queue_empty(sid_queue *q) {
+  q->head = 0;
+  q->tail = 0;
+  q->max_depth = 0;
+  q->overflows = 0;
+}
+
+// O(1)
+byte sid_queue_depth(const sid_queue *q) {
+  return (byte)(q->head - q->tail) & SID_QUEUE_MASK;
+}
+
+// Producer side. Returns false (and counts an overflow) if the queue is full;
+// it's up to the caller to make room.
+//
+// O(1)
+bool sid_queue_push(sid_queue *q, byte address, byte data) {
+  byte head = q->head;
+  byte next = (head + 1) & SID_QUEUE_MASK;
+
+  if (next == q->tail) {
+    q->overflows++;
+    return false;
+  }
+
+  q->writes[head].address = address;
+  q->writes[head].data = data;
+  q->head = next; // publish only after the slot is filled
+
+  byte depth = sid_queue_depth(q);
+  if (depth > q->max_depth) {
+    q->max_depth = depth;
+  }
+
+  return true;
+}
+
+// Consumer side. Returns false if there was nothing to pop.
+//
+// O(1)
+bool sid_queue_pop(sid_queue *q, sid_write *out) {
+  byte tail = q->tail;
+
+  if (tail == q->head) {
+    return false;
+  }
+
+  *out = q->writes[tail];
+  q->tail = (tail + 1) & SID_QUEUE_MASK; // release the slot only after reading it
+
+  return true;
+}
+
+#endif /* SRC_SID_QUEUE_H */
@@ -0,0 +1,106 @@
+#ifndef SRC_SID_TELEMETRY_H
+#define SRC_SID_TELEMETRY_H
+
+#include "util.h"
+
+// Bus-write telemetry, for finding out what's saturating the bus (e.g. which
+// automation lanes). Only compiled in with SID_TELEMETRY
+// (`make build SID_TELEMETRY=1`); otherwise every hook below is empty and
+// `sid.h` costs exactly what it did before.
+//
+// Counts:
+// - `register_writes`: bytes that reached the bus, by bus address
+// - `suppressed`: writes we skipped because the chip already had that value
+// - `coalesced`: writes absorbed by a pending write in a transaction
+// - `bus_ticks`: time spent putting bytes on the bus
+// - `longest_critical_ticks`: longest window we kept interrupts off
+//
+// Times are in ticks of `sid_telemetry_clock()`, which SID.ino implements (a
+// free-running 16-bit timer). Windows longer than 65535 ticks wrap.
+//
+// Needs SID_STATE_SIZE, so it's included from the middle of `sid.h`.
+
+#ifdef SID_TELEMETRY
+// will be defined in SID.ino
+extern uint16_t sid_telemetry_clock();
+
+struct sid_telemetry {
+  uint32_t register_writes[SID_STATE_SIZE];
+  uint32_t suppressed;
+  uint32_t coalesced;
+  uint32_t bus_ticks;
+  uint16_t longest_critical_ticks;
+  uint16_t critical_started;
+};
+typedef struct sid_telemetry sid_telemetry;
+
+sid_telemetry sid_stats;
+#endif /* SID_TELEMETRY */
+
+void sid_telemetry_reset();
+uint32_t sid_telemetry_total_writes();
+
+void sid_telemetry_reset() {
+#ifdef SID_TELEMETRY
+  memset(&sid_stats, 0, sizeof(sid_stats));
+#endif
+}
+
+uint32_t sid_telemetry_total_writes() {
+  uint32_t total = 0;
+#ifdef SID_TELEMETRY
+  for (byte address = 0; address < SID_STATE_SIZE; address++) {
+    total += sid_stats.register_writes[address];
+  }
+#endif
+  return total;
+}
+
+// hooks for `sid.h` (and the bus-drain ISR in SID.ino)
+
+static inline void _sid_telemetry_suppressed() {
+#ifdef SID_TELEMETRY
+  sid_stats.suppressed++;
+#endif
+}
+
+static inline void _sid_telemetry_coalesced() {
+#ifdef SID_TELEMETRY
+  sid_stats.coalesced++;
+#endif
+}
+
+// returns a timestamp for `_sid_telemetry_bus_write_end`
+static inline uint16_t _sid_telemetry_bus_write_begin() {
+#ifdef SID_TELEMETRY
+  return sid_telemetry_clock();
+#else
+  return 0;
+#endif
+}
+
+static inline void _sid_telemetry_bus_write_end(__attribute__ ((unused)) byte address, __attribute__ ((unused)) uint16_t started) {
+#ifdef SID_TELEMETRY
+  sid_stats.register_writes[address]++;
+  sid_stats.bus_ticks += (uint16_t)(sid_telemetry_clock() - started);
+#endif
+}
+
+// call right after disabling interrupts...
+static inline void sid_telemetry_critical_begin() {
+#ifdef SID_TELEMETRY
+  sid_stats.critical_started = sid_telemetry_clock();
+#endif
+}
+
+// ...and right before enabling them again. Also used by the bus-drain ISR.
+static inline void sid_telemetry_critical_end() {
+#ifdef SID_TELEMETRY
+  uint16_t elapsed = sid_telemetry_clock() - sid_stats.critical_started;
+  if (elapsed > sid_stats.longest_critical_ticks) {
+    sid_stats.longest_critical_ticks = elapsed;
+  }
+#endif
+}
+
+#endif /* SRC_SID_TELEMETRY_H */
@@ -0,0 +1,168 @@
+#ifndef SRC_SID_TRANSPORT_H
+#define SRC_SID_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "util.h"
+
+// How register writes physically leave `sid.h`.
+//
+// `sid.h` only ever calls `sid_bus->write(...)`. What's behind it depends on the
+// build:
+// - on the Arduino, SID.ino installs a backend that drives PORTB/PORTF/PORTC
+// - `sid_null_transport` drops everything (the default, so host code that
+//   doesn't care about the bus just works)
+// - `sid_recorder` appends every write, with a timestamp, to a binary file so a
+//   session can be profiled or replayed offline
+
+// A bus address carries the chip in its top bits, so backends and recordings
+// can tell several SIDs on the same bus apart:
+//
+// bit  7    6    5    4    3    2    1    0
+//      -    chip      register (0-24)
+const byte SID_ADDRESS_CHIP_SHIFT = 5;
+const byte SID_ADDRESS_REGISTER_MASK = 0B00011111;
+
+byte sid_chip_address(byte chip, byte reg);
+byte sid_address_chip(byte address);
+byte sid_address_register(byte address);
+
+byte sid_chip_address(byte chip, byte reg) {
+  return (chip << SID_ADDRESS_CHIP_SHIFT) | reg;
+}
+
+byte sid_address_chip(byte address) {
+  return address >> SID_ADDRESS_CHIP_SHIFT;
+}
+
+byte sid_address_register(byte address) {
+  return address & SID_ADDRESS_REGISTER_MASK;
+}
+
+typedef void (sid_transport_write_function_t)(void *context, byte address, byte data);
+
+struct sid_transport {
+  sid_transport_write_function_t *write;
+  void *context;
+};
+typedef struct sid_transport sid_transport;
+
+// BEGIN null backend
+static void _sid_null_write(__attribute__ ((unused)) void *context, __attribute__ ((unused)) byte address, __attribute__ ((unused)) byte data) {}
+
+sid_transport sid_null_transport = { .write=_sid_null_write, .context=NULL };
+// END null backend
+
+// BEGIN recording backend
+//
+// File layout (all integers little-endian):
+//
+//   "SIDR" <version: 1 byte>
+//   then one 6-byte record per write: <time: uint32> <address: byte> <data: byte>
+//
+// `address` is a bus address as described above, so a multi-chip session is
+// one interleaved stream; split it with `sid_address_chip`.
+//
+// `time` is virtual: microseconds (= SID clock cycles), advanced by the host via
+// `sid_recorder_advance`. Every write also takes one Ø2 cycle, so back-to-back
+// writes never share a timestamp.
+
+const char SID_RECORDING_MAGIC[4] = { 'S', 'I', 'D', 'R' };
+const byte SID_RECORDING_VERSION = 1;
+const unsigned int SID_RECORDING_HEADER_SIZE = 5;
+const unsigned int SID_RECORDING_ENTRY_SIZE = 6;
+
+struct sid_recording_entry {
+  uint32_t time;
+  byte address;
+  byte data;
+};
+typedef struct sid_recording_entry sid_recording_entry;
+
+struct sid_recorder {
+  FILE *stream;
+  uint32_t time;
+  unsigned long writes;
+};
+typedef struct sid_recorder sid_recorder;
+
+sid_transport sid_recorder_transport(sid_recorder *rec, FILE *stream);
+void sid_recorder_advance(sid_recorder *rec, uint32_t micros);
+bool sid_recording_read_header(FILE *stream);
+bool sid_recording_read(FILE *stream, sid_recording_entry *entry);
+unsigned long sid_recording_replay(FILE *stream, sid_transport *transport);
+static void _sid_recorder_write(void *context, byte address, byte data);
+
+// starts a recording on `stream` (which must be open for binary writing) and
+// returns a transport that feeds it
+sid_transport sid_recorder_transport(sid_recorder *rec, FILE *stream) {
+  rec->stream = stream;
+  rec->time = 0;
+  rec->writes = 0;
+
+  fwrite(SID_RECORDING_MAGIC, 1, sizeof(SID_RECORDING_MAGIC), stream);
+  fputc(SID_RECORDING_VERSION, stream);
+
+  return (sid_transport){ .write=_sid_recorder_write, .context=rec };
+}
+
+void sid_recorder_advance(sid_recorder *rec, uint32_t micros) {
+  rec->time += micros;
+}
+
+static void _sid_recorder_write(void *context, byte address, byte data) {
+  sid_recorder *rec = (sid_recorder *)context;
+  uint32_t t = rec->time;
+  byte entry[6] = {
+    (byte)t, (byte)(t >> 8), (byte)(t >> 16), (byte)(t >> 24),
+    address,
+    data
+  };
+
+  fwrite(entry, 1, sizeof(entry), rec->stream);
+  rec->time++;
+  rec->writes++;
+}
+
+// returns false if `stream` isn't a recording we know how to read
+bool sid_recording_read_header(FILE *stream) {
+  char header[5];
+
+  if (fread(header, 1, sizeof(header), stream) != sizeof(header)) {
+    return false;
+  }
+
+  return memcmp(header, SID_RECORDING_MAGIC, sizeof(SID_RECORDING_MAGIC)) == 0 &&
+    (byte)header[4] == SID_RECORDING_VERSION;
+}
+
+// returns false at the end of the recording
+bool sid_recording_read(FILE *stream, sid_recording_entry *entry) {
+  byte raw[6];
+
+  if (fread(raw, 1, sizeof(raw), stream) != sizeof(raw)) {
+    return false;
+  }
+
+  entry->time = (uint32_t)raw[0] | ((uint32_t)raw[1] << 8) | ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24);
+  entry->address = raw[4];
+  entry->data = raw[5];
+  return true;
+}
+
+// plays a recording (positioned after its header) into another transport.
+// Returns the number of writes replayed.
+unsigned long sid_recording_replay(FILE *stream, sid_transport *transport) {
+  sid_recording_entry entry;
+  unsigned long count = 0;
+
+  while (sid_recording_read(stream, &entry)) {
+    transport->write(transport->context, entry.address, entry.data);
+    count++;
+  }
+
+  return count;
+}
+// END recording backend
+
+#endif /* SRC_SID_TRANSPORT_H */
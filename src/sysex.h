@@ -0,0 +1,228 @@
+#ifndef SRC_SYSEX_H
+#define SRC_SYSEX_H
+
+#include <stdbool.h>
+#include "util.h"
+
+// Our SysEx messages: loading a whole patch at once, dumping the current one,
+// and acknowledging a load.
+//
+//   F0 7D <command> <data...> <checksum> F7
+//
+// - 7D is the "non-commercial" manufacturer ID
+// - data is 8-bit bytes packed into 7-bit ones: each group of up to 7 bytes is
+//   sent as a byte holding their top bits (bit i for byte i), then the bytes
+//   with their top bits cleared
+// - the checksum makes the packed data bytes plus it add up to 0, mod 128
+//
+// Commands:
+// - SYSEX_PATCH_LOAD, with a packed patch: apply it. Answered with an ack
+// - SYSEX_PATCH_DUMP_REQUEST, no data: answered with SYSEX_PATCH_DUMP and the
+//   current patch
+// - SYSEX_ACK, with the command it's for, a SYSEX_STATUS_*, and the checksum
+//   of the message it's acknowledging (both unpacked)
+//
+// A patch is SYSEX_PATCH_SIZE bytes (see `sysex_patch`), so SYSEX_PATCH_PACKED_SIZE
+// packed, and a whole patch message is SYSEX_PATCH_MESSAGE_SIZE with F0 and F7.
+
+#define SYSEX_MANUFACTURER_ID 0x7D
+
+#define SYSEX_PATCH_LOAD 0x01
+#define SYSEX_PATCH_DUMP_REQUEST 0x02
+#define SYSEX_PATCH_DUMP 0x03
+#define SYSEX_ACK 0x7F
+
+#define SYSEX_STATUS_OK 0
+#define SYSEX_STATUS_BAD_CHECKSUM 1
+#define SYSEX_STATUS_BAD_LENGTH 2
+#define SYSEX_STATUS_UNKNOWN_COMMAND 3
+#define SYSEX_STATUS_NOT_OURS 4 // another manufacturer's: not acknowledged
+
+#define SYSEX_PATCH_REGISTERS 25
+
+#define SYSEX_PATCH_PARAPHONIC 0B00000001 // `sysex_patch.modes` bits
+#define SYSEX_PATCH_VOLUME_MODULATION 0B00000010
+#define SYSEX_PATCH_PULSE_WIDTH_MODULATION 0B00000100
+
+struct sysex_patch {
+  byte registers[SYSEX_PATCH_REGISTERS]; // one chip's worth
+  byte modes; // SYSEX_PATCH_* bits
+  byte note_priority;
+  byte voice_stealing;
+  uint16_t glide_time_millis;
+  byte pitch_bend_semitones;
+  byte detune_semitones;
+  uint16_t detunes[3]; // 14-bit, per voice of a chip; 8192 is none
+};
+typedef struct sysex_patch sysex_patch;
+
+#define SYSEX_PATCH_SIZE (SYSEX_PATCH_REGISTERS + 13)
+#define SYSEX_PACKED_SIZE(size) ((size) + ((size) + 6) / 7)
+#define SYSEX_PATCH_PACKED_SIZE SYSEX_PACKED_SIZE(SYSEX_PATCH_SIZE)
+#define SYSEX_PATCH_MESSAGE_SIZE (SYSEX_PATCH_PACKED_SIZE + 5)
+#define SYSEX_ACK_MESSAGE_SIZE 7
+
+byte sysex_pack(const byte *in, byte length, byte *out);
+byte sysex_unpack(const byte *in, byte length, byte *out);
+byte sysex_checksum(const byte *data, byte length);
+byte sysex_patch_message(const sysex_patch *patch, byte *out);
+byte sysex_parse(const byte *message, byte length, byte *command, byte *checksum, sysex_patch *patch);
+byte sysex_ack_message(byte command, byte status, byte checksum, byte *out);
+// "private" below
+static void _sysex_patch_serialize(const sysex_patch *patch, byte *out);
+static void _sysex_patch_deserialize(const byte *in, sysex_patch *patch);
+
+// 8-bit `in` to 7-bit `out`, SYSEX_PACKED_SIZE(length) bytes
+//
+// O(length)
+byte sysex_pack(const byte *in, byte length, byte *out) {
+  byte written = 0;
+
+  for (byte group = 0; group < length; group += 7) {
+    byte top_bits = written++;
+    out[top_bits] = 0;
+    for (byte i = 0; i < 7 && group + i < length; i++) {
+      out[top_bits] |= (in[group + i] >> 7) << i;
+      out[written++] = in[group + i] & 0x7F;
+    }
+  }
+
+  return written;
+}
+
+// undoes `sysex_pack()`; returns how many bytes went to `out`
+//
+// O(length)
+byte sysex_unpack(const byte *in, byte length, byte *out) {
+  byte unpacked = 0;
+
+  for (byte group = 0; group < length; group += 8) {
+    byte top_bits = in[group];
+    for (byte i = 0; i < 7 && group + 1 + i < length; i++) {
+      out[unpacked++] = (in[group + 1 + i] & 0x7F) | (((top_bits >> i) & 1) << 7);
+    }
+  }
+
+  return unpacked;
+}
+
+// what to send after `data` so the lot sums to 0, mod 128
+//
+// O(length)
+byte sysex_checksum(const byte *data, byte length) {
+  byte sum = 0;
+  for (byte i = 0; i < length; i++) {
+    sum += data[i];
+  }
+  return (128 - (sum & 0x7F)) & 0x7F;
+}
+
+// a whole SYSEX_PATCH_DUMP message, F0 to F7, in `out`
+// (SYSEX_PATCH_MESSAGE_SIZE bytes). Change the command byte (`out[2]`) and
+// the checksum doesn't change, since it only covers the data.
+//
+// O(1)
+byte sysex_patch_message(const sysex_patch *patch, byte *out) {
+  byte serialized[SYSEX_PATCH_SIZE];
+  _sysex_patch_serialize(patch, serialized);
+
+  out[0] = 0xF0;
+  out[1] = SYSEX_MANUFACTURER_ID;
+  out[2] = SYSEX_PATCH_DUMP;
+  byte packed = sysex_pack(serialized, SYSEX_PATCH_SIZE, &out[3]);
+  out[3 + packed] = sysex_checksum(&out[3], packed);
+  out[4 + packed] = 0xF7;
+
+  return SYSEX_PATCH_MESSAGE_SIZE;
+}
+
+// Reads a message as the MIDI parser collects it: everything between F0 and
+// F7. Sets `command`, and `checksum` to what the message's checksum should
+// have been. Returns a SYSEX_STATUS_*; if it's SYSEX_STATUS_OK and the command
+// carries a patch, it's in `patch`.
+//
+// O(length)
+byte sysex_parse(const byte *message, byte length, byte *command, byte *checksum, sysex_patch *patch) {
+  *command = 0;
+  *checksum = 0;
+
+  if (length < 2 || message[0] != SYSEX_MANUFACTURER_ID) {
+    return SYSEX_STATUS_NOT_OURS;
+  }
+  *command = message[1];
+
+  switch (*command) {
+  case SYSEX_PATCH_DUMP_REQUEST:
+    return length == 2 ? SYSEX_STATUS_OK : SYSEX_STATUS_BAD_LENGTH;
+
+  case SYSEX_PATCH_LOAD:
+  case SYSEX_PATCH_DUMP: {
+    if (length != SYSEX_PATCH_PACKED_SIZE + 3) {
+      return SYSEX_STATUS_BAD_LENGTH;
+    }
+    *checksum = sysex_checksum(&message[2], SYSEX_PATCH_PACKED_SIZE);
+    if (*checksum != message[length - 1]) {
+      return SYSEX_STATUS_BAD_CHECKSUM;
+    }
+    byte serialized[SYSEX_PATCH_SIZE];
+    sysex_unpack(&message[2], SYSEX_PATCH_PACKED_SIZE, serialized);
+    _sysex_patch_deserialize(serialized, patch);
+    return SYSEX_STATUS_OK;
+  }
+
+  default:
+    return SYSEX_STATUS_UNKNOWN_COMMAND;
+  }
+}
+
+// a SYSEX_ACK message, F0 to F7, in `out` (SYSEX_ACK_MESSAGE_SIZE bytes)
+//
+// O(1)
+byte sysex_ack_message(byte command, byte status, byte checksum, byte *out) {
+  out[0] = 0xF0;
+  out[1] = SYSEX_MANUFACTURER_ID;
+  out[2] = SYSEX_ACK;
+  out[3] = command & 0x7F;
+  out[4] = status;
+  out[5] = checksum & 0x7F;
+  out[6] = 0xF7;
+  return SYSEX_ACK_MESSAGE_SIZE;
+}
+
+// private below
+
+// field by field, 16-bit values low byte first, so the layout doesn't depend
+// on the compiler
+static void _sysex_patch_serialize(const sysex_patch *patch, byte *out) {
+  memcpy(out, patch->registers, SYSEX_PATCH_REGISTERS);
+  out += SYSEX_PATCH_REGISTERS;
+  *out++ = patch->modes;
+  *out++ = patch->note_priority;
+  *out++ = patch->voice_stealing;
+  *out++ = lowByte(patch->glide_time_millis);
+  *out++ = highByte(patch->glide_time_millis);
+  *out++ = patch->pitch_bend_semitones;
+  *out++ = patch->detune_semitones;
+  for (byte i = 0; i < 3; i++) {
+    *out++ = lowByte(patch->detunes[i]);
+    *out++ = highByte(patch->detunes[i]);
+  }
+}
+
+static void _sysex_patch_deserialize(const byte *in, sysex_patch *patch) {
+  memcpy(patch->registers, in, SYSEX_PATCH_REGISTERS);
+  in += SYSEX_PATCH_REGISTERS;
+  patch->modes = *in++;
+  patch->note_priority = *in++;
+  patch->voice_stealing = *in++;
+  patch->glide_time_millis = in[0] | ((uint16_t)in[1] << 8);
+  in += 2;
+  patch->pitch_bend_semitones = *in++;
+  patch->detune_semitones = *in++;
+  for (byte i = 0; i < 3; i++) {
+    patch->detunes[i] = in[0] | ((uint16_t)in[1] << 8);
+    in += 2;
+  }
+}
+
+#endif /* SRC_SYSEX_H */
@@ -0,0 +1,171 @@
+#ifndef SRC_USB_MIDI_PACKET_H
+#define SRC_USB_MIDI_PACKET_H
+
+#include <stdbool.h>
+#include "midi_parser.h"
+#include "util.h"
+
+// USB-MIDI event packets, straight into `midi_event`s.
+//
+// USB doesn't send a byte stream: every packet is 4 bytes, a header (cable
+// number in the high nibble, Code Index Number in the low one) and 1-3 MIDI
+// bytes, with the CIN saying what they are. So a channel message is always
+// whole, and always has its status byte (there's no running status over USB),
+// and there's nothing to re-frame: the packet is the event.
+//
+// SysEx comes 3 bytes a packet (CIN 4), and the last packet (CIN 5-7) says how
+// many of its bytes are left, F7 included. Those go straight into the
+// parser's SysEx buffer, and the parser hands the message over the same way
+// it would from a byte stream (see midi_parser.h). The parser isn't used for
+// anything else, so one parser per port still.
+
+#define USB_MIDI_CIN_SYSTEM_COMMON_2 0x2 // F1, F3
+#define USB_MIDI_CIN_SYSTEM_COMMON_3 0x3 // F2
+#define USB_MIDI_CIN_SYSEX 0x4 // starts or continues
+#define USB_MIDI_CIN_SYSEX_END_1 0x5 // ... or a 1-byte system common message (F6)
+#define USB_MIDI_CIN_SYSEX_END_2 0x6
+#define USB_MIDI_CIN_SYSEX_END_3 0x7
+#define USB_MIDI_CIN_NOTE_OFF 0x8 // 0x8-0xE: channel messages, CIN = opcode
+#define USB_MIDI_CIN_SINGLE_BYTE 0xF // real-time, mostly
+
+struct usb_midi_packet {
+  byte header; // cable << 4 | CIN
+  byte bytes[3]; // unused ones are 0
+};
+typedef struct usb_midi_packet usb_midi_packet;
+
+byte usb_midi_packet_cable(const usb_midi_packet *packet);
+byte usb_midi_packet_length(const usb_midi_packet *packet);
+bool usb_midi_packet_read(midi_parser *p, const usb_midi_packet *packet, midi_event *event);
+byte usb_midi_sysex_packet(const byte *message, byte length, byte offset, usb_midi_packet *packet);
+// "private" below
+static bool _usb_midi_packet_sysex(midi_parser *p, const usb_midi_packet *packet, midi_event *event);
+
+// O(1)
+byte usb_midi_packet_cable(const usb_midi_packet *packet) {
+  return packet->header >> 4;
+}
+
+// MIDI bytes in the packet, 0 for the CINs that are reserved
+//
+// O(1)
+byte usb_midi_packet_length(const usb_midi_packet *packet) {
+  switch (packet->header & 0x0F) {
+  case USB_MIDI_CIN_SYSTEM_COMMON_2:
+  case USB_MIDI_CIN_SYSEX_END_2:
+  case 0xC: // program change
+  case 0xD: // channel pressure
+    return 2;
+  case USB_MIDI_CIN_SYSEX_END_1:
+  case USB_MIDI_CIN_SINGLE_BYTE:
+    return 1;
+  case 0x0: // reserved: misc
+  case 0x1: // reserved: cable events
+    return 0;
+  default:
+    return 3;
+  }
+}
+
+// Reads one packet. Returns true, and fills in `event`, if it's a whole message
+// or the end of a SysEx message we kept; `event` isn't touched otherwise.
+//
+// O(1)
+bool usb_midi_packet_read(midi_parser *p, const usb_midi_packet *packet, midi_event *event) {
+  byte cin = packet->header & 0x0F;
+
+  switch (cin) {
+  case 0x0:
+  case 0x1:
+    return false;
+
+  case USB_MIDI_CIN_SINGLE_BYTE:
+    return midi_parser_feed(p, packet->bytes[0], event);
+
+  case USB_MIDI_CIN_SYSEX:
+  case USB_MIDI_CIN_SYSEX_END_2:
+  case USB_MIDI_CIN_SYSEX_END_3:
+    return _usb_midi_packet_sysex(p, packet, event);
+
+  case USB_MIDI_CIN_SYSEX_END_1:
+    if (packet->bytes[0] == 0xF7) {
+      return _usb_midi_packet_sysex(p, packet, event);
+    }
+    break; // a 1-byte system common message
+  }
+
+  // a whole message
+  byte length = usb_midi_packet_length(packet);
+  p->in_sysex = false;
+  p->status = 0;
+  event->status = packet->bytes[0];
+  event->data_one = length > 1 ? packet->bytes[1] : 0;
+  event->data_two = length > 2 ? packet->bytes[2] : 0;
+  return true;
+}
+
+// The packet for `message[offset]` onwards, when sending a whole SysEx message
+// (F0 to F7) over USB on cable 0. Returns how many bytes it took; call again
+// with `offset` moved on by that, until it's reached `length`.
+//
+// O(1)
+byte usb_midi_sysex_packet(const byte *message, byte length, byte offset, usb_midi_packet *packet) {
+  byte remaining = length - offset;
+  byte count = remaining > 3 ? 3 : remaining;
+
+  packet->header = remaining > 3 ? USB_MIDI_CIN_SYSEX : USB_MIDI_CIN_SYSEX_END_1 + count - 1;
+  for (byte i = 0; i < 3; i++) {
+    packet->bytes[i] = i < count ? message[offset + i] : 0;
+  }
+
+  return count;
+}
+
+// private below
+
+// Copies the packet's data bytes into the parser's SysEx buffer in one go: an
+// F0 can only be the first byte, and an F7 the last.
+static bool _usb_midi_packet_sysex(midi_parser *p, const usb_midi_packet *packet, midi_event *event) {
+  const byte *data = packet->bytes;
+  byte length = usb_midi_packet_length(packet);
+  bool ends = (packet->header & 0x0F) != USB_MIDI_CIN_SYSEX;
+
+  if (data[0] == 0xF0) {
+    p->in_sysex = true;
+    p->status = 0;
+    p->sysex_length = 0;
+    data++;
+    length--;
+  }
+  if (ends) {
+    length--; // the F7
+  }
+
+  if (!p->in_sysex) {
+    return false; // the rest of a message we came in halfway through
+  }
+
+  if (p->sysex && p->sysex_length != 0xFF && p->sysex_length + length <= p->sysex_size) {
+    memcpy(&p->sysex[p->sysex_length], data, length);
+    p->sysex_length += length;
+  } else {
+    p->sysex_length = 0xFF; // too long: the whole message is dropped
+  }
+
+  if (!ends) {
+    return false;
+  }
+
+  p->in_sysex = false;
+  if (!p->sysex || p->sysex_length == 0xFF) {
+    p->sysex_length = 0;
+    return false;
+  }
+  p->sysex_pending = true;
+  event->status = 0xF0;
+  event->data_one = p->sysex_length;
+  event->data_two = 0;
+  return true;
+}
+
+#endif /* SRC_USB_MIDI_PACKET_H */
@@ -16,6 +16,15 @@ typedef unsigned int word;
 #define lowByte(w) ((uint8_t) ((w) & 0xff))
 #define highByte(w) ((uint8_t) ((w) >> 8))
 
+// lookup tables go in flash on the AVR (see <avr/pgmspace.h>). Anywhere else
+// they're just arrays.
+#ifndef PROGMEM
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+#endif /* PROGMEM */
+
 // returns the last four bits of a byte
 //    e.g. lowNibble(0B10001111) == 0B00001111
 byte lowNibble(byte b) { return(b & 0B00001111); }
@@ -60,6 +69,9 @@ void float_as_padded_string(char *str, float f, signed char mantissa_chars, sign
 
 // y(t) = A * sin(2πft + φ)
 //
+// Too slow for the firmware's modulation modes, which use src/dds.h; this is
+// what that's tested against.
+//
 // returns a float between `-amplitude` and `amplitude`
 float sine_waveform(float frequency, float seconds, float amplitude, float phase) {
   float value = amplitude * sin((2 * 3.141592 * frequency * seconds) + phase);
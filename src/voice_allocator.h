@@ -0,0 +1,223 @@
+#ifndef SRC_VOICE_ALLOCATOR_H
+#define SRC_VOICE_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "util.h"
+
+// Picks the voice a new note goes to in paraphonic mode.
+//
+// Each voice has a few bytes of state (phase, note, envelope level, and when it
+// was last assigned), so picking one is a walk over the voices, not the held
+// notes: at most 12 steps, however many notes are down. A free voice always
+// wins. When there isn't one, the policy decides which voice to steal:
+// - VOICE_ALLOCATOR_OLDEST: the voice that's been playing its note longest
+// - VOICE_ALLOCATOR_QUIETEST: the lowest envelope level, released or not
+// - VOICE_ALLOCATOR_RELEASED_FIRST: the quietest voice in its release phase;
+//   the oldest one if none are
+// - VOICE_ALLOCATOR_ROUND_ROBIN: the first free voice counting on from the
+//   last one assigned, or if none are free, the one after it, so releases
+//   ring out as long as possible
+// - VOICE_ALLOCATOR_SAME_NOTE: a voice already sounding this note (it's
+//   retriggered rather than doubled), or else RELEASED_FIRST
+//
+// Levels are whatever the caller last passed to `voice_allocator_set_level()`,
+// e.g. `envelope_level()` for each voice, right before picking.
+
+#define VOICE_ALLOCATOR_MAX_VOICES 12
+
+#define VOICE_ALLOCATOR_OLDEST 0
+#define VOICE_ALLOCATOR_QUIETEST 1
+#define VOICE_ALLOCATOR_RELEASED_FIRST 2
+#define VOICE_ALLOCATOR_ROUND_ROBIN 3
+#define VOICE_ALLOCATOR_SAME_NOTE 4
+
+#define VOICE_FREE 0
+#define VOICE_HELD 1
+#define VOICE_RELEASED 2
+
+struct voice_state {
+  byte phase; // VOICE_FREE, VOICE_HELD or VOICE_RELEASED
+  byte note;
+  byte level; // [0..255]
+  byte assigned; // the allocator's `assignments` when it got its note (see `voice_allocator_assign`)
+};
+typedef struct voice_state voice_state;
+
+struct voice_allocator {
+  voice_state voices[VOICE_ALLOCATOR_MAX_VOICES];
+  byte count;
+  byte next; // for VOICE_ALLOCATOR_ROUND_ROBIN
+  byte assignments; // counts up, wrapping; ages are differences from it
+};
+typedef struct voice_allocator voice_allocator;
+
+void voice_allocator_initialize(voice_allocator *a, byte count);
+byte voice_allocator_pick(voice_allocator *a, byte note, byte policy);
+void voice_allocator_assign(voice_allocator *a, byte voice, byte note);
+void voice_allocator_release(voice_allocator *a, byte voice);
+void voice_allocator_free(voice_allocator *a, byte voice);
+void voice_allocator_set_level(voice_allocator *a, byte voice, byte level);
+void voice_allocator_inspect(const voice_allocator *a, FILE *stream);
+// "private" below
+static byte _voice_allocator_age(const voice_allocator *a, byte voice);
+static byte _voice_allocator_first_free(const voice_allocator *a, byte from);
+static byte _voice_allocator_oldest(const voice_allocator *a);
+static byte _voice_allocator_quietest(const voice_allocator *a, bool released_only);
+
+// all voices free
+//
+// O(voices)
+void voice_allocator_initialize(voice_allocator *a, byte count) {
+  a->count = count < VOICE_ALLOCATOR_MAX_VOICES ? count : VOICE_ALLOCATOR_MAX_VOICES;
+  a->next = 0;
+  a->assignments = 0;
+  for (byte i = 0; i < VOICE_ALLOCATOR_MAX_VOICES; i++) {
+    a->voices[i].phase = VOICE_FREE;
+    a->voices[i].note = 0;
+    a->voices[i].level = 0;
+    a->voices[i].assigned = 0;
+  }
+}
+
+// the voice `note` should be played on. Doesn't change anything; call
+// `voice_allocator_assign()` once it's actually playing.
+//
+// O(voices)
+byte voice_allocator_pick(voice_allocator *a, byte note, byte policy) {
+  if (policy == VOICE_ALLOCATOR_ROUND_ROBIN) {
+    byte free_voice = _voice_allocator_first_free(a, a->next);
+    return free_voice < a->count ? free_voice : a->next;
+  }
+
+  if (policy == VOICE_ALLOCATOR_SAME_NOTE) {
+    for (byte i = 0; i < a->count; i++) {
+      if (a->voices[i].phase != VOICE_FREE && a->voices[i].note == note) {
+        return i;
+      }
+    }
+  }
+
+  byte free_voice = _voice_allocator_first_free(a, 0);
+  if (free_voice < a->count) {
+    return free_voice;
+  }
+
+  switch (policy) {
+  case VOICE_ALLOCATOR_QUIETEST:
+    return _voice_allocator_quietest(a, false);
+  case VOICE_ALLOCATOR_RELEASED_FIRST:
+  case VOICE_ALLOCATOR_SAME_NOTE: {
+    byte released = _voice_allocator_quietest(a, true);
+    return released < a->count ? released : _voice_allocator_oldest(a);
+  }
+  default:
+    return _voice_allocator_oldest(a);
+  }
+}
+
+// `voice` started playing `note`
+//
+// O(voices)
+void voice_allocator_assign(voice_allocator *a, byte voice, byte note) {
+  if (voice >= a->count) {
+    return;
+  }
+  // ages stop at 255 rather than wrap back to 0 and look brand new
+  for (byte i = 0; i < a->count; i++) {
+    if (_voice_allocator_age(a, i) == 255) {
+      a->voices[i].assigned++;
+    }
+  }
+  a->voices[voice].phase = VOICE_HELD;
+  a->voices[voice].note = note;
+  a->voices[voice].assigned = ++a->assignments;
+  a->next = (voice + 1) % a->count;
+}
+
+// `voice`'s note was let go, and it's in its release phase
+//
+// O(1)
+void voice_allocator_release(voice_allocator *a, byte voice) {
+  if (voice < a->count && a->voices[voice].phase == VOICE_HELD) {
+    a->voices[voice].phase = VOICE_RELEASED;
+  }
+}
+
+// `voice` is silent
+//
+// O(1)
+void voice_allocator_free(voice_allocator *a, byte voice) {
+  if (voice < a->count) {
+    a->voices[voice].phase = VOICE_FREE;
+    a->voices[voice].level = 0;
+  }
+}
+
+// O(1)
+void voice_allocator_set_level(voice_allocator *a, byte voice, byte level) {
+  if (voice < a->count) {
+    a->voices[voice].level = level;
+  }
+}
+
+// O(voices)
+void voice_allocator_inspect(const voice_allocator *a, FILE *stream) {
+  static const char phases[] = { '-', 'H', 'R' };
+
+  fprintf(stream, "va(%u): ", a->count);
+  for (byte i = 0; i < a->count; i++) {
+    const voice_state *v = &a->voices[i];
+    fprintf(stream, i == 0 ? "%c%u@%u" : " %c%u@%u", phases[v->phase], v->note, v->level);
+  }
+  fprintf(stream, "%s", "\n");
+}
+
+// private below
+
+// how many assignments ago `voice` got its note
+static byte _voice_allocator_age(const voice_allocator *a, byte voice) {
+  return (byte)(a->assignments - a->voices[voice].assigned);
+}
+
+// the first free voice at or after `from` (wrapping around), or `count` if
+// there isn't one
+static byte _voice_allocator_first_free(const voice_allocator *a, byte from) {
+  for (byte n = 0; n < a->count; n++) {
+    byte i = (from + n) % a->count;
+    if (a->voices[i].phase == VOICE_FREE) {
+      return i;
+    }
+  }
+  return a->count;
+}
+
+static byte _voice_allocator_oldest(const voice_allocator *a) {
+  byte oldest = 0;
+  for (byte i = 1; i < a->count; i++) {
+    if (_voice_allocator_age(a, i) > _voice_allocator_age(a, oldest)) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+// the quietest voice, older first on a tie, or `count` if `released_only` and
+// nothing's released
+static byte _voice_allocator_quietest(const voice_allocator *a, bool released_only) {
+  byte quietest = a->count;
+  for (byte i = 0; i < a->count; i++) {
+    const voice_state *v = &a->voices[i];
+    if (released_only && v->phase != VOICE_RELEASED) {
+      continue;
+    }
+    if (quietest == a->count ||
+        v->level < a->voices[quietest].level ||
+        (v->level == a->voices[quietest].level && _voice_allocator_age(a, i) > _voice_allocator_age(a, quietest))) {
+      quietest = i;
+    }
+  }
+  return quietest;
+}
+
+#endif /* SRC_VOICE_ALLOCATOR_H */
@@ -0,0 +1,59 @@
+# Sums the worst-case cycles of one pass through a function in `avr-objdump -d`
+# output, and fails if it's over a budget:
+#
+#   avr-objdump -d build/SID.ino.elf | awk -v function_name=__vector_17 -v budget=160 -f test/avr_cycles.awk
+#
+# Each instruction is counted once, at its ATmega32u4 worst case: branches as
+# taken, skips as skipping a two-word instruction. So a loop's body counts once;
+# the bus write's waits for Ø2 (see src/sid_avr_bus.h) are bounded by the clock
+# instead, at most one Ø2 period (16 cycles) per edge, and aren't included.
+# Calls only count the call: whatever's called is reported, and should be
+# inlined into an ISR anyway.
+
+function cycles(mnemonic) {
+  if (mnemonic ~ /^br/) return 2
+  if (mnemonic ~ /^(cpse|sbrc|sbrs|sbic|sbis)$/) return 3
+  if (mnemonic ~ /^(call|ret|reti)$/) return 4
+  if (mnemonic ~ /^(rcall|icall|jmp|lpm|elpm)$/) return 3
+  if (mnemonic ~ /^(adiw|sbiw|ld|ldd|st|std|lds|sts|push|pop|rjmp|ijmp|sbi|cbi|mul|muls|mulsu|fmul|fmuls|fmulsu)$/) return 2
+  return 1
+}
+
+BEGIN {
+  inside = 0
+  total = 0
+  count = 0
+  if (function_name == "") function_name = "__vector_17"
+}
+
+# e.g. "00000a3c <__vector_17>:"
+/^[0-9a-f]+ <.*>:$/ {
+  inside = index($0, "<" function_name ">:") > 0
+  next
+}
+
+# e.g. "     a3c:	1f 92       	push	r1"
+inside && /^ *[0-9a-f]+:\t/ {
+  split($0, fields, "\t")
+  split(fields[3], words, " ")
+  mnemonic = words[1]
+  if (mnemonic == "" || mnemonic ~ /^\./) next
+
+  total += cycles(mnemonic)
+  count++
+  if (mnemonic ~ /^(call|rcall|icall)$/) {
+    printf("%s calls %s: not counted\n", function_name, fields[4])
+  }
+}
+
+END {
+  if (count == 0) {
+    printf("%s: not found\n", function_name)
+    exit 1
+  }
+  printf("%s: %d instructions, %d cycles\n", function_name, count, total)
+  if (budget != "" && total > budget + 0) {
+    printf("%s: over budget by %d cycles\n", function_name, total - budget)
+    exit 1
+  }
+}
@@ -0,0 +1,189 @@
+#include "test_helper.h"
+#include "../src/control_scheduler.h"
+
+// stands in for the timer: each task "takes" however long `task_cost` says
+uint16_t fake_clock = 0;
+uint16_t task_cost = 0;
+unsigned int fast_runs = 0;
+unsigned int slow_runs = 0;
+
+uint16_t control_scheduler_clock() { return fake_clock; }
+
+static void fast_task() {
+  fast_runs++;
+  fake_clock += task_cost;
+}
+
+static void slow_task() {
+  slow_runs++;
+  fake_clock += task_cost * 2;
+}
+
+static void ticks(control_scheduler *s, unsigned int count) {
+  for (unsigned int i = 0; i < count; i++) {
+    control_scheduler_tick(s);
+  }
+}
+
+static void reset_fakes() {
+  fake_clock = 0;
+  task_cost = 0;
+  fast_runs = 0;
+  slow_runs = 0;
+}
+
+static void test_control_scheduler_periods() {
+  control_scheduler s;
+  control_scheduler_initialize(&s);
+  reset_fakes();
+
+  assert_int_eq(0, control_scheduler_add(&s, fast_task, 1));
+  assert_int_eq(1, control_scheduler_add(&s, slow_task, 4));
+
+  assert_int_eq(0, control_scheduler_run(&s)); // nothing due before the first tick
+
+  // run every tick, the way a loop that keeps up would
+  for (unsigned int i = 0; i < 12; i++) {
+    control_scheduler_tick(&s);
+    control_scheduler_run(&s);
+  }
+  assert_int_eq(12, fast_runs);
+  assert_int_eq(3, slow_runs);
+  assert_long_eq(0UL, (unsigned long)control_scheduler_overruns(&s));
+
+  // running again before the next tick does nothing
+  assert_int_eq(0, control_scheduler_run(&s));
+}
+
+static void test_control_scheduler_overruns() {
+  control_scheduler s;
+  control_scheduler_initialize(&s);
+  reset_fakes();
+
+  control_scheduler_add(&s, fast_task, 1);
+  control_scheduler_add(&s, slow_task, 4);
+
+  // the loop was busy for 10 ticks: each task runs once, and counts what it missed
+  ticks(&s, 10);
+  assert_int_eq(2, control_scheduler_run(&s));
+  assert_int_eq(1, fast_runs);
+  assert_int_eq(1, slow_runs);
+  assert_long_eq(9UL, (unsigned long)s.tasks[0].overruns);
+  assert_long_eq(1UL, (unsigned long)s.tasks[1].overruns);
+  assert_long_eq(10UL, (unsigned long)control_scheduler_overruns(&s));
+
+  // and then it's back on its period: the slow task was due at 4 and 8, so next at 12
+  ticks(&s, 1);
+  assert_int_eq(1, control_scheduler_run(&s));
+  ticks(&s, 1);
+  assert_int_eq(2, control_scheduler_run(&s));
+  assert_int_eq(2, slow_runs);
+
+  control_scheduler_reset_stats(&s);
+  assert_long_eq(0UL, (unsigned long)control_scheduler_overruns(&s));
+  assert_long_eq(0UL, (unsigned long)s.tasks[0].runs);
+}
+
+static void test_control_scheduler_longest_run() {
+  control_scheduler s;
+  control_scheduler_initialize(&s);
+  reset_fakes();
+
+  control_scheduler_add(&s, fast_task, 1);
+  control_scheduler_add(&s, slow_task, 1);
+
+  task_cost = 30;
+  ticks(&s, 1);
+  control_scheduler_run(&s);
+  task_cost = 10;
+  ticks(&s, 1);
+  control_scheduler_run(&s);
+
+  assert_int_eq(30, s.tasks[0].longest_run);
+  assert_int_eq(60, s.tasks[1].longest_run);
+
+  // the clock wrapping in the middle of a run doesn't matter
+  fake_clock = 65530;
+  task_cost = 40;
+  ticks(&s, 1);
+  control_scheduler_run(&s);
+  assert_int_eq(40, s.tasks[0].longest_run);
+  assert_int_eq(80, s.tasks[1].longest_run);
+}
+
+static void test_control_scheduler_tick_wrap() {
+  control_scheduler s;
+  control_scheduler_initialize(&s);
+  reset_fakes();
+
+  control_scheduler_add(&s, slow_task, 100);
+
+  // the ISR's byte wraps many times; the schedule doesn't care
+  for (unsigned int i = 0; i < 1000; i++) {
+    control_scheduler_tick(&s);
+    control_scheduler_run(&s);
+  }
+  assert_int_eq(10, slow_runs);
+  assert_int_eq(1000, s.now);
+  assert_long_eq(0UL, (unsigned long)control_scheduler_overruns(&s));
+}
+
+static void test_control_scheduler_saturates() {
+  control_scheduler s;
+  control_scheduler_initialize(&s);
+  reset_fakes();
+
+  control_scheduler_add(&s, fast_task, 1);
+
+  // a stall longer than the byte can count: it stops at 255 instead of
+  // wrapping to a handful, and says so
+  ticks(&s, 300);
+  assert_int_eq(1, control_scheduler_run(&s));
+  assert_int_eq(255, s.now);
+  assert_long_eq(1UL, (unsigned long)s.overflows);
+  assert_long_eq(254UL, (unsigned long)s.tasks[0].overruns);
+  assert_long_eq(255UL, (unsigned long)control_scheduler_overruns(&s));
+
+  // exactly 256 would have wrapped to 0 and looked like nothing happened
+  ticks(&s, 256);
+  assert_int_eq(1, control_scheduler_run(&s));
+  assert_long_eq(2UL, (unsigned long)s.overflows);
+
+  // and once it's caught up, it counts normally again
+  ticks(&s, 255);
+  control_scheduler_run(&s);
+  assert_long_eq(2UL, (unsigned long)s.overflows);
+
+  control_scheduler_reset_stats(&s);
+  assert_long_eq(0UL, (unsigned long)control_scheduler_overruns(&s));
+}
+
+static void test_control_scheduler_full() {
+  control_scheduler s;
+  control_scheduler_initialize(&s);
+
+  for (byte i = 0; i < CONTROL_SCHEDULER_MAX_TASKS; i++) {
+    assert_int_eq(i, control_scheduler_add(&s, fast_task, 1));
+  }
+  assert_int_eq(CONTROL_SCHEDULER_MAX_TASKS, control_scheduler_add(&s, fast_task, 1));
+
+  // a period of 0 would never come round again
+  control_scheduler_initialize(&s);
+  control_scheduler_add(&s, fast_task, 0);
+  assert_int_eq(1, s.tasks[0].period);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_control_scheduler_periods();
+  test_control_scheduler_overruns();
+  test_control_scheduler_longest_run();
+  test_control_scheduler_tick_wrap();
+  test_control_scheduler_saturates();
+  test_control_scheduler_full();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
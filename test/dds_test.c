@@ -0,0 +1,171 @@
+#include "test_helper.h"
+#include "../src/dds.h"
+
+#define TICK_MICROS 64 // the modulation task's period in SID.ino, with one chip
+
+// what the SID plays for a register word (`CLOCK_SIGNAL_FACTOR` in sid.h)
+static double register_word_hertz(word register_word) {
+  return register_word * 1000000.0 / 16777216.0;
+}
+
+// the float reference, in the same units as the DDS
+static double reference_sample(word register_word, unsigned long ticks) {
+  float seconds = ticks * (TICK_MICROS / 1000000.0);
+  return 127 * sine_waveform(register_word_hertz(register_word), seconds, 1.0, 0.0);
+}
+
+static void test_dds_sine_table() {
+  for (unsigned int i = 0; i < 256; i++) {
+    double expected = sine_waveform(1.0, i / 256.0, 127, 0);
+    bool close = fabs(dds_sample((uint32_t)i << 24, DDS_SINE) - expected) <= 0.5;
+    assert_true(close);
+  }
+
+  assert_int_eq(0, dds_sample(0, DDS_SINE));
+  assert_int_eq(127, dds_sample(0x40000000UL, DDS_SINE));
+  assert_int_eq(0, dds_sample(0x80000000UL, DDS_SINE));
+  assert_int_eq(-127, dds_sample(0xC0000000UL, DDS_SINE));
+}
+
+static void test_dds_triangle_and_saw() {
+  assert_int_eq(1, dds_sample(0, DDS_TRIANGLE));
+  assert_int_eq(127, dds_sample(0x3F000000UL, DDS_TRIANGLE));
+  assert_int_eq(-127, dds_sample(0xBF000000UL, DDS_TRIANGLE));
+  assert_int_eq(-1, dds_sample(0xFF000000UL, DDS_TRIANGLE));
+
+  assert_int_eq(0, dds_sample(0, DDS_SAW));
+  assert_int_eq(127, dds_sample(0x7F000000UL, DDS_SAW));
+  assert_int_eq(-127, dds_sample(0x80000000UL, DDS_SAW));
+  assert_int_eq(-1, dds_sample(0xFF000000UL, DDS_SAW));
+
+  // neither jumps by more than a step anywhere but the saw's reset
+  for (unsigned int i = 1; i < 256; i++) {
+    int step = dds_sample((uint32_t)i << 24, DDS_TRIANGLE) - dds_sample((uint32_t)(i - 1) << 24, DDS_TRIANGLE);
+    bool smooth = step == 2 || step == -2 || step == 0;
+    assert_true(smooth);
+  }
+}
+
+// the phase after any number of ticks is exactly where the float reference
+// says it should be
+static void test_dds_frequency_accuracy() {
+  word register_words[] = { 17, 274, 7382, 34334, 65535 }; // ~1Hz, C0, A4, ~2kHz, the highest
+  unsigned long tick_counts[] = { 1, 999, 20000, 1234567 };
+
+  for (byte w = 0; w < sizeof(register_words) / sizeof(register_words[0]); w++) {
+    for (byte t = 0; t < sizeof(tick_counts) / sizeof(tick_counts[0]); t++) {
+      dds_oscillator o;
+      dds_reset(&o);
+      dds_set_register_word(&o, register_words[w], TICK_MICROS);
+
+      for (unsigned long i = 0; i < tick_counts[t]; i++) {
+        dds_tick(&o, DDS_SINE);
+      }
+
+      double cycles = register_word_hertz(register_words[w]) * tick_counts[t] * (TICK_MICROS / 1000000.0);
+      double expected = fmod(cycles, 1.0) * 4294967296.0;
+      bool exact = fabs(o.phase - expected) < 1.0;
+      assert_true(exact);
+    }
+  }
+}
+
+// and each sample is within the table's error of the float sine
+static void test_dds_matches_float_reference() {
+  word register_words[] = { 274, 7382, 34334 }; // C0, A4, ~2kHz: well under the tick rate's Nyquist
+  double worst = 0;
+
+  for (byte w = 0; w < sizeof(register_words) / sizeof(register_words[0]); w++) {
+    dds_oscillator o;
+    dds_reset(&o);
+    dds_set_register_word(&o, register_words[w], TICK_MICROS);
+
+    for (unsigned long i = 0; i < 4000; i++) {
+      // float seconds lose precision as they grow, so compare early on
+      double error = fabs(dds_tick(&o, DDS_SINE) - reference_sample(register_words[w], i));
+      if (error > worst) {
+        worst = error;
+      }
+    }
+  }
+
+  printf("\nworst DDS sine error vs float: %.2f of 127\n", worst);
+  // a 256-entry table is up to 2*pi/256 of a cycle behind: ~3.1, plus rounding
+  bool close = worst < 3.7;
+  assert_true(close);
+}
+
+static void test_dds_cycle_count() {
+  // a second of A4 (440.001Hz), ticked every microsecond so it isn't aliased
+  dds_oscillator o;
+  dds_reset(&o);
+  dds_set_register_word(&o, 7382, 1);
+
+  int previous = dds_tick(&o, DDS_SINE);
+  unsigned int rising = 0;
+  for (unsigned long i = 1; i < 1000000; i++) {
+    int sample = dds_tick(&o, DDS_SINE);
+    if (previous < 0 && sample >= 0) {
+      rising++;
+    }
+    previous = sample;
+  }
+  // it started a cycle at 0, and the 441st starts just before the second is up
+  assert_int_eq(440, rising);
+}
+
+static void test_dds_reset() {
+  dds_oscillator o;
+  dds_reset(&o);
+  dds_set_register_word(&o, 7382, TICK_MICROS);
+  for (byte i = 0; i < 10; i++) {
+    dds_tick(&o, DDS_SINE);
+  }
+  bool moved = o.phase != 0;
+  assert_true(moved);
+
+  dds_reset(&o);
+  assert_long_eq(0UL, (unsigned long)o.phase);
+  assert_int_eq(0, dds_tick(&o, DDS_SINE));
+
+  // a register word of 0 holds still
+  dds_reset(&o);
+  dds_set_register_word(&o, 0, TICK_MICROS);
+  dds_tick(&o, DDS_SINE);
+  assert_long_eq(0UL, (unsigned long)o.phase);
+}
+
+static void test_dds_skip() {
+  dds_oscillator ticked;
+  dds_oscillator skipped;
+  dds_reset(&ticked);
+  dds_reset(&skipped);
+  dds_set_register_word(&ticked, 7382, TICK_MICROS);
+  dds_set_register_word(&skipped, 7382, TICK_MICROS);
+
+  for (unsigned int i = 0; i < 1000; i++) {
+    dds_tick(&ticked, DDS_SINE);
+  }
+  dds_skip(&skipped, 999);
+  dds_tick(&skipped, DDS_SINE);
+  assert_long_eq((unsigned long)ticked.phase, (unsigned long)skipped.phase);
+
+  dds_skip(&skipped, 0);
+  assert_long_eq((unsigned long)ticked.phase, (unsigned long)skipped.phase);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_dds_sine_table();
+  test_dds_triangle_and_saw();
+  test_dds_frequency_accuracy();
+  test_dds_matches_float_reference();
+  test_dds_cycle_count();
+  test_dds_reset();
+  test_dds_skip();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,332 @@
+#include "test_helper.h"
+#include "../src/deque.h"
+
+static void test_deque_initialize() {
+  deque<note, 4> notes;
+  deque<note, 4> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  assert_int_eq(4, dq->max_length);
+  assert_int_eq(0, deque_length(dq));
+  assert_int_eq(4, dq->ht.max_size);
+  assert_not_null(dq->node_print_function);
+
+  NOTE_FIXTURES;
+
+  node<note> node0 = { .data=note0, .previous=LIST_NODE_NONE, .next=1 };
+  node<note> node1 = { .data=note1, .previous=0, .next=2 };
+  node<note> node2 = { .data=note2, .previous=1, .next=LIST_NODE_NONE };
+
+  // set up the deque without prepend/append
+  dq->ht.array[0] = { .key=note0.number, .value=node0 };
+  dq->ht.array[1] = { .key=note1.number, .value=node1 };
+  dq->ht.array[2] = { .key=note2.number, .value=node2 };
+  dq->ht.size = 3;
+
+  dq->first = 0;
+  dq->last = 2;
+
+  assert_long_eq((long)&dq->ht.array[0].value, (long)deque_first_node(dq));
+  assert_long_eq((long)&dq->ht.array[2].value, (long)deque_last_node(dq));
+  assert_int_eq(3, deque_length(dq));
+
+  // traversing forward
+  assert_int_eq(100, deque_first_node(dq)->data.number);
+  assert_int_eq(101, deque_next_node(dq, deque_first_node(dq))->data.number);
+  assert_int_eq(102, deque_next_node(dq, deque_next_node(dq, deque_first_node(dq)))->data.number);
+  assert_null(deque_next_node(dq, deque_next_node(dq, deque_next_node(dq, deque_first_node(dq)))));
+
+  // traversing backward
+  assert_int_eq(102, deque_last_node(dq)->data.number);
+  assert_int_eq(101, deque_previous_node(dq, deque_last_node(dq))->data.number);
+  assert_int_eq(100, deque_previous_node(dq, deque_previous_node(dq, deque_last_node(dq)))->data.number);
+  assert_null(deque_previous_node(dq, deque_previous_node(dq, deque_previous_node(dq, deque_last_node(dq)))));
+}
+
+static void test_deque_append_replace() {
+  deque<note, 128> notes;
+  deque<note, 128> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  NOTE_FIXTURES;
+
+  deque_append_replace(dq, note0);
+  assert_not_null(deque_first_node(dq));
+  assert_not_null(deque_last_node(dq));
+  assert_int_eq(1, deque_length(dq));
+  assert_null(deque_next_node(dq, deque_last_node(dq)));
+  assert_null(deque_previous_node(dq, deque_last_node(dq)));
+  assert_int_eq(100, deque_last_node(dq)->data.number);
+  assert_not_null(deque_last_node(dq));
+
+  deque_append_replace(dq, note1);
+  assert_int_eq(101, deque_last_node(dq)->data.number);
+  assert_int_eq(2, deque_length(dq));
+  assert_not_null(deque_next_node(dq, deque_first_node(dq)));
+  assert_int_eq(101, deque_next_node(dq, deque_first_node(dq))->data.number);
+  assert_not_null(deque_previous_node(dq, deque_last_node(dq)));
+  assert_int_eq(100, deque_previous_node(dq, deque_last_node(dq))->data.number);
+  assert_not_null(deque_last_node(dq));
+
+  deque_append_replace(dq, note2);
+  assert_int_eq(102, deque_last_node(dq)->data.number);
+  assert_int_eq(3, deque_length(dq));
+  assert_not_null(deque_last_node(dq));
+
+  deque_append_replace(dq, note2); // since we use a hashmap, append should *replace* in this case.
+  assert_int_eq(102, deque_last_node(dq)->data.number);
+  assert_int_eq(3, deque_length(dq));
+  assert_not_null(deque_last_node(dq));
+  assert_true(deque_last_node(dq) != deque_previous_node(dq, deque_last_node(dq))); // ensure we don't have self-referential linked list nodes
+
+  fprintf(stdout, "\n");
+  deque_inspect(dq);
+}
+
+static void test_deque_prepend_replace() {
+  deque<note, 128> notes;
+  deque<note, 128> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  assert_int_eq(128, dq->max_length);
+  assert_int_eq(0, deque_length(dq));
+  assert_not_null(dq->node_print_function);
+
+  NOTE_FIXTURES;
+
+  deque_prepend_replace(dq, note2);
+  assert_int_eq(102, deque_first_node(dq)->data.number);
+  assert_not_null(deque_first_node(dq));
+  assert_not_null(deque_first_node(dq));
+  assert_not_null(deque_last_node(dq));
+
+  assert_long_eq((long)deque_last_node(dq), (long)deque_first_node(dq));
+  assert_null(deque_next_node(dq, deque_first_node(dq)));
+  assert_null(deque_previous_node(dq, deque_first_node(dq)));
+  deque_prepend_replace(dq, note1);
+
+  assert_int_eq(101, deque_first_node(dq)->data.number);
+  assert_not_null(deque_first_node(dq));
+  assert_not_null(deque_previous_node(dq, deque_last_node(dq)));
+  assert_int_eq(101, deque_previous_node(dq, deque_last_node(dq))->data.number);
+
+  deque_prepend_replace(dq, note0);
+  assert_int_eq(100, deque_first_node(dq)->data.number);
+  assert_int_eq(3, deque_length(dq));
+
+  deque_prepend_replace(dq, note0); // since we use a hashmap, append should *replace* in this case.
+  assert_int_eq(100, deque_first_node(dq)->data.number);
+  assert_int_eq(3, deque_length(dq));
+  assert_not_null(deque_first_node(dq));
+  assert_true(deque_first_node(dq) != deque_next_node(dq, deque_first_node(dq))); // ensure we don't have self-referential linked list nodes
+
+  fprintf(stdout, "\n");
+  deque_inspect(dq);
+}
+
+static void test_deque_remove_first() {
+  deque<note, 128> notes;
+  deque<note, 128> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  NOTE_FIXTURES;
+
+  deque_append_replace(dq, note0);
+  deque_append_replace(dq, note1);
+  deque_append_replace(dq, note2);
+
+  maybe_node_data<note> removed = deque_remove_first(dq);
+  assert_true(removed.exists);
+  assert_int_eq(100, removed.unwrap.number);
+  assert_not_null(deque_first_node(dq));                  // assert the `first` pointer got reset correctly
+  assert_int_eq(101, deque_first_node(dq)->data.number);  // assert the `first` pointer got reset correctly
+  assert_int_eq(2, deque_length(dq));
+
+  removed = deque_remove_first(dq);
+  assert_true(removed.exists);
+  assert_int_eq(101, removed.unwrap.number);
+  assert_not_null(deque_first_node(dq));
+  assert_int_eq(102, deque_first_node(dq)->data.number);
+  assert_int_eq(1, deque_length(dq));
+
+  removed = deque_remove_first(dq);
+  assert_true(removed.exists);
+  assert_int_eq(102, removed.unwrap.number);
+  assert_null(deque_first_node(dq));
+  assert_int_eq(0, deque_length(dq));
+}
+
+static void test_deque_remove_last() {
+  deque<note, 128> notes;
+  deque<note, 128> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  NOTE_FIXTURES;
+
+  deque_prepend_replace(dq, note2);
+  deque_prepend_replace(dq, note1);
+  deque_prepend_replace(dq, note0);
+
+  maybe_node_data<note> removed = deque_remove_last(dq);
+  assert_true(removed.exists);
+  assert_int_eq(102, removed.unwrap.number);
+  assert_not_null(deque_last_node(dq));                  // assert the `first` pointer got reset correctly
+  assert_int_eq(101, deque_last_node(dq)->data.number);  // assert the `first` pointer got reset correctly
+  assert_int_eq(2, deque_length(dq));
+
+  removed = deque_remove_last(dq);
+  assert_true(removed.exists);
+  assert_int_eq(101, removed.unwrap.number);
+  assert_not_null(deque_last_node(dq));
+  assert_int_eq(100, deque_last_node(dq)->data.number);
+  assert_int_eq(1, deque_length(dq));
+
+  removed = deque_remove_last(dq);
+  assert_true(removed.exists);
+  assert_int_eq(100, removed.unwrap.number);
+  assert_null(deque_last_node(dq));
+  assert_int_eq(0, deque_length(dq));
+}
+
+static void test_deque_remove_by_key() {
+  deque<note, 128> notes;
+  deque<note, 128> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  NOTE_FIXTURES;
+
+  deque_append_replace(dq, note0);
+  deque_append_replace(dq, note1);
+  deque_append_replace(dq, note2);
+
+  maybe_node_data<note> removed = deque_remove_by_key(dq, 10); // non-existent thing should be null
+  assert_false(removed.exists);
+  assert_int_eq(3, deque_length(dq));
+
+  removed = deque_remove_by_key(dq, 100);
+  assert_true(removed.exists);
+  assert_int_eq(100, removed.unwrap.number);
+  assert_int_eq(2, deque_length(dq));
+  assert_not_null(deque_first_node(dq));
+  assert_int_eq(101, deque_first_node(dq)->data.number);
+  assert_not_null(deque_next_node(dq, deque_first_node(dq)));
+  assert_int_eq(102, deque_next_node(dq, deque_first_node(dq))->data.number);
+
+  removed = deque_remove_by_key(dq, 101);
+  assert_true(removed.exists);
+  assert_int_eq(101, removed.unwrap.number);
+  assert_int_eq(1, deque_length(dq));
+
+  removed = deque_remove_by_key(dq, 102);
+  assert_true(removed.exists);
+  assert_int_eq(102, removed.unwrap.number);
+  assert_int_eq(0, deque_length(dq));
+}
+
+static void test_deque_find_by_key() {
+  deque<note, 128> notes;
+  deque<note, 128> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  NOTE_FIXTURES;
+
+  deque_append_replace(dq, note0);
+  deque_append_replace(dq, note1);
+  deque_append_replace(dq, note2);
+  assert_int_eq(3, deque_length(dq));
+
+  note *found = deque_find_by_key(dq, 100);
+  assert_not_null(found);
+  assert_int_eq(100, found->number);
+  found = deque_find_by_key(dq, 101);
+  assert_not_null(found);
+  assert_int_eq(101, found->number);
+  found = deque_find_by_key(dq, 102);
+  assert_not_null(found);
+  assert_int_eq(102, found->number);
+  found = deque_find_by_key(dq, 3);
+  assert_null(found);
+
+  deque_empty(dq);
+  deque_append_replace(dq, note0);
+  deque_append_replace(dq, note1);
+  deque_append_replace(dq, note2);
+  assert_int_eq(3, deque_length(dq));
+}
+
+static void test_deque_survives_hash_shifts() {
+  deque<note, 4> notes;
+  deque<note, 4> *dq = &notes;
+  deque_initialize(dq, stdout, _note_indexer, _note_node_print_function);
+
+  // all three hash to slot 0, so removing the first shifts the other two back
+  // in the hash's array, and the deque has to follow them
+  note note0 = { .number=0 };
+  note note4 = { .number=4 };
+  note note8 = { .number=8 };
+  deque_append_replace(dq, note0);
+  deque_append_replace(dq, note4);
+  deque_append_replace(dq, note8);
+
+  maybe_node_data<note> removed = deque_remove_by_key(dq, 0);
+  assert_true(removed.exists);
+  assert_int_eq(2, deque_length(dq));
+
+  assert_int_eq(4, deque_first_node(dq)->data.number);
+  assert_int_eq(8, deque_next_node(dq, deque_first_node(dq))->data.number);
+  assert_null(deque_next_node(dq, deque_next_node(dq, deque_first_node(dq))));
+  assert_int_eq(8, deque_last_node(dq)->data.number);
+  assert_int_eq(4, deque_previous_node(dq, deque_last_node(dq))->data.number);
+  assert_null(deque_previous_node(dq, deque_previous_node(dq, deque_last_node(dq))));
+  assert_long_eq((long)deque_first_node(dq), (long)deque_find_node_by_key(dq, 4));
+  assert_long_eq((long)deque_last_node(dq), (long)deque_find_node_by_key(dq, 8));
+
+  removed = deque_remove_first(dq);
+  assert_int_eq(4, removed.unwrap.number);
+  assert_int_eq(8, deque_first_node(dq)->data.number);
+  assert_null(deque_previous_node(dq, deque_first_node(dq)));
+
+}
+
+static void test_deque_ram_budget() {
+  // what a held note costs, in bytes, on the 32U4 (2-byte pointers and ints):
+  // a 1-byte note number plus everything around it
+  unsigned int avr_slot_before = 1 + 1 + 4 + 4  // note: two unsigned long timestamps
+                               + 2 + 2 + 2      // node: two pointers, an unsigned int key
+                               + 1 + 1;         // maybe_hash_table_element: exists, key
+  unsigned int slot = sizeof(hash_table_element<unsigned char, node<note>>);
+
+  printf("\ndeque slot: %u bytes, was %u on the AVR; deque<note, 16>: %u bytes\n", slot, avr_slot_before, (unsigned int)sizeof(deque<note, 16>));
+
+  // no pointers or ints left in a slot, so these hold on the AVR too
+  assert_int_eq(6, (int)sizeof(note));
+  assert_int_eq(8, (int)sizeof(node<note>));
+  assert_int_eq(10, slot); // the key is the only flag left
+
+  // deque<note, 16> on the AVR: the slots, plus first/last, the hash's size,
+  // `moved` + context, the stream and both function pointers
+  unsigned int avr_overhead = 1 + 1 + 2 + 2 + 2 + 2 + 2 + 2;
+  unsigned int avr_deque_16 = 16 * slot + avr_overhead;
+  bool fits_budget = avr_deque_16 <= 192;
+  assert_true(fits_budget);
+  bool slots_dominate = sizeof(deque<note, 16>) - 16 * slot <= 64; // whatever the platform's pointer size
+  assert_true(slots_dominate);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_deque_initialize();
+  test_deque_append_replace();
+  test_deque_prepend_replace();
+  test_deque_remove_first();
+  test_deque_remove_last();
+  test_deque_remove_by_key();
+  test_deque_find_by_key();
+  test_deque_survives_hash_shifts();
+  test_deque_ram_budget();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,160 @@
+#include "test_helper.h"
+#include "../src/envelope.h"
+
+// AD/SR register values: attack/decay and sustain/release nibbles
+#define AD(a, d) (((a) << 4) | (d))
+#define SR(s, r) (((s) << 4) | (r))
+
+static void test_envelope_release_cycles_match_the_datasheet() {
+  // a full release, 255 down to 0, is 756 periods
+  assert_long_eq(9LU * 756, envelope_release_cycles(0, 255));         // "6ms"
+  assert_long_eq(392LU * 756, envelope_release_cycles(8, 255));       // "300ms"
+  assert_long_eq(31251LU * 756, envelope_release_cycles(15, 255));    // "24s"
+
+  // the slow tail: the last 6 levels take 30 periods each
+  assert_long_eq(9LU * 30, envelope_release_cycles(0, 1));
+  assert_long_eq(9LU * 6 * 30, envelope_release_cycles(0, 6));
+  assert_long_eq(9LU * (6 * 30 + 16), envelope_release_cycles(0, 7));
+  assert_long_eq(0UL, envelope_release_cycles(0, 0));
+
+  // from halfway up it's still most of the time
+  bool tail_heavy = envelope_release_cycles(8, 128) > envelope_release_cycles(8, 255) / 2;
+  assert_true(tail_heavy);
+}
+
+static void test_envelope_attack_decay_sustain() {
+  envelope e;
+  envelope_reset(&e);
+  byte ad = AD(2, 2); // 16ms attack, 48ms decay
+  byte sr = SR(10, 0); // sustain at 170
+
+  assert_int_eq(0, envelope_level(&e, 100, ad, sr));
+  assert_true(envelope_silent(&e, 100));
+
+  envelope_gate(&e, true, 100, ad, sr);
+  assert_false(envelope_silent(&e, 100));
+  assert_int_eq(0, envelope_level(&e, 100, ad, sr));
+  assert_int_eq(1000 / 63, envelope_level(&e, 101, ad, sr));
+  assert_int_eq(8000 / 63, envelope_level(&e, 108, ad, sr));
+
+  // attack tops out after 255 * 63 = 16065 cycles, and decay takes over
+  assert_int_eq(16000 / 63, envelope_level(&e, 116, ad, sr));
+  assert_int_eq(255 - (17000 - 16065) / 63, envelope_level(&e, 117, ad, sr));
+
+  // and stops at sustain
+  assert_int_eq(170, envelope_level(&e, 200, ad, sr));
+  assert_int_eq(170, envelope_level(&e, 30000, ad, sr));
+
+  // gating it again while it's on changes nothing
+  envelope_gate(&e, true, 300, ad, sr);
+  assert_int_eq(100, e.since);
+}
+
+static void test_envelope_release_deadline() {
+  envelope e;
+  envelope_reset(&e);
+  byte ad = AD(0, 0);
+  byte sr = SR(15, 8); // sustain at 255, 300ms release
+
+  envelope_gate(&e, true, 1000, ad, sr);
+  envelope_gate(&e, false, 2000, ad, sr);
+
+  note_ticks release_ticks = (392L * 756 + 999) / 1000;
+  assert_int_eq(2000 + release_ticks, e.silent_at);
+  assert_int_eq(255, envelope_level(&e, 2000, ad, sr));
+  bool releasing = envelope_level(&e, 2100, ad, sr) < 255;
+  assert_true(releasing);
+  assert_false(envelope_silent(&e, 2000 + release_ticks - 1));
+  assert_true(envelope_silent(&e, 2000 + release_ticks));
+  assert_int_eq(0, envelope_level(&e, 2000 + release_ticks, ad, sr));
+  assert_true(envelope_silent(&e, 2000 + release_ticks + 20000));
+}
+
+static void test_envelope_release_depends_on_level_reached() {
+  envelope full;
+  envelope early;
+  envelope_reset(&full);
+  envelope_reset(&early);
+  byte ad = AD(10, 0); // 500ms attack
+  byte sr = SR(15, 8);
+
+  envelope_gate(&full, true, 1000, ad, sr);
+  envelope_gate(&full, false, 3000, ad, sr);
+  envelope_gate(&early, true, 1000, ad, sr);
+  envelope_gate(&early, false, 1100, ad, sr); // ~10% into the attack
+
+  byte reached = 100000 / 1954;
+  assert_int_eq(reached, early.start_level);
+  note_ticks early_release = note_ticks_since(early.silent_at, 1100);
+  note_ticks full_release = note_ticks_since(full.silent_at, 3000);
+  assert_int_eq((int)((392L * 756 + 999) / 1000), full_release);
+  assert_int_eq((int)((envelope_release_cycles(8, reached) + 999) / 1000), early_release);
+  bool shorter = early_release < full_release;
+  assert_true(shorter);
+
+  // re-gating mid-release attacks from where the release got to
+  envelope_gate(&early, true, 1110, ad, sr);
+  bool picked_up = early.start_level > 0 && early.start_level <= reached;
+  assert_true(picked_up);
+}
+
+static void test_envelope_release_from_silence() {
+  envelope e;
+  envelope_reset(&e);
+  byte ad = AD(15, 15);
+  byte sr = SR(0, 15);
+
+  envelope_gate(&e, true, 500, ad, sr);
+  envelope_gate(&e, false, 500, ad, sr); // nothing happened in between
+  assert_int_eq(0, e.silent_at);
+  assert_true(envelope_silent(&e, 500));
+}
+
+static void test_envelope_deadline_wraps() {
+  envelope e;
+  envelope_reset(&e);
+  byte ad = AD(0, 0);
+  byte sr = SR(15, 8);
+
+  envelope_gate(&e, true, 65000, ad, sr);
+  envelope_gate(&e, false, 65400, ad, sr);
+
+  note_ticks deadline = (note_ticks)(65400 + (392L * 756 + 999) / 1000);
+  assert_int_eq(deadline, e.silent_at);
+  assert_false(envelope_silent(&e, 65535));
+  assert_false(envelope_silent(&e, (note_ticks)(deadline - 1)));
+  assert_true(envelope_silent(&e, deadline));
+}
+
+static void test_envelope_clamp_age() {
+  envelope e;
+  envelope_reset(&e);
+  byte ad = AD(0, 0);
+  byte sr = SR(15, 0);
+
+  envelope_gate(&e, true, 1000, ad, sr);
+  envelope_gate(&e, false, 1010, ad, sr);
+
+  // without clamping, a minute later the deadline would look like it's ahead
+  for (unsigned long t = 1010; t < 1010 + 70000UL; t += 1000) {
+    envelope_clamp_age(&e, (note_ticks)t);
+    assert_true(envelope_silent(&e, (note_ticks)t + 1000));
+  }
+  assert_int_eq(0, envelope_level(&e, (note_ticks)(1010 + 70000UL), ad, sr));
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_envelope_release_cycles_match_the_datasheet();
+  test_envelope_attack_decay_sustain();
+  test_envelope_release_deadline();
+  test_envelope_release_depends_on_level_reached();
+  test_envelope_release_from_silence();
+  test_envelope_deadline_wraps();
+  test_envelope_clamp_age();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,353 @@
+#include "test_helper.h"
+#include "../src/note.h"
+#include "../src/hash_table.h"
+
+
+static void test_hash_table_initialize() {
+  hash_table<unsigned char, note, 4> table;
+  hash_table<unsigned char, note, 4> *h = &table;
+  hash_table_initialize(h);
+
+  assert_int_eq(4, h->max_size);
+  assert_int_eq(0, h->size);
+  assert_long_eq(4 * sizeof(hash_table_element<unsigned char, note>), sizeof(h->array));
+}
+
+static void test_hash_table_get_set() {
+  hash_table<unsigned char, note, 4> table;
+  hash_table<unsigned char, note, 4> *h = &table;
+  hash_table_initialize(h);
+  NOTE_FIXTURES;
+
+  // get/set no collisions
+  note *result0 = hash_table_set(h, 100, note0);
+  assert_not_null(result0);
+  assert_long_eq((long)result0, (long)hash_table_get(h, 100));
+  assert_int_eq(1, h->size);
+
+  note *result1 = hash_table_set(h, 100, note0); // set should be idempotent
+  assert_not_null(result1);
+  assert_long_eq((long)result1, (long)hash_table_get(h, 100));
+  assert_int_eq(1, h->size);                               // set should be idempotent
+
+  note *result2 = hash_table_set(h, 101, note1);
+  assert_not_null(result2);
+  assert_long_eq((long)result2, (long)hash_table_get(h, 101));
+  assert_int_eq(2, h->size);
+
+  note *result3 = hash_table_set(h, 102, note2);
+  assert_not_null(result3);
+  assert_long_eq((long)result3, (long)hash_table_get(h, 102));
+  assert_int_eq(3, h->size);
+
+  result0 = hash_table_get(h, 100);
+  assert_not_null(result0);
+  assert_int_eq(100, result0->number);
+
+
+  result1 = hash_table_get(h, 101);
+  assert_not_null(result1);
+  assert_int_eq(101, result1->number);
+
+  result2 = hash_table_get(h, 102);
+  assert_not_null(result2);
+  assert_int_eq(102, result2->number);
+
+  result3 = hash_table_get(h, 69); // shouldn't exist
+  assert_null(result3);
+
+  // get/set with collisions
+  hash_table_initialize(h);
+
+  hash_table_set(h, 0, note0); // hashes to 0
+  result0 = hash_table_get(h, 0);
+  assert_not_null(result0);
+  assert_int_eq(100, result0->number);
+  assert_int_eq(100, h->array[0].value.number);
+
+  hash_table_set(h, 4, note1); // hashes to 0
+  result1 = hash_table_get(h, 4);
+  assert_not_null(result1);
+  assert_int_eq(101, result1->number);
+  assert_int_eq(101, h->array[1].value.number);
+
+  hash_table_set(h, 8, note2); // hashes to 0
+  result2 = hash_table_get(h, 8);
+  assert_not_null(result2);
+  assert_int_eq(102, result2->number);
+  assert_int_eq(102, h->array[2].value.number);
+}
+
+static void test_hash_table_remove() {
+  hash_table<unsigned char, note, 4> table;
+  hash_table<unsigned char, note, 4> *h = &table;
+  hash_table_initialize(h);
+  NOTE_FIXTURES;
+
+  maybe_hash_table_val<note> maybe0 = {.exists=false};
+  maybe_hash_table_val<note> maybe1 = {.exists=false};
+  maybe_hash_table_val<note> maybe2 = {.exists=false};
+
+  unsigned int collision_index_0 = 0; // starting here, insert three collisions into the array
+  unsigned int collision_index_1 = 1;
+  unsigned int collision_index_2 = 2;
+
+  hash_table_set(h, 0, note0); // hashes to 0
+  hash_table_set(h, 4, note1); // hashes to 0
+  hash_table_set(h, 8, note2); // hashes to 0
+
+  maybe0 = hash_table_remove(h, 0);
+  assert_true(maybe0.exists);
+  assert_int_eq(2, h->size);
+  assert_int_eq(100, maybe0.unwrap.number);
+  assert_true(hash_table_slot_used(h, collision_index_0));
+  assert_int_eq(101, h->array[collision_index_0].value.number);    // assert that we "patched the hole" by shifting the rest of the run back, leaving a contiguous span of two elements having the same hash value, with no nulls
+  assert_true(hash_table_slot_used(h, collision_index_1));
+  assert_int_eq(102, h->array[collision_index_1].value.number);
+  assert_false(hash_table_slot_used(h, collision_index_2));
+
+  maybe1 = hash_table_remove(h, 8);
+  assert_true(maybe1.exists);
+  assert_int_eq(1, h->size);
+  assert_int_eq(102, maybe1.unwrap.number);
+  assert_true(hash_table_slot_used(h, collision_index_0));
+  assert_int_eq(101, h->array[collision_index_0].value.number);    // nothing after it to shift back
+  assert_false(hash_table_slot_used(h, collision_index_1));
+  assert_false(hash_table_slot_used(h, collision_index_2));
+
+  maybe2 = hash_table_remove(h, 4);
+  assert_true(maybe2.exists);
+  assert_int_eq(0, h->size);
+  assert_int_eq(101, maybe2.unwrap.number);
+  assert_false(hash_table_slot_used(h, collision_index_0));
+  assert_false(hash_table_slot_used(h, collision_index_1));
+  assert_false(hash_table_slot_used(h, collision_index_2));
+}
+
+static void test_hash_table_load_factor() {
+  hash_table<unsigned char, note, 4> table;
+  hash_table<unsigned char, note, 4> *h = &table;
+  hash_table_initialize(h);
+  NOTE_FIXTURES;
+
+  hash_table_set(h, 0, note0);
+  hash_table_set(h, 4, note1);
+  hash_table_set(h, 8, note2);
+
+  maybe_hash_table_val<note> maybe0;
+  maybe_hash_table_val<note> maybe1;
+  maybe_hash_table_val<note> maybe2;
+  maybe_hash_table_val<note> maybe3;
+
+  assert_float_eq(3/4.0, hash_table_load_factor(h));
+
+  maybe0 = hash_table_remove(h, 0);
+  assert_true(maybe0.exists);
+  assert_float_eq(2/4.0, hash_table_load_factor(h));
+
+  maybe1 = hash_table_remove(h, 4);
+  assert_true(maybe1.exists);
+  assert_float_eq(1/4.0, hash_table_load_factor(h));
+
+  maybe2 = hash_table_remove(h, 8);
+  assert_true(maybe2.exists);
+  assert_float_eq(0.0, hash_table_load_factor(h));
+
+  maybe3 = hash_table_remove(h, 69); // shouldn't exist, shouldn't change load factor
+  assert_false(maybe3.exists);
+  assert_float_eq(0.0, hash_table_load_factor(h));
+}
+
+static void test_hash_table_remove_keeps_wrapped_chains() {
+  hash_table<unsigned char, note, 8> table;
+  hash_table<unsigned char, note, 8> *h = &table;
+  hash_table_initialize(h);
+  NOTE_FIXTURES;
+
+  hash_table_set(h, 7, note0);  // home 7, in slot 7
+  hash_table_set(h, 15, note1); // home 7, wraps to slot 0
+  hash_table_set(h, 0, note2);  // home 0, pushed to slot 1
+
+  // 15 is in 0's home slot. Removing it has to shift 0 back, or looking 0 up
+  // would stop at the hole
+  maybe_hash_table_val<note> removed = hash_table_remove(h, 15);
+  assert_true(removed.exists);
+  assert_int_eq(101, removed.unwrap.number);
+  assert_not_null(hash_table_get(h, 0));
+  assert_not_null(hash_table_get(h, 7));
+  assert_true(hash_table_slot_used(h, 0));
+  assert_false(hash_table_slot_used(h, 1));
+  assert_int_eq(1, hash_table_max_probe_length(h));
+
+  // and 0, at the start of the array, must not be shifted past its home
+  hash_table_set(h, 15, note1); // home 7, slot 1
+  hash_table_set(h, 23, note0); // home 7, slot 2
+  hash_table_remove(h, 7);
+  assert_not_null(hash_table_get(h, 15));
+  assert_not_null(hash_table_get(h, 23));
+  assert_true(hash_table_slot_used(h, 0));
+  assert_int_eq(0, h->array[0].key);
+  assert_not_null(hash_table_get(h, 0));
+  assert_int_eq(3, h->size);
+}
+
+static void test_hash_table_probe_lengths() {
+  hash_table<unsigned char, note, 8> table;
+  hash_table<unsigned char, note, 8> *h = &table;
+  hash_table_initialize(h);
+  NOTE_FIXTURES;
+
+  hash_table_set(h, 1, note0);  // home
+  hash_table_set(h, 9, note1);  // one over
+  hash_table_set(h, 17, note2); // two over
+  hash_table_set(h, 3, note0);  // home is taken by 17: two over too
+  hash_table_set(h, 6, note0);  // home
+
+  assert_int_eq(1, hash_table_probe_length(h, 1));
+  assert_int_eq(2, hash_table_probe_length(h, 2));
+  assert_int_eq(3, hash_table_probe_length(h, 3));
+  assert_int_eq(2, hash_table_probe_length(h, 4));
+  assert_int_eq(0, hash_table_probe_length(h, 0)); // empty
+  assert_int_eq(3, hash_table_max_probe_length(h));
+
+  unsigned int histogram[HASH_TABLE_PROBE_HISTOGRAM_SIZE];
+  hash_table_probe_histogram(h, histogram);
+  assert_int_eq(2, histogram[0]);
+  assert_int_eq(2, histogram[1]);
+  assert_int_eq(1, histogram[2]);
+  assert_int_eq(0, histogram[3]);
+
+  // counts every element that's not at home, wherever it is in the array
+  assert_float_eq(3 / 5.0, hash_table_collision_ratio(h));
+
+  printf("\n");
+  hash_table_inspect(h);
+}
+
+static void test_hash_table_probe_histogram_overflow_bucket() {
+  hash_table<unsigned char, note, 16> table;
+  hash_table<unsigned char, note, 16> *h = &table;
+  hash_table_initialize(h);
+  note n = { .number=100 };
+
+  for (unsigned int i = 0; i < 12; i++) {
+    hash_table_set(h, i * 16, n); // all home 0
+  }
+
+  unsigned int histogram[HASH_TABLE_PROBE_HISTOGRAM_SIZE];
+  hash_table_probe_histogram(h, histogram);
+  assert_int_eq(1, histogram[0]);
+  assert_int_eq(5, histogram[HASH_TABLE_PROBE_HISTOGRAM_SIZE - 1]); // 8, 9, 10, 11, 12
+  assert_int_eq(12, hash_table_max_probe_length(h));
+}
+
+// Randomized inserts and removes, checked after every step against a plain
+// array indexed by key. Covers tiny and larger tables, and full ones.
+template <unsigned int SIZE>
+static void assert_hash_table_matches_model(unsigned int key_range, unsigned int steps, unsigned int seed) {
+  static hash_table<unsigned char, note, SIZE> table;
+  hash_table<unsigned char, note, SIZE> *h = &table;
+  hash_table_initialize(h);
+  bool model_exists[256] = { false };
+  unsigned char model_value[256] = { 0 };
+  unsigned int model_size = 0;
+  unsigned int failures_before = TEST_FAILURE_COUNT;
+
+  srand(seed);
+
+  for (unsigned int step = 0; step < steps && TEST_FAILURE_COUNT == failures_before; step++) {
+    unsigned char key = rand() % key_range;
+
+    if (rand() % 3) { // lean towards inserts so the table fills up
+      note n = { .number=(unsigned char)(rand() % 128) };
+      note *set = hash_table_set(h, key, n);
+
+      if (model_exists[key] || model_size < SIZE) {
+        assert_not_null(set);
+        model_size += model_exists[key] ? 0 : 1;
+        model_exists[key] = true;
+        model_value[key] = n.number;
+      } else {
+        assert_null(set); // full
+      }
+    } else {
+      maybe_hash_table_val<note> removed = hash_table_remove(h, key);
+      bool matches_model = removed.exists == model_exists[key];
+      assert_true(matches_model);
+      if (model_exists[key]) {
+        assert_int_eq(model_value[key], removed.unwrap.number);
+        model_exists[key] = false;
+        model_size--;
+      }
+    }
+
+    assert_int_eq(model_size, h->size);
+    for (unsigned int k = 0; k < key_range; k++) {
+      note *found = hash_table_get(h, k);
+      if (model_exists[k]) {
+        assert_not_null(found);
+        if (found) {
+          assert_int_eq(model_value[k], found->number);
+        }
+      } else {
+        assert_null(found);
+      }
+    }
+
+    // no element sits further from home than the run it's in allows
+    bool probes_within_run = hash_table_max_probe_length(h) <= h->size;
+    assert_true(probes_within_run);
+  }
+}
+
+static void test_hash_table_empty_key_is_reserved() {
+  hash_table<unsigned char, note, 4> table;
+  hash_table<unsigned char, note, 4> *h = &table;
+  hash_table_initialize(h);
+  NOTE_FIXTURES;
+
+  assert_int_eq(255, h->empty_key);
+  for (unsigned int i = 0; i < h->max_size; i++) {
+    assert_false(hash_table_slot_used(h, i));
+  }
+
+  assert_null(hash_table_set(h, 255, note0)); // would look like a free slot
+  assert_int_eq(0, h->size);
+  assert_null(hash_table_get(h, 255));
+
+  note *set = hash_table_set(h, 254, note1);
+  assert_not_null(set);
+  assert_true(hash_table_slot_used(h, 2));
+  assert_int_eq(2, hash_table_slot_of(h, set));
+
+  set = hash_table_set(h, 253, note2);
+  assert_not_null(set);
+  assert_int_eq(1, hash_table_slot_of(h, set));
+  assert_int_eq(2, h->size);
+}
+
+static void test_hash_table_stress() {
+  assert_hash_table_matches_model<2>(5, 500, 1);
+  assert_hash_table_matches_model<4>(10, 500, 1);
+  assert_hash_table_matches_model<8>(50, 2000, 2);
+  assert_hash_table_matches_model<16>(40, 5000, 3);
+  assert_hash_table_matches_model<16>(255, 5000, 4);
+  assert_hash_table_matches_model<16>(32, 5000, 5); // every home slot shared by exactly two keys
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_hash_table_initialize();
+  test_hash_table_get_set();
+  test_hash_table_remove();
+  test_hash_table_load_factor();
+  test_hash_table_remove_keeps_wrapped_chains();
+  test_hash_table_probe_lengths();
+  test_hash_table_probe_histogram_overflow_bucket();
+  test_hash_table_empty_key_is_reserved();
+  test_hash_table_stress();
+
+  printf("\n");
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,74 @@
+#include "test_helper.h"
+#include "../src/midi_cc_coalescer.h"
+
+static void test_midi_cc_coalescer_latest_wins() {
+  midi_cc_coalescer c;
+  midi_cc_coalescer_initialize(&c);
+
+  // a cutoff sweep and a pulse width sweep, interleaved
+  for (word value = 0; value < 100; value++) {
+    midi_cc_coalescer_add(&c, 36, value * 10);
+    midi_cc_coalescer_add(&c, 44, value * 20);
+  }
+
+  assert_int_eq(2, c.length);
+  assert_int_eq(36, c.numbers[0]);
+  assert_int_eq(990, c.values[0]);
+  assert_int_eq(44, c.numbers[1]);
+  assert_int_eq(1980, c.values[1]);
+  assert_long_eq(198UL, (unsigned long)c.merged);
+
+  midi_cc_coalescer_clear(&c);
+  assert_int_eq(0, c.length);
+  assert_long_eq(198UL, (unsigned long)c.merged);
+}
+
+static void test_midi_cc_coalescer_first_arrival_order() {
+  midi_cc_coalescer c;
+  midi_cc_coalescer_initialize(&c);
+
+  midi_cc_coalescer_add(&c, 39, 1);
+  midi_cc_coalescer_add(&c, 40, 2);
+  midi_cc_coalescer_add(&c, 39, 3);
+  midi_cc_coalescer_add(&c, 41, 4);
+
+  assert_int_eq(3, c.length);
+  assert_int_eq(39, c.numbers[0]);
+  assert_int_eq(3, c.values[0]);
+  assert_int_eq(40, c.numbers[1]);
+  assert_int_eq(41, c.numbers[2]);
+}
+
+static void test_midi_cc_coalescer_full() {
+  midi_cc_coalescer c;
+  midi_cc_coalescer_initialize(&c);
+
+  for (byte i = 0; i < MIDI_CC_COALESCER_SIZE; i++) {
+    bool added = midi_cc_coalescer_add(&c, i, i);
+    assert_true(added);
+  }
+
+  // a new CC doesn't fit, but a pending one can still be replaced
+  bool added = midi_cc_coalescer_add(&c, 100, 1);
+  assert_false(added);
+  added = midi_cc_coalescer_add(&c, 0, 1000);
+  assert_true(added);
+  assert_int_eq(1000, c.values[0]);
+  assert_int_eq(MIDI_CC_COALESCER_SIZE, c.length);
+
+  midi_cc_coalescer_clear(&c);
+  added = midi_cc_coalescer_add(&c, 100, 1);
+  assert_true(added);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_midi_cc_coalescer_latest_wins();
+  test_midi_cc_coalescer_first_arrival_order();
+  test_midi_cc_coalescer_full();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,237 @@
+// the table is built with constexpr, so this runner is built with clang++
+#include "test_helper.h"
+#include "../src/midi_cc_table.h"
+
+void sid_bus_drain_start() { return; };
+
+static void assert_cc(byte number, byte kind, byte voice, byte bits, byte argument) {
+  midi_cc cc = midi_cc_lookup(number);
+  assert_int_eq(kind, cc.kind);
+  assert_int_eq(voice, cc.voice);
+  assert_int_eq(bits, cc.bits);
+  assert_int_eq(argument, cc.argument);
+}
+
+static void test_midi_cc_lookup() {
+  assert_cc(MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_TRIANGLE, MIDI_CC_WAVEFORM, 0, 1, SID_TRIANGLE >> 4);
+  assert_cc(MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_TWO_SQUARE, MIDI_CC_WAVEFORM, 1, 1, SID_SQUARE >> 4);
+  assert_cc(MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_THREE_NOISE, MIDI_CC_WAVEFORM, 2, 1, SID_NOISE >> 4);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_RING_MOD_VOICE_TWO, MIDI_CC_RING_MOD, 1, 1, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_THREE, MIDI_CC_SYNC, 2, 1, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_TEST_VOICE_ONE, MIDI_CC_TEST, 0, 1, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_THREE, MIDI_CC_VOICE_FILTER, 2, 1, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_ONE, MIDI_CC_ATTACK, 0, 4, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_TWO, MIDI_CC_DECAY, 1, 4, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_THREE, MIDI_CC_SUSTAIN, 2, 4, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_ONE, MIDI_CC_RELEASE, 0, 4, 0);
+
+  assert_cc(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_TWO, MIDI_CC_PULSE_WIDTH, 1, 12, MIDI_CC_SLOT_PULSE_WIDTH + 1);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_TWO, MIDI_CC_LSB, 1, 12, MIDI_CC_SLOT_PULSE_WIDTH + 1);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_THREE, MIDI_CC_DETUNE, 2, 14, MIDI_CC_SLOT_DETUNE + 2);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_THREE, MIDI_CC_LSB, 2, 14, MIDI_CC_SLOT_DETUNE + 2);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY, MIDI_CC_FILTER_FREQUENCY, 0, 11, MIDI_CC_SLOT_FILTER_FREQUENCY);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_GLIDE_TIME_LSB, MIDI_CC_LSB, 0, 14, MIDI_CC_SLOT_GLIDE_TIME);
+
+  assert_cc(MIDI_CONTROL_CHANGE_TOGGLE_FILTER_MODE_BP, MIDI_CC_FILTER_MODE, 0, 1, SID_FILTER_BP >> 4);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_FILTER_RESONANCE, MIDI_CC_FILTER_RESONANCE, 0, 7, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_SET_VOLUME, MIDI_CC_VOLUME, 0, 4, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_STATE_DUMP, MIDI_CC_STATE_DUMP, 0, 7, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_ALL_SOUND_OFF, MIDI_CC_ALL_SOUND_OFF, 0, 7, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_RESET_ALL_CONTROLLERS, MIDI_CC_RESET_ALL_CONTROLLERS, 0, 7, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_ALL_NOTES_OFF, MIDI_CC_ALL_NOTES_OFF, 0, 7, 0);
+
+  // defined, but not implemented
+  assert_cc(MIDI_CONTROL_CHANGE_SET_FILTER_VOICE_THREE_OFF, MIDI_CC_NONE, 0, 0, 0);
+  assert_cc(MIDI_CONTROL_CHANGE_DATA_ENTRY_FINE, MIDI_CC_NONE, 0, 0, 0);
+  assert_cc(0, MIDI_CC_NONE, 0, 0, 0);
+
+  unsigned int implemented = 0;
+  for (unsigned int number = 0; number < 128; number++) {
+    implemented += midi_cc_lookup(number).kind != MIDI_CC_NONE;
+  }
+  assert_int_eq(67, implemented);
+  assert_int_eq(256, (int)sizeof(midi_cc_table_P.entries));
+}
+
+static void test_midi_cc_decode() {
+  byte slots[MIDI_CC_SLOTS] = { 0 };
+  word decoded = 0;
+  midi_cc cc;
+
+  // 1-bit: only 127 is on
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_SYNC_VOICE_ONE);
+  bool applies = midi_cc_decode(&cc, 127, slots, &decoded);
+  assert_true(applies);
+  assert_int_eq(1, decoded);
+  midi_cc_decode(&cc, 126, slots, &decoded);
+  assert_int_eq(0, decoded);
+
+  // 4-bit: the top 4 bits
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_TWO);
+  midi_cc_decode(&cc, 127, slots, &decoded);
+  assert_int_eq(15, decoded);
+  midi_cc_decode(&cc, 8, slots, &decoded);
+  assert_int_eq(1, decoded);
+
+  // 7-bit: as is
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_FILTER_RESONANCE);
+  midi_cc_decode(&cc, 100, slots, &decoded);
+  assert_int_eq(100, decoded);
+
+  // unused CCs don't apply
+  cc = midi_cc_lookup(1);
+  applies = midi_cc_decode(&cc, 127, slots, &decoded);
+  assert_false(applies);
+}
+
+static void test_midi_cc_decode_pairs() {
+  byte slots[MIDI_CC_SLOTS] = { 0 };
+  word decoded = 0;
+  midi_cc cc;
+
+  // the LSB is stored, and doesn't apply anything
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_THREE);
+  bool applies = midi_cc_decode(&cc, 0x7F, slots, &decoded);
+  assert_false(applies);
+  assert_int_eq(0x7F, slots[MIDI_CC_SLOT_PULSE_WIDTH + 2]);
+
+  // pulse width: 7 bits of MSB, 5 of LSB
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_THREE);
+  applies = midi_cc_decode(&cc, 0x7F, slots, &decoded);
+  assert_true(applies);
+  assert_int_eq(4095, decoded);
+  midi_cc_decode(&cc, 64, slots, &decoded);
+  assert_int_eq(2079, decoded); // 64 << 5 | 0x1F
+
+  // other voices' slots are separate
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_ONE);
+  midi_cc_decode(&cc, 64, slots, &decoded);
+  assert_int_eq(2048, decoded);
+
+  // detune: 14 bits
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_DETUNE_LSB_VOICE_TWO);
+  midi_cc_decode(&cc, 1, slots, &decoded);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_DETUNE_VOICE_TWO);
+  midi_cc_decode(&cc, 64, slots, &decoded);
+  assert_int_eq(8193, decoded);
+
+  // filter frequency: 11 bits, so 4 of LSB
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY_LSB);
+  midi_cc_decode(&cc, 0x7F, slots, &decoded);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY);
+  midi_cc_decode(&cc, 0x7F, slots, &decoded);
+  assert_int_eq(2047, decoded);
+
+  // glide time
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_GLIDE_TIME_LSB);
+  midi_cc_decode(&cc, 0x7F, slots, &decoded);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_GLIDE_TIME);
+  midi_cc_decode(&cc, 0x7F, slots, &decoded);
+  assert_int_eq(16383, decoded);
+}
+
+static void test_midi_cc_continuous() {
+  midi_cc cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY);
+  bool continuous = midi_cc_continuous(&cc);
+  assert_true(continuous);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_TWO);
+  continuous = midi_cc_continuous(&cc);
+  assert_true(continuous);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_THREE);
+  continuous = midi_cc_continuous(&cc);
+  assert_true(continuous);
+
+  // toggles, modes and LSBs keep their order
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_SQUARE);
+  continuous = midi_cc_continuous(&cc);
+  assert_false(continuous);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_TWO);
+  continuous = midi_cc_continuous(&cc);
+  assert_false(continuous);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_DATA_ENTRY);
+  continuous = midi_cc_continuous(&cc);
+  assert_false(continuous);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_STATE_DUMP);
+  continuous = midi_cc_continuous(&cc);
+  assert_false(continuous);
+  cc = midi_cc_lookup(MIDI_CONTROL_CHANGE_ALL_NOTES_OFF);
+  continuous = midi_cc_continuous(&cc);
+  assert_false(continuous);
+}
+
+// CC `number`, through `midi_cc_coalesce()` as SID.ino's MIDI input does it
+static byte coalesce(byte number, byte value, byte *slots, midi_cc_coalescer *pending) {
+  midi_cc cc = midi_cc_lookup(number);
+  return midi_cc_coalesce(&cc, number, value, slots, pending);
+}
+
+static void test_midi_cc_coalesce_pairs() {
+  byte slots[MIDI_CC_SLOTS] = { 0 };
+  midi_cc_coalescer pending;
+  midi_cc_coalescer_initialize(&pending);
+
+  // pulse width and filter cutoff automation, LSB then MSB, interleaved
+  for (byte i = 0; i < 50; i++) {
+    assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_ONE, i, slots, &pending));
+    assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY_LSB, i + 1, slots, &pending));
+    assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_ONE, i + 10, slots, &pending));
+    assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY, i + 20, slots, &pending));
+  }
+
+  // only the last value of each is left to apply, with the LSB it was sent with
+  assert_int_eq(2, pending.length);
+  assert_int_eq(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_ONE, pending.numbers[0]);
+  assert_int_eq(1905, pending.values[0]); // 59 << 5 | 49 & 0x1F
+  assert_int_eq(MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY, pending.numbers[1]);
+  assert_int_eq(1106, pending.values[1]); // 69 << 4 | 50 & 0x0F
+  assert_long_eq(98UL, (unsigned long)pending.merged);
+
+  // an LSB after its MSB doesn't change the pending value, just the next one's
+  coalesce(MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_LSB_VOICE_ONE, 0x1F, slots, &pending);
+  assert_int_eq(1905, pending.values[0]); // 59 << 5 | 49 & 0x1F
+  assert_int_eq(0x1F, slots[MIDI_CC_SLOT_PULSE_WIDTH]);
+  assert_int_eq(2, pending.length);
+
+  // toggles stay in order, and pending isn't touched
+  assert_int_eq(MIDI_CC_COALESCE_IN_ORDER, coalesce(MIDI_CONTROL_CHANGE_TOGGLE_WAVEFORM_VOICE_ONE_SQUARE, 127, slots, &pending));
+  assert_int_eq(2, pending.length);
+}
+
+static void test_midi_cc_coalesce_full() {
+  byte slots[MIDI_CC_SLOTS] = { 0 };
+  midi_cc_coalescer pending;
+  midi_cc_coalescer_initialize(&pending);
+
+  byte numbers[] = {
+    MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_TWO,
+    MIDI_CONTROL_CHANGE_SET_PULSE_WIDTH_VOICE_THREE, MIDI_CONTROL_CHANGE_SET_ATTACK_VOICE_ONE,
+    MIDI_CONTROL_CHANGE_SET_DECAY_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_SUSTAIN_VOICE_ONE,
+    MIDI_CONTROL_CHANGE_SET_RELEASE_VOICE_ONE, MIDI_CONTROL_CHANGE_SET_FILTER_FREQUENCY,
+  };
+  for (byte i = 0; i < MIDI_CC_COALESCER_SIZE; i++) {
+    assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(numbers[i], 64, slots, &pending));
+  }
+
+  // a new continuous CC doesn't fit, but an LSB is only stored, so it does
+  assert_int_eq(MIDI_CC_COALESCE_FULL, coalesce(MIDI_CONTROL_CHANGE_SET_FILTER_RESONANCE, 64, slots, &pending));
+  assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(MIDI_CONTROL_CHANGE_SET_GLIDE_TIME_LSB, 5, slots, &pending));
+  assert_int_eq(5, slots[MIDI_CC_SLOT_GLIDE_TIME]);
+
+  midi_cc_coalescer_clear(&pending);
+  assert_int_eq(MIDI_CC_COALESCE_HELD, coalesce(MIDI_CONTROL_CHANGE_SET_FILTER_RESONANCE, 64, slots, &pending));
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_midi_cc_lookup();
+  test_midi_cc_decode();
+  test_midi_cc_decode_pairs();
+  test_midi_cc_continuous();
+  test_midi_cc_coalesce_pairs();
+  test_midi_cc_coalesce_full();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
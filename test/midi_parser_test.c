@@ -0,0 +1,207 @@
+#include "test_helper.h"
+#include "../src/midi_constants.h"
+#include "../src/midi_parser.h"
+
+#define MAX_EVENTS 16
+
+// every event `length` bytes of `bytes` make, fed to `p` `chunk` bytes at a
+// time (the way they'd trickle in from a serial port)
+static byte feed(midi_parser *p, const byte *bytes, byte length, byte chunk, midi_event *events) {
+  byte count = 0;
+
+  for (byte start = 0; start < length; start += chunk) {
+    for (byte i = start; i < start + chunk && i < length; i++) {
+      if (midi_parser_feed(p, bytes[i], &events[count]) && count < MAX_EVENTS - 1) {
+        count++;
+      }
+    }
+  }
+
+  return count;
+}
+
+static void assert_event(const midi_event *event, byte status, byte data_one, byte data_two) {
+  assert_int_eq(status, event->status);
+  assert_int_eq(data_one, event->data_one);
+  assert_int_eq(data_two, event->data_two);
+}
+
+static void test_midi_parser_complete_messages() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  byte bytes[] = { 0x90, 60, 100, 0xB0, 7, 127, 0xC0, 3, 0xE0, 0x00, 0x40, 0x80, 60, 0 };
+  assert_int_eq(5, feed(&p, bytes, sizeof(bytes), sizeof(bytes), events));
+  assert_event(&events[0], 0x90, 60, 100);
+  assert_event(&events[1], 0xB0, 7, 127);
+  assert_event(&events[2], 0xC0, 3, 0);
+  assert_event(&events[3], 0xE0, 0x00, 0x40);
+  assert_event(&events[4], 0x80, 60, 0);
+
+  assert_int_eq(MIDI_NOTE_ON, midi_event_opcode(&events[0]));
+  assert_int_eq(0, midi_event_channel(&events[0]));
+}
+
+static void test_midi_parser_fragmented() {
+  byte bytes[] = { 0x91, 60, 100, 0xB1, 74, 64, 0xC1, 5, 0x81, 60, 64 };
+  midi_event events[MAX_EVENTS];
+
+  // the same messages however they're split up
+  for (byte chunk = 1; chunk <= sizeof(bytes); chunk++) {
+    midi_parser p;
+    midi_parser_initialize(&p);
+
+    assert_int_eq(4, feed(&p, bytes, sizeof(bytes), chunk, events));
+    assert_event(&events[0], 0x91, 60, 100);
+    assert_event(&events[1], 0xB1, 74, 64);
+    assert_event(&events[2], 0xC1, 5, 0);
+    assert_event(&events[3], 0x81, 60, 64);
+    assert_int_eq(1, midi_event_channel(&events[3]));
+  }
+
+  // nothing comes out until the last byte of a message is in
+  midi_parser p;
+  midi_event event = { 0, 0, 0 };
+  midi_parser_initialize(&p);
+  bool done = midi_parser_feed(&p, 0x90, &event);
+  assert_false(done);
+  done = midi_parser_feed(&p, 60, &event);
+  assert_false(done);
+  assert_int_eq(0, event.status);
+  done = midi_parser_feed(&p, 100, &event);
+  assert_true(done);
+  assert_event(&event, 0x90, 60, 100);
+}
+
+static void test_midi_parser_running_status() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  // a chord on and off, the offs as note ons at velocity 0
+  byte notes[] = { 0x90, 60, 100, 64, 100, 67, 100, 60, 0, 64, 0, 67, 0 };
+  assert_int_eq(6, feed(&p, notes, sizeof(notes), 1, events));
+  assert_event(&events[0], 0x90, 60, 100);
+  assert_event(&events[2], 0x90, 67, 100);
+  assert_event(&events[5], 0x90, 67, 0);
+
+  // one-byte messages run too
+  byte programs[] = { 0xC0, 1, 2, 3 };
+  assert_int_eq(3, feed(&p, programs, sizeof(programs), 1, events));
+  assert_event(&events[2], 0xC0, 3, 0);
+
+  // a new status byte replaces it, and a half-finished message is dropped
+  byte sweep[] = { 0xB0, 74, 0xB0, 71, 10, 71, 20 };
+  assert_int_eq(2, feed(&p, sweep, sizeof(sweep), 2, events));
+  assert_event(&events[0], 0xB0, 71, 10);
+  assert_event(&events[1], 0xB0, 71, 20);
+}
+
+static void test_midi_parser_real_time() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  // clocks between every byte, and in the middle of running status
+  byte bytes[] = {
+    MIDI_TIMING_CLOCK, 0x90, MIDI_TIMING_CLOCK, 60, MIDI_TIMING_CLOCK, 100,
+    0xFA, 62, MIDI_TIMING_CLOCK, 100, 0xFE
+  };
+  assert_int_eq(8, feed(&p, bytes, sizeof(bytes), 3, events));
+  assert_event(&events[0], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[1], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[2], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[3], 0x90, 60, 100);
+  assert_event(&events[4], 0xFA, 0, 0); // start
+  assert_event(&events[5], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[6], 0x90, 62, 100);
+  assert_event(&events[7], 0xFE, 0, 0); // active sensing
+}
+
+static void test_midi_parser_system_messages() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  // SysEx is skipped, and ends running status
+  byte sysex[] = { 0x90, 60, 100, 0xF0, 0x7D, 0x01, 0x02, 0x03, 0xF7, 62, 100, 0x90, 64, 100 };
+  assert_int_eq(2, feed(&p, sysex, sizeof(sysex), 4, events));
+  assert_event(&events[0], 0x90, 60, 100);
+  assert_event(&events[1], 0x90, 64, 100);
+
+  // real time bytes inside SysEx still come through
+  byte clocked[] = { 0xF0, 0x7D, MIDI_TIMING_CLOCK, 0x01, 0xF7 };
+  assert_int_eq(1, feed(&p, clocked, sizeof(clocked), 1, events));
+  assert_event(&events[0], MIDI_TIMING_CLOCK, 0, 0);
+
+  // system common messages, which don't run
+  byte common[] = { 0xF2, 0x10, 0x20, 0x30, 0xF3, 5, 6, 0xF6, 0xB0, 1, 2 };
+  assert_int_eq(4, feed(&p, common, sizeof(common), 1, events));
+  assert_event(&events[0], 0xF2, 0x10, 0x20);
+  assert_event(&events[1], 0xF3, 5, 0);
+  assert_event(&events[2], 0xF6, 0, 0);
+  assert_event(&events[3], 0xB0, 1, 2);
+}
+
+static void test_midi_parser_stray_data() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  // switched on halfway through a message
+  byte bytes[] = { 100, 62, 0x80, 62, 0 };
+  assert_int_eq(1, feed(&p, bytes, sizeof(bytes), 1, events));
+  assert_event(&events[0], 0x80, 62, 0);
+}
+
+static void test_midi_parser_sysex_buffer() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  byte buffer[4];
+  midi_parser_initialize(&p);
+  midi_parser_set_sysex_buffer(&p, buffer, sizeof(buffer));
+
+  // collected, with a clock in the middle, then running status is gone
+  byte bytes[] = { 0x90, 60, 100, 0xF0, 0x7D, MIDI_TIMING_CLOCK, 0x02, 0xF7, 61, 100 };
+  assert_int_eq(3, feed(&p, bytes, sizeof(bytes), 1, events));
+  assert_event(&events[0], 0x90, 60, 100);
+  assert_event(&events[1], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[2], 0xF0, 2, 0);
+  assert_int_eq(0x7D, buffer[0]);
+  assert_int_eq(0x02, buffer[1]);
+  bool pending = p.sysex_pending;
+  assert_true(pending);
+
+  midi_parser_release_sysex(&p);
+  pending = p.sysex_pending;
+  assert_false(pending);
+
+  // too long for the buffer: dropped, and the next one still fits
+  byte too_long[] = { 0xF0, 1, 2, 3, 4, 5, 0xF7, 0xF0, 0x7D, 0xF7 };
+  assert_int_eq(1, feed(&p, too_long, sizeof(too_long), 1, events));
+  assert_event(&events[0], 0xF0, 1, 0);
+  assert_int_eq(0x7D, buffer[0]);
+
+  // cut short by another status byte: dropped too
+  midi_parser_release_sysex(&p);
+  byte interrupted[] = { 0xF0, 0x7D, 1, 0x80, 60, 0 };
+  assert_int_eq(1, feed(&p, interrupted, sizeof(interrupted), 1, events));
+  assert_event(&events[0], 0x80, 60, 0);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_midi_parser_complete_messages();
+  test_midi_parser_fragmented();
+  test_midi_parser_running_status();
+  test_midi_parser_real_time();
+  test_midi_parser_system_messages();
+  test_midi_parser_stray_data();
+  test_midi_parser_sysex_buffer();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
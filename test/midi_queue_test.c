@@ -0,0 +1,131 @@
+#include "test_helper.h"
+#include "../src/midi_queue.h"
+
+static midi_event note_on(byte note) {
+  midi_event event = { 0x90, note, 100 };
+  return event;
+}
+
+static void test_midi_queue_single_port() {
+  midi_queue q;
+  midi_event event = note_on(0);
+  midi_queue_empty(&q);
+
+  bool popped = midi_queue_pop(&q, 0, &event);
+  assert_false(popped);
+  assert_int_eq(0, midi_queue_depth(&q));
+
+  // in order, and full at MIDI_QUEUE_SIZE - 1
+  for (byte i = 0; i < MIDI_QUEUE_SIZE - 1; i++) {
+    midi_event pushed = note_on(60 + i);
+    bool ok = midi_queue_push(&q, 0, &pushed, i);
+    assert_true(ok);
+  }
+  bool full = midi_queue_full(&q, 0);
+  assert_true(full);
+  full = midi_queue_full(&q, 1);
+  assert_false(full);
+  midi_event extra = note_on(100);
+  bool pushed = midi_queue_push(&q, 0, &extra, 10);
+  assert_false(pushed);
+  assert_int_eq(MIDI_QUEUE_SIZE - 1, midi_queue_depth(&q));
+
+  for (byte i = 0; i < MIDI_QUEUE_SIZE - 1; i++) {
+    popped = midi_queue_pop(&q, 100, &event);
+    assert_true(popped);
+    assert_int_eq(60 + i, event.data_one);
+  }
+  popped = midi_queue_pop(&q, 100, &event);
+  assert_false(popped);
+}
+
+static void test_midi_queue_merges_by_arrival() {
+  midi_queue q;
+  midi_event event = note_on(0);
+  midi_queue_empty(&q);
+
+  // USB (0) at 10, 30 and 50; DIN (1) at 20 and 40
+  midi_event usb[] = { note_on(1), note_on(3), note_on(5) };
+  midi_event din[] = { note_on(2), note_on(4) };
+  midi_queue_push(&q, 0, &usb[0], 10);
+  midi_queue_push(&q, 0, &usb[1], 30);
+  midi_queue_push(&q, 0, &usb[2], 50);
+  midi_queue_push(&q, 1, &din[0], 20);
+  midi_queue_push(&q, 1, &din[1], 40);
+  assert_int_eq(5, midi_queue_depth(&q));
+
+  for (byte i = 1; i <= 5; i++) {
+    midi_queue_pop(&q, 60, &event);
+    assert_int_eq(i, event.data_one);
+  }
+
+  // wraparound: 65530 is before 4
+  midi_event before = note_on(6);
+  midi_event after = note_on(7);
+  midi_queue_push(&q, 0, &after, 4);
+  midi_queue_push(&q, 1, &before, 65530);
+  midi_queue_pop(&q, 10, &event);
+  assert_int_eq(6, event.data_one);
+  midi_queue_pop(&q, 10, &event);
+  assert_int_eq(7, event.data_one);
+}
+
+static void test_midi_queue_ties_alternate() {
+  midi_queue q;
+  midi_event event = note_on(0);
+  midi_queue_empty(&q);
+
+  // both ports read in the same pass: same timestamp
+  for (byte i = 0; i < 3; i++) {
+    midi_event usb = note_on(10 + i);
+    midi_event din = note_on(20 + i);
+    midi_queue_push(&q, 0, &usb, 0);
+    midi_queue_push(&q, 1, &din, 0);
+  }
+
+  byte expected[] = { 10, 20, 11, 21, 12, 22 };
+  for (byte i = 0; i < 6; i++) {
+    midi_queue_pop(&q, 0, &event);
+    assert_int_eq(expected[i], event.data_one);
+  }
+}
+
+static void test_midi_queue_stats() {
+  midi_queue q;
+  midi_event event = note_on(0);
+  midi_queue_empty(&q);
+
+  midi_event a = note_on(1);
+  midi_event b = note_on(2);
+  midi_event c = note_on(3);
+  midi_queue_push(&q, 0, &a, 1000);
+  midi_queue_push(&q, 1, &b, 1100);
+  midi_queue_push(&q, 1, &c, 1200);
+  assert_int_eq(3, q.max_depth);
+
+  midi_queue_pop(&q, 1300, &event); // waited 300
+  midi_queue_pop(&q, 1300, &event); // 200
+  midi_queue_pop(&q, 1300, &event); // 100
+  assert_int_eq(300, q.max_latency);
+  assert_int_eq(200, midi_queue_mean_latency(&q));
+  assert_int_eq(3, q.max_depth);
+  assert_int_eq(0, midi_queue_depth(&q));
+
+  midi_queue_reset_stats(&q);
+  assert_int_eq(0, q.max_depth);
+  assert_int_eq(0, q.max_latency);
+  assert_int_eq(0, midi_queue_mean_latency(&q));
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_midi_queue_single_port();
+  test_midi_queue_merges_by_arrival();
+  test_midi_queue_ties_alternate();
+  test_midi_queue_stats();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,88 @@
+#include "test_helper.h"
+#include "../src/note_priority.h"
+
+static void hold(note_table *t, const byte *notes, byte length) {
+  note_table_empty(t);
+  for (byte i = 0; i < length; i++) {
+    note_table_append(t, notes[i]);
+  }
+}
+
+static void test_note_priority_select() {
+  note_table t;
+  note_table_empty(&t);
+
+  assert_int_eq(NOTE_TABLE_NONE, note_priority_select(&t, NOTE_PRIORITY_LAST));
+  assert_int_eq(NOTE_TABLE_NONE, note_priority_select(&t, NOTE_PRIORITY_LOWEST));
+  assert_int_eq(NOTE_TABLE_NONE, note_priority_select(&t, NOTE_PRIORITY_HIGHEST));
+
+  byte chord[] = { 60, 36, 72, 48 };
+  hold(&t, chord, 4);
+
+  assert_int_eq(48, note_priority_select(&t, NOTE_PRIORITY_LAST));
+  assert_int_eq(36, note_priority_select(&t, NOTE_PRIORITY_LOWEST));
+  assert_int_eq(72, note_priority_select(&t, NOTE_PRIORITY_HIGHEST));
+}
+
+static void test_note_priority_select_without() {
+  note_table t;
+  byte chord[] = { 60, 36, 72, 48 };
+  hold(&t, chord, 4);
+
+  // releasing the sounding note hands over to the next one in line
+  assert_int_eq(72, note_priority_select_without(&t, NOTE_PRIORITY_LAST, 48));
+  assert_int_eq(48, note_priority_select_without(&t, NOTE_PRIORITY_LOWEST, 36));
+  assert_int_eq(60, note_priority_select_without(&t, NOTE_PRIORITY_HIGHEST, 72));
+
+  // releasing any other note changes nothing
+  assert_int_eq(48, note_priority_select_without(&t, NOTE_PRIORITY_LAST, 60));
+  assert_int_eq(36, note_priority_select_without(&t, NOTE_PRIORITY_LOWEST, 72));
+  assert_int_eq(72, note_priority_select_without(&t, NOTE_PRIORITY_HIGHEST, 36));
+
+  // works the same after the release has been removed from the table
+  note_table_remove(&t, 36);
+  assert_int_eq(48, note_priority_select_without(&t, NOTE_PRIORITY_LOWEST, 36));
+
+  // and at the ends of the keyboard
+  byte extremes[] = { 0, 127 };
+  hold(&t, extremes, 2);
+  assert_int_eq(127, note_priority_select_without(&t, NOTE_PRIORITY_LOWEST, 0));
+  assert_int_eq(0, note_priority_select_without(&t, NOTE_PRIORITY_HIGHEST, 127));
+  byte lone[] = { 0 };
+  hold(&t, lone, 1);
+  assert_int_eq(NOTE_TABLE_NONE, note_priority_select_without(&t, NOTE_PRIORITY_LAST, 0));
+  assert_int_eq(NOTE_TABLE_NONE, note_priority_select_without(&t, NOTE_PRIORITY_LOWEST, 0));
+  assert_int_eq(NOTE_TABLE_NONE, note_priority_select_without(&t, NOTE_PRIORITY_HIGHEST, 0));
+}
+
+static void test_note_priority_trill() {
+  note_table t;
+  note_table_empty(&t);
+
+  // a bass line: the root held, a trill above it. Lowest priority never
+  // leaves the root; highest follows the trill; last follows every strike.
+  note_table_append(&t, 36);
+  for (byte i = 0; i < 32; i++) {
+    byte struck = i & 1 ? 43 : 41;
+    byte released = i & 1 ? 41 : 43;
+
+    note_table_append(&t, struck);
+    assert_int_eq(36, note_priority_select(&t, NOTE_PRIORITY_LOWEST));
+    assert_int_eq(struck, note_priority_select(&t, NOTE_PRIORITY_LAST));
+    note_table_remove(&t, released);
+    assert_int_eq(struck, note_priority_select(&t, NOTE_PRIORITY_HIGHEST));
+  }
+  assert_int_eq(2, t.length);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_note_priority_select();
+  test_note_priority_select_without();
+  test_note_priority_trill();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,296 @@
+#include <stddef.h>
+#include "test_helper.h"
+#include "../src/note_table.h"
+
+static void assert_order(const note_table *t, const byte *expected, byte length) {
+  assert_int_eq(length, t->length);
+
+  // traversing forward
+  byte n = note_table_first(t);
+  for (byte i = 0; i < length; i++) {
+    assert_int_eq(expected[i], n);
+    n = note_table_next(t, n);
+  }
+  assert_int_eq(NOTE_TABLE_NONE, n);
+
+  // traversing backward
+  n = note_table_last(t);
+  for (byte i = length; i > 0; i--) {
+    assert_int_eq(expected[i - 1], n);
+    n = note_table_previous(t, n);
+  }
+  assert_int_eq(NOTE_TABLE_NONE, n);
+}
+
+static void test_note_table_empty() {
+  note_table t;
+  note_table_empty(&t);
+
+  assert_int_eq(0, t.length);
+  assert_int_eq(NOTE_TABLE_NONE, note_table_first(&t));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_last(&t));
+  for (unsigned int n = 0; n < 256; n++) {
+    assert_false(note_table_contains(&t, n));
+  }
+
+  note_table_append(&t, 100);
+  note_table_append(&t, 101);
+  note_table_empty(&t);
+  assert_int_eq(0, t.length);
+  assert_false(note_table_contains(&t, 100));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_first(&t));
+}
+
+static void test_note_table_append() {
+  note_table t;
+  note_table_empty(&t);
+
+  note_table_append(&t, 100);
+  assert_int_eq(100, note_table_first(&t));
+  assert_int_eq(100, note_table_last(&t));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_next(&t, 100));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_previous(&t, 100));
+
+  note_table_append(&t, 101);
+  note_table_append(&t, 102);
+  byte in_order[] = { 100, 101, 102 };
+  assert_order(&t, in_order, 3);
+
+  note_table_append(&t, 102); // already the newest: nothing changes
+  assert_order(&t, in_order, 3);
+
+  note_table_append(&t, 100); // held again: moves to the back, not duplicated
+  byte moved[] = { 101, 102, 100 };
+  assert_order(&t, moved, 3);
+
+  fprintf(stdout, "\n");
+  note_table_inspect(&t, stdout);
+}
+
+static void test_note_table_prepend() {
+  note_table t;
+  note_table_empty(&t);
+
+  note_table_prepend(&t, 102);
+  assert_int_eq(102, note_table_first(&t));
+  assert_int_eq(102, note_table_last(&t));
+
+  note_table_prepend(&t, 101);
+  note_table_prepend(&t, 100);
+  byte in_order[] = { 100, 101, 102 };
+  assert_order(&t, in_order, 3);
+
+  note_table_prepend(&t, 100); // already the oldest: nothing changes
+  assert_order(&t, in_order, 3);
+
+  note_table_prepend(&t, 102);
+  byte moved[] = { 102, 100, 101 };
+  assert_order(&t, moved, 3);
+
+  fprintf(stdout, "\n");
+  note_table_inspect(&t, stdout);
+}
+
+static void test_note_table_remove_first() {
+  note_table t;
+  note_table_empty(&t);
+  note_table_append(&t, 100);
+  note_table_append(&t, 101);
+  note_table_append(&t, 102);
+
+  assert_int_eq(100, note_table_remove_first(&t));
+  assert_int_eq(101, note_table_first(&t));
+  assert_false(note_table_contains(&t, 100));
+  assert_int_eq(2, t.length);
+
+  assert_int_eq(101, note_table_remove_first(&t));
+  assert_int_eq(102, note_table_first(&t));
+  assert_int_eq(1, t.length);
+
+  assert_int_eq(102, note_table_remove_first(&t));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_first(&t));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_last(&t));
+  assert_int_eq(0, t.length);
+
+  assert_int_eq(NOTE_TABLE_NONE, note_table_remove_first(&t));
+  assert_int_eq(0, t.length);
+}
+
+static void test_note_table_remove_last() {
+  note_table t;
+  note_table_empty(&t);
+  note_table_prepend(&t, 102);
+  note_table_prepend(&t, 101);
+  note_table_prepend(&t, 100);
+
+  assert_int_eq(102, note_table_remove_last(&t));
+  assert_int_eq(101, note_table_last(&t));
+  assert_int_eq(2, t.length);
+
+  assert_int_eq(101, note_table_remove_last(&t));
+  assert_int_eq(100, note_table_last(&t));
+  assert_int_eq(1, t.length);
+
+  assert_int_eq(100, note_table_remove_last(&t));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_last(&t));
+  assert_int_eq(0, t.length);
+
+  assert_int_eq(NOTE_TABLE_NONE, note_table_remove_last(&t));
+}
+
+static void test_note_table_remove() {
+  note_table t;
+  note_table_empty(&t);
+  note_table_append(&t, 100);
+  note_table_append(&t, 101);
+  note_table_append(&t, 102);
+
+  assert_false(note_table_remove(&t, 10)); // not held
+  assert_int_eq(3, t.length);
+
+  assert_true(note_table_remove(&t, 101)); // from the middle
+  byte without_101[] = { 100, 102 };
+  assert_order(&t, without_101, 2);
+
+  assert_false(note_table_remove(&t, 101)); // twice is fine
+  assert_int_eq(2, t.length);
+
+  assert_true(note_table_remove(&t, 100));
+  assert_true(note_table_remove(&t, 102));
+  assert_int_eq(0, t.length);
+  assert_int_eq(NOTE_TABLE_NONE, note_table_first(&t));
+}
+
+static void test_note_table_contains() {
+  note_table t;
+  note_table_empty(&t);
+  note_table_append(&t, 0);
+  note_table_append(&t, 7);
+  note_table_append(&t, 8);
+  note_table_append(&t, 127);
+
+  assert_true(note_table_contains(&t, 0));
+  assert_true(note_table_contains(&t, 7));
+  assert_true(note_table_contains(&t, 8));
+  assert_true(note_table_contains(&t, 127));
+  assert_false(note_table_contains(&t, 1));
+  assert_false(note_table_contains(&t, 9));
+  assert_false(note_table_contains(&t, 126));
+  assert_true(note_table_contains(&t, 128 + 7)); // masked to 7 bits
+}
+
+static void test_note_table_holds_every_note() {
+  note_table t;
+  note_table_empty(&t);
+
+  for (unsigned int n = 0; n < NOTE_TABLE_SIZE; n++) {
+    note_table_append(&t, n);
+  }
+  assert_int_eq(NOTE_TABLE_SIZE, t.length);
+  assert_int_eq(0, note_table_first(&t));
+  assert_int_eq(127, note_table_last(&t));
+
+  for (unsigned int n = 0; n < NOTE_TABLE_SIZE; n += 2) {
+    note_table_remove(&t, n);
+  }
+  assert_int_eq(NOTE_TABLE_SIZE / 2, t.length);
+
+  unsigned int expected = 1;
+  for (byte n = note_table_first(&t); n != NOTE_TABLE_NONE; n = note_table_next(&t, n)) {
+    assert_int_eq(expected, n);
+    expected += 2;
+  }
+
+  // all at once, as for All Notes Off
+  note_table_empty(&t);
+  assert_int_eq(0, t.length);
+  assert_int_eq(NOTE_TABLE_NONE, note_table_first(&t));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_lowest_from(&t, 0));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_highest_from(&t, 127));
+  note_table_append(&t, 64);
+  assert_int_eq(64, note_table_first(&t));
+  assert_int_eq(64, note_table_last(&t));
+}
+
+static void test_note_table_lowest_highest() {
+  note_table t;
+  note_table_empty(&t);
+
+  assert_int_eq(NOTE_TABLE_NONE, note_table_lowest_from(&t, 0));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_highest_from(&t, 127));
+
+  note_table_append(&t, 64);
+  note_table_append(&t, 7);
+  note_table_append(&t, 127);
+  note_table_append(&t, 8);
+  note_table_append(&t, 0);
+
+  assert_int_eq(0, note_table_lowest_from(&t, 0));
+  assert_int_eq(7, note_table_lowest_from(&t, 1));
+  assert_int_eq(7, note_table_lowest_from(&t, 7));
+  assert_int_eq(8, note_table_lowest_from(&t, 8)); // across a byte boundary
+  assert_int_eq(64, note_table_lowest_from(&t, 9));
+  assert_int_eq(127, note_table_lowest_from(&t, 65));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_lowest_from(&t, 128));
+
+  assert_int_eq(127, note_table_highest_from(&t, 127));
+  assert_int_eq(127, note_table_highest_from(&t, 200)); // clamped
+  assert_int_eq(64, note_table_highest_from(&t, 126));
+  assert_int_eq(8, note_table_highest_from(&t, 63));
+  assert_int_eq(7, note_table_highest_from(&t, 7));
+  assert_int_eq(0, note_table_highest_from(&t, 6));
+
+  note_table_remove(&t, 0);
+  note_table_remove(&t, 127);
+  assert_int_eq(7, note_table_lowest_from(&t, 0));
+  assert_int_eq(64, note_table_highest_from(&t, 127));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_highest_from(&t, 6));
+
+  note_table_remove_first(&t); // 64
+  note_table_remove_first(&t); // 7
+  note_table_remove_first(&t); // 8
+  assert_int_eq(0, t.held_bytes);
+  assert_int_eq(NOTE_TABLE_NONE, note_table_lowest_from(&t, 0));
+  assert_int_eq(NOTE_TABLE_NONE, note_table_highest_from(&t, 127));
+
+  // every note, one at a time
+  for (unsigned int n = 0; n < NOTE_TABLE_SIZE; n++) {
+    note_table_append(&t, n);
+    assert_int_eq(n, note_table_lowest_from(&t, 0));
+    assert_int_eq(n, note_table_highest_from(&t, 127));
+    note_table_remove(&t, n);
+  }
+}
+
+static void test_note_table_ram() {
+  // what SID.ino used to malloc for its 16 held notes on the AVR: the deque,
+  // the hash table and 16 18-byte elements
+  unsigned int deque_bytes = 16 + 6 + 16 * 18;
+  // the host pads the struct out to its uint16_t's alignment; the AVR doesn't
+  unsigned int table_bytes = offsetof(note_table, length) + sizeof(((note_table *)0)->length);
+
+  printf("\nheld notes: note_table %u bytes (128 notes), deque/hash %u bytes on the AVR (16 notes)\n", table_bytes, deque_bytes);
+
+  assert_int_eq(277, table_bytes); // no pointers in it, so the same on the AVR
+  bool smaller = table_bytes < deque_bytes;
+  assert_true(smaller);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_note_table_empty();
+  test_note_table_append();
+  test_note_table_prepend();
+  test_note_table_remove_first();
+  test_note_table_remove_last();
+  test_note_table_remove();
+  test_note_table_contains();
+  test_note_table_holds_every_note();
+  test_note_table_lowest_highest();
+  test_note_table_ram();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,211 @@
+#define SID_NUM_CHIPS 3
+
+#include "test_helper.h"
+#include "../src/sid.h"
+
+void sid_bus_drain_start() { return; };
+
+// what each chip on the bus would hold if it could be read back
+byte chip_registers[SID_NUM_CHIPS][25];
+unsigned int chip_writes[SID_NUM_CHIPS];
+
+static void chip_array_write(__attribute__ ((unused)) void *context, byte address, byte data) {
+  byte chip = sid_address_chip(address);
+  chip_registers[chip][sid_address_register(address)] = data;
+  chip_writes[chip]++;
+}
+sid_transport chip_array_transport = { .write=chip_array_write, .context=NULL };
+
+static void reset_chips() {
+  sid_bus = &sid_null_transport;
+  sid_zero_all_registers();
+  memset(chip_registers, 0, sizeof(chip_registers));
+  memset(chip_writes, 0, sizeof(chip_writes));
+  sid_bus = &chip_array_transport;
+}
+
+static void assert_chips_match_shadow() {
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    for (byte reg = 0; reg < 25; reg++) {
+      assert_byte_eq(sid_state_bytes[sid_chip_address(chip, reg)], chip_registers[chip][reg]);
+    }
+  }
+}
+
+static void test_sid_voice_address() {
+  assert_int_eq(SID_REGISTER_OFFSET_VOICE_CONTROL, sid_voice_address(0, SID_REGISTER_OFFSET_VOICE_CONTROL));
+  assert_int_eq(14 + SID_REGISTER_OFFSET_VOICE_CONTROL, sid_voice_address(2, SID_REGISTER_OFFSET_VOICE_CONTROL));
+
+  byte address = sid_voice_address(4, SID_REGISTER_OFFSET_VOICE_CONTROL);
+  assert_int_eq(1, sid_address_chip(address));
+  assert_int_eq(7 + SID_REGISTER_OFFSET_VOICE_CONTROL, sid_address_register(address));
+
+  address = sid_voice_address(8, SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR);
+  assert_int_eq(2, sid_address_chip(address));
+  assert_int_eq(14 + SID_REGISTER_OFFSET_VOICE_ENVELOPE_SR, sid_address_register(address));
+}
+
+static void test_sid_voices_are_independent_across_chips() {
+  reset_chips();
+
+  sid_set_waveform(3, SID_RAMP, true);
+  sid_set_gate(3, true);
+  sid_set_voice_frequency_register(7, 0x1234);
+
+  assert_byte_eq(0, chip_registers[0][SID_REGISTER_OFFSET_VOICE_CONTROL]);
+  byte expected_control = SID_RAMP | SID_GATE;
+  assert_byte_eq(expected_control, chip_registers[1][SID_REGISTER_OFFSET_VOICE_CONTROL]);
+  assert_byte_eq(0x34, chip_registers[2][7 + SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO]);
+  assert_byte_eq(0x12, chip_registers[2][7 + SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI]);
+  assert_byte_eq(0, chip_registers[0][7 + SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI]);
+
+  assert_true(get_voice_gate(3));
+  assert_false(get_voice_gate(0));
+  assert_int_eq(0x1234, get_voice_frequency_register_value(7));
+  assert_int_eq(0, get_voice_frequency_register_value(1));
+}
+
+static void test_sid_global_registers_reach_every_chip() {
+  reset_chips();
+
+  sid_set_volume(9);
+  sid_set_filter_resonance(4);
+  sid_set_filter_mode(SID_FILTER_LP, true);
+  sid_set_filter_frequency(1500);
+
+  assert_int_eq(9, get_volume());
+  assert_int_eq(1500, get_filter_frequency());
+  assert_chips_match_shadow();
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    byte expected_mode_volume = SID_FILTER_LP | 9;
+    assert_byte_eq(expected_mode_volume, chip_registers[chip][SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME]);
+    assert_int_eq(5, chip_writes[chip]); // volume, resonance, mode, filter hi, filter lo
+  }
+}
+
+static void test_sid_filter_routing_per_chip() {
+  reset_chips();
+
+  sid_set_filter(4, true); // chip 1, voice 2
+  assert_byte_eq(SID_FILTER_VOICE2, chip_registers[1][SID_REGISTER_ADDRESS_FILTER_RESONANCE]);
+  assert_byte_eq(0, chip_registers[0][SID_REGISTER_ADDRESS_FILTER_RESONANCE]);
+  assert_true(get_filter_enabled_for_voice(4));
+  assert_false(get_filter_enabled_for_voice(1));
+  assert_false(get_filter_enabled_for_voice(7));
+
+  sid_set_filter(SID_VOICES, true); // ext in, everywhere
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    bool ext_filtered = (chip_registers[chip][SID_REGISTER_ADDRESS_FILTER_RESONANCE] & SID_FILTER_EXT) != 0;
+    assert_true(ext_filtered);
+  }
+}
+
+static void test_sid_transfer_ignores_missing_chips() {
+  reset_chips();
+
+  sid_transfer(sid_chip_address(3, SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME), 15);
+
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    assert_int_eq(0, chip_writes[chip]);
+  }
+}
+
+static void test_sid_transaction_spans_chips() {
+  reset_chips();
+
+  sid_begin();
+  for (word pw = 1000; pw < 1008; pw++) {
+    for (byte voice = 0; voice < SID_VOICES; voice += 3) {
+      sid_set_pulse_width(voice, pw);
+    }
+  }
+  // retrigger on the last chip: both edges must reach the bus
+  sid_set_gate(8, true);
+  sid_set_gate(8, false);
+  sid_set_gate(8, true);
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    unsigned int expected_writes = chip == 2 ? 2 : 0; // only the edge flushes
+    assert_int_eq(expected_writes, chip_writes[chip]);
+  }
+  sid_commit();
+
+  assert_int_eq(2, chip_writes[0]);
+  assert_int_eq(2, chip_writes[1]);
+  assert_int_eq(2 + 2 + 1, chip_writes[2]);
+  assert_int_eq(1007, get_voice_pulse_width(6));
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    assert_int_eq(0, sid_dirty_registers[chip]);
+  }
+  assert_chips_match_shadow();
+}
+
+static void test_sid_queue_keeps_chip_bits() {
+  reset_chips();
+  sid_queue_empty(&sid_write_queue);
+  sid_queue_enabled = true;
+
+  sid_set_attack(8, 7);
+  sid_set_volume(3);
+  for (byte chip = 0; chip < SID_NUM_CHIPS; chip++) {
+    assert_int_eq(0, chip_writes[chip]); // nothing until the ISR runs
+  }
+
+  while (sid_queue_drain_one()) {}
+  sid_queue_enabled = false;
+
+  assert_int_eq(1, chip_writes[0]);
+  assert_int_eq(1, chip_writes[1]);
+  assert_int_eq(2, chip_writes[2]);
+  assert_chips_match_shadow();
+}
+
+static void test_sid_multi_chip_recording() {
+  FILE *f = tmpfile();
+  sid_recorder rec;
+  sid_transport recording = sid_recorder_transport(&rec, f);
+
+  reset_chips();
+  sid_bus = &recording;
+
+  for (byte voice = 0; voice < SID_VOICES; voice++) {
+    sid_set_waveform(voice, SID_SQUARE, true);
+    sid_set_voice_frequency_register(voice, 1000 + voice);
+    sid_set_gate(voice, true);
+  }
+  sid_set_volume(15);
+
+  rewind(f);
+  assert_true(sid_recording_read_header(f));
+
+  sid_recording_entry e;
+  assert_true(sid_recording_read(f, &e));
+  assert_int_eq(0, sid_address_chip(e.address));
+  assert_int_eq(SID_REGISTER_OFFSET_VOICE_CONTROL, sid_address_register(e.address));
+
+  rewind(f);
+  sid_recording_read_header(f);
+  unsigned long replayed = sid_recording_replay(f, &chip_array_transport);
+
+  assert_int_eq((int)rec.writes, (int)replayed);
+  assert_chips_match_shadow();
+
+  fclose(f);
+  sid_bus = &sid_null_transport;
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_sid_voice_address();
+  test_sid_voices_are_independent_across_chips();
+  test_sid_global_registers_reach_every_chip();
+  test_sid_filter_routing_per_chip();
+  test_sid_transfer_ignores_missing_chips();
+  test_sid_transaction_spans_chips();
+  test_sid_queue_keeps_chip_bits();
+  test_sid_multi_chip_recording();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
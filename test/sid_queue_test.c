@@ -0,0 +1,166 @@
+#include "test_helper.h"
+#include "../src/sid.h"
+
+// stands in for the bus: records what the drain "ISR" wrote, in order
+unsigned int bus_writes = 0;
+sid_write bus_log[64];
+byte chip_registers[32];
+unsigned int drain_starts = 0;
+
+void sid_bus_drain_start() { drain_starts++; };
+
+static void logging_write(__attribute__ ((unused)) void *context, byte address, byte data) {
+  if (bus_writes < 64) {
+    bus_log[bus_writes] = (sid_write){ .address=address, .data=data };
+  }
+  chip_registers[address] = data;
+  bus_writes++;
+}
+sid_transport logging_transport = { .write=logging_write, .context=NULL };
+
+// what the timer-compare ISR does on every tick
+static unsigned int simulate_isr_ticks(unsigned int ticks) {
+  unsigned int drained = 0;
+  for (unsigned int i = 0; i < ticks; i++) {
+    if (sid_queue_drain_one()) {
+      drained++;
+    }
+  }
+  return drained;
+}
+
+static void reset_bus() {
+  sid_queue_enabled = false;
+  sid_zero_all_registers();
+  sid_queue_empty(&sid_write_queue);
+  sid_queue_enabled = true;
+  bus_writes = 0;
+  drain_starts = 0;
+}
+
+static void test_sid_queue_push_pop() {
+  sid_queue q;
+  sid_queue_empty(&q);
+  sid_write w;
+
+  assert_int_eq(0, sid_queue_depth(&q));
+  assert_false(sid_queue_pop(&q, &w));
+
+  assert_true(sid_queue_push(&q, 1, 10));
+  assert_true(sid_queue_push(&q, 2, 20));
+  assert_int_eq(2, sid_queue_depth(&q));
+
+  assert_true(sid_queue_pop(&q, &w));
+  assert_int_eq(1, w.address);
+  assert_int_eq(10, w.data);
+  assert_true(sid_queue_pop(&q, &w));
+  assert_int_eq(2, w.address);
+  assert_int_eq(20, w.data);
+  assert_false(sid_queue_pop(&q, &w));
+  assert_int_eq(0, sid_queue_depth(&q));
+  assert_int_eq(2, q.max_depth);
+}
+
+static void test_sid_queue_wraps_and_overflows() {
+  sid_queue q;
+  sid_queue_empty(&q);
+  sid_write w;
+
+  // one slot always stays free
+  for (unsigned int i = 0; i < SID_QUEUE_SIZE - 1; i++) {
+    assert_true(sid_queue_push(&q, i & 0B00011111, i));
+  }
+  assert_int_eq(SID_QUEUE_SIZE - 1, sid_queue_depth(&q));
+  assert_false(sid_queue_push(&q, 0, 0));
+  assert_int_eq(1, q.overflows);
+
+  // drain and refill across the wrap point, checking FIFO order
+  for (unsigned int round = 0; round < 3; round++) {
+    for (unsigned int i = 0; i < SID_QUEUE_SIZE / 2; i++) {
+      sid_queue_pop(&q, &w);
+    }
+    for (unsigned int i = 0; i < SID_QUEUE_SIZE / 2; i++) {
+      assert_true(sid_queue_push(&q, 0, 100 + i));
+    }
+  }
+  assert_int_eq(SID_QUEUE_SIZE - 1, sid_queue_depth(&q));
+  assert_int_eq(SID_QUEUE_SIZE - 1, q.max_depth);
+}
+
+static void test_sid_transfer_is_deferred_to_the_isr() {
+  reset_bus();
+
+  sid_set_volume(9);
+  sid_set_attack(1, 4);
+
+  // the main loop has returned, but nothing hit the bus yet
+  assert_int_eq(0, bus_writes);
+  assert_int_eq(2, sid_queue_depth(&sid_write_queue));
+  assert_true(drain_starts > 0);
+  // our shadow is already up to date, so getters and RMW setters still work
+  assert_int_eq(9, get_volume());
+
+  assert_int_eq(2, simulate_isr_ticks(5));
+  assert_int_eq(2, bus_writes);
+  assert_int_eq(SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME, bus_log[0].address);
+  assert_int_eq(9, bus_log[0].data);
+  assert_int_eq((1 * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD, bus_log[1].address);
+  assert_int_eq(4 << 4, bus_log[1].data);
+}
+
+static void test_sid_commit_enqueues_each_dirty_register_once() {
+  reset_bus();
+
+  sid_begin();
+  for (word pw = 0; pw < 100; pw++) {
+    sid_set_pulse_width(2, 2000 + pw);
+  }
+  sid_set_gate(2, true);
+  assert_int_eq(0, sid_queue_depth(&sid_write_queue));
+  sid_commit();
+
+  assert_int_eq(3, sid_queue_depth(&sid_write_queue));
+  simulate_isr_ticks(3);
+  assert_int_eq(3, bus_writes);
+  assert_int_eq(0, sid_write_queue.overflows);
+}
+
+static void test_sid_queue_overflow_keeps_order() {
+  reset_bus();
+
+  // an ISR that only gets one tick in per four writes: the queue fills up and
+  // the producer has to drain synchronously
+  for (unsigned int i = 1; i <= 200; i++) {
+    sid_set_filter_resonance(i & 0B00001111);
+    sid_set_volume(i & 0B00001111);
+    if (i % 4 == 0) {
+      simulate_isr_ticks(1);
+    }
+  }
+  simulate_isr_ticks(SID_QUEUE_SIZE);
+
+  assert_true(sid_write_queue.overflows > 0);
+  assert_int_eq(SID_QUEUE_SIZE - 1, sid_write_queue.max_depth);
+  assert_int_eq(0, sid_queue_depth(&sid_write_queue));
+  // nothing was dropped, and the chip ended up where our shadow says it is
+  assert_int_eq(400, bus_writes);
+  assert_int_eq(8, get_volume());
+  for (byte address = 0; address < 25; address++) {
+    assert_byte_eq(sid_state_bytes[address], chip_registers[address]);
+  }
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+  sid_bus = &logging_transport;
+
+  test_sid_queue_push_pop();
+  test_sid_queue_wraps_and_overflows();
+  test_sid_transfer_is_deferred_to_the_isr();
+  test_sid_commit_enqueues_each_dirty_register_once();
+  test_sid_queue_overflow_keeps_order();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,126 @@
+#define SID_TELEMETRY
+
+#include "test_helper.h"
+#include "../src/sid.h"
+
+void sid_bus_drain_start() { return; };
+
+// a fake timer: every bus write takes 3 ticks, and tests can advance it
+uint16_t fake_clock = 0;
+
+uint16_t sid_telemetry_clock() {
+  return fake_clock;
+}
+
+static void slow_write(__attribute__ ((unused)) void *context, __attribute__ ((unused)) byte address, __attribute__ ((unused)) byte data) {
+  fake_clock += 3;
+}
+sid_transport slow_transport = { .write=slow_write, .context=NULL };
+
+static void reset() {
+  sid_bus = &sid_null_transport;
+  sid_zero_all_registers();
+  sid_telemetry_reset();
+  sid_bus = &slow_transport;
+}
+
+static void test_sid_telemetry_counts_writes_per_register() {
+  reset();
+
+  sid_set_volume(15);
+  sid_set_volume(14);
+  sid_set_attack(1, 9);
+
+  assert_int_eq(3, (int)sid_telemetry_total_writes());
+  assert_int_eq(2, (int)sid_stats.register_writes[SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME]);
+  assert_int_eq(1, (int)sid_stats.register_writes[sid_voice_address(1, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
+  assert_int_eq(0, (int)sid_stats.register_writes[sid_voice_address(0, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
+}
+
+static void test_sid_telemetry_counts_suppressed_writes() {
+  reset();
+
+  sid_set_volume(15);
+  sid_set_volume(15);
+  sid_set_volume(15);
+  assert_int_eq(2, (int)sid_stats.suppressed);
+
+  // the frequency setter skips unchanged halves itself
+  sid_set_voice_frequency_register(0, 0x1234);
+  sid_set_voice_frequency_register(0, 0x1299);
+  assert_int_eq(3, (int)sid_stats.suppressed); // hi byte the second time
+
+  assert_int_eq(1 + 2 + 1, (int)sid_telemetry_total_writes());
+}
+
+static void test_sid_telemetry_counts_coalesced_writes() {
+  reset();
+
+  sid_begin();
+  for (word pw = 1000; pw < 1008; pw++) {
+    sid_set_pulse_width(0, pw);
+  }
+  sid_set_gate(0, true);
+  sid_set_gate(0, false); // an edge: flushed, not coalesced
+  sid_commit();
+
+  assert_int_eq(7, (int)sid_stats.coalesced); // lo byte, 8 values, 1 write
+  assert_int_eq(1 + 1 + 1 + 1, (int)sid_telemetry_total_writes()); // pw hi, pw lo, gate on, gate off
+}
+
+static void test_sid_telemetry_measures_bus_time() {
+  reset();
+  fake_clock = 65530; // wraps mid-test
+
+  sid_set_volume(1);
+  sid_set_volume(2);
+  sid_set_volume(3);
+
+  assert_int_eq(9, (int)sid_stats.bus_ticks);
+}
+
+static void test_sid_telemetry_longest_critical_section() {
+  reset();
+
+  sid_set_volume(1);
+  assert_int_eq(3, sid_stats.longest_critical_ticks);
+
+  sid_begin();
+  sid_set_volume(2);
+  for (byte voice = 0; voice < 3; voice++) {
+    sid_set_attack(voice, 5);
+  }
+  sid_commit(); // 4 writes, one critical section
+  assert_int_eq(12, sid_stats.longest_critical_ticks);
+
+  sid_set_volume(3);
+  assert_int_eq(12, sid_stats.longest_critical_ticks); // it's a high-water mark
+}
+
+static void test_sid_telemetry_reset() {
+  reset();
+
+  sid_set_volume(1);
+  sid_set_volume(1);
+  sid_telemetry_reset();
+
+  assert_int_eq(0, (int)sid_telemetry_total_writes());
+  assert_int_eq(0, (int)sid_stats.suppressed);
+  assert_int_eq(0, (int)sid_stats.bus_ticks);
+  assert_int_eq(0, sid_stats.longest_critical_ticks);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_sid_telemetry_counts_writes_per_register();
+  test_sid_telemetry_counts_suppressed_writes();
+  test_sid_telemetry_counts_coalesced_writes();
+  test_sid_telemetry_measures_bus_time();
+  test_sid_telemetry_longest_critical_section();
+  test_sid_telemetry_reset();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -1,10 +1,17 @@
+#include <stdlib.h>
 #include "test_helper.h"
 #include "../src/sid.h"
 
-void clock_high() { return; };
-void clock_low() { return; };
-void cs_high() { return; };
-void cs_low() { return; };
+unsigned int bus_writes = 0;
+byte last_bus_data = 0;
+
+void sid_bus_drain_start() { return; };
+
+static void counting_write(__attribute__ ((unused)) void *context, __attribute__ ((unused)) byte address, byte data) {
+  bus_writes++;
+  last_bus_data = data;
+}
+sid_transport counting_transport = { .write=counting_write, .context=NULL };
 
 static void test_sid_transfer() {
   sid_zero_all_registers();
@@ -133,15 +140,183 @@ static void test_sid_set_filter_mode() {
 }
 
 static void test_sid_set_voice_frequency() {
-  printf("\nWARN: sid_set_voice_frequency is untested");
+  sid_zero_all_registers();
+
+  sid_set_voice_frequency_register(1, 0x1D45); // A4
+  assert_int_eq(0x1D45, get_voice_frequency_register_value(1));
+  assert_byte_eq(0x45, sid_state_bytes[(1 * 7) + SID_REGISTER_OFFSET_VOICE_FREQUENCY_LO]);
+  assert_byte_eq(0x1D, sid_state_bytes[(1 * 7) + SID_REGISTER_OFFSET_VOICE_FREQUENCY_HI]);
+
+  // only the byte that changed goes out
+  bus_writes = 0;
+  sid_set_voice_frequency_register(1, 0x1D46);
+  assert_int_eq(1, bus_writes);
+
+  // the float API lands on the same register value
+  sid_set_voice_frequency(2, 440.0);
+  assert_int_eq(7382, get_voice_frequency_register_value(2));
+}
+
+// reference implementation: what the firmware used to compute in float
+static long float_register_word(byte note, long pitch_offset) {
+  double hertz = note_number_to_frequency(note) * pow(2, (pitch_offset / 256.0) / 12.0);
+  long frequency = lround(hertz / CLOCK_SIGNAL_FACTOR);
+  return frequency > 65535 ? 65535 : frequency;
+}
+
+static void test_sid_note_register_word() {
+  // the table itself
+  for (byte note = 0; note < 95; note++) {
+    assert_int_eq((word)float_register_word(note, 0), sid_note_register_word(note, 0));
+  }
+  assert_int_eq(65535, sid_note_register_word(95, 0)); // B7 is out of the SID's range
+
+  // bends and detunes, up to two octaves either way
+  long worst_error = 0;
+  for (byte note = 0; note < 96; note++) {
+    for (long offset = -2 * SID_PITCH_OFFSET_OCTAVE; offset <= 2 * SID_PITCH_OFFSET_OCTAVE; offset += 37) {
+      long expected = float_register_word(note, offset);
+      long error = labs(expected - (long)sid_note_register_word(note, offset));
+      long allowed = 1 + expected / 20000; // 1 LSB, or ~0.09 cents
+      if (error > allowed) {
+        assert_int_eq((word)expected, sid_note_register_word(note, offset));
+      }
+      if (error > worst_error) {
+        worst_error = error;
+      }
+    }
+  }
+  assert_true((worst_error <= 4));
+
+  // octaves are exact shifts
+  assert_int_eq(35114, sid_pitch_register_word(84 * SID_PITCH_OFFSET_SEMITONE));
+  assert_int_eq(17557, sid_pitch_register_word(72 * SID_PITCH_OFFSET_SEMITONE));
+  assert_int_eq(274, sid_pitch_register_word(0));
+  assert_int_eq(137, sid_pitch_register_word(-SID_PITCH_OFFSET_OCTAVE));
+
+  // clamping
+  assert_int_eq(65535, sid_note_register_word(90, SID_PITCH_OFFSET_OCTAVE));
+  assert_int_eq(65535, sid_note_register_word(120, 0));
+  assert_int_eq(65535, sid_pitch_register_word(40 * SID_PITCH_OFFSET_OCTAVE));
+  assert_int_eq(0, sid_pitch_register_word(-40 * SID_PITCH_OFFSET_OCTAVE));
 }
 
 static void test_sid_set_gate() {
   printf("\nWARN: sid_set_gate is untested");
 }
 
+static void test_sid_transaction_coalesces_pulse_width_burst() {
+  sid_zero_all_registers();
+
+  // a PW automation lane: 8 CCs arriving in one `loop()` pass
+  bus_writes = 0;
+  for (word pw = 1000; pw < 1008; pw++) {
+    sid_set_pulse_width(0, pw);
+  }
+  unsigned int writes_without_transaction = bus_writes;
+
+  sid_zero_all_registers();
+  bus_writes = 0;
+  sid_begin();
+  for (word pw = 1000; pw < 1008; pw++) {
+    sid_set_pulse_width(0, pw);
+  }
+  assert_int_eq(0, bus_writes); // nothing reaches the bus until commit
+  sid_commit();
+
+  assert_int_eq(9, writes_without_transaction); // hi byte once, lo byte 8 times
+  assert_int_eq(2, bus_writes);
+  assert_int_eq(1007, get_voice_pulse_width(0));
+  assert_int_eq(0, sid_dirty_registers[0]);
+}
+
+static void test_sid_transaction_coalesces_filter_sweep() {
+  sid_zero_all_registers();
+
+  bus_writes = 0;
+  for (word f = 0; f < 2048; f += 128) {
+    sid_set_filter_frequency(f);
+  }
+  unsigned int writes_without_transaction = bus_writes;
+
+  sid_zero_all_registers();
+  bus_writes = 0;
+  sid_begin();
+  for (word f = 0; f < 2048; f += 128) {
+    sid_set_filter_frequency(f);
+  }
+  sid_commit();
+
+  assert_int_eq(15, writes_without_transaction);
+  assert_int_eq(1, bus_writes); // the low 3 bits never changed
+  assert_int_eq(1920, get_filter_frequency());
+}
+
+static void test_sid_transaction_paraphonic_waveform_change() {
+  sid_zero_all_registers();
+
+  // `handle_voice_waveform_change` in paraphonic mode, toggled on then off and
+  // on again by a jittery controller
+  bus_writes = 0;
+  for (byte voice = 0; voice < 3; voice++) { sid_set_waveform(voice, SID_RAMP, true); }
+  for (byte voice = 0; voice < 3; voice++) { sid_set_waveform(voice, SID_RAMP, false); }
+  for (byte voice = 0; voice < 3; voice++) { sid_set_waveform(voice, SID_RAMP, true); }
+  unsigned int writes_without_transaction = bus_writes;
+
+  sid_zero_all_registers();
+  bus_writes = 0;
+  sid_begin();
+  for (byte voice = 0; voice < 3; voice++) { sid_set_waveform(voice, SID_RAMP, true); }
+  for (byte voice = 0; voice < 3; voice++) { sid_set_waveform(voice, SID_RAMP, false); }
+  for (byte voice = 0; voice < 3; voice++) { sid_set_waveform(voice, SID_RAMP, true); }
+  sid_commit();
+
+  assert_int_eq(9, writes_without_transaction);
+  assert_int_eq(3, bus_writes);
+  for (byte voice = 0; voice < 3; voice++) {
+    assert_byte_eq(SID_RAMP, sid_state_bytes[(voice * 7) + SID_REGISTER_OFFSET_VOICE_CONTROL]);
+  }
+}
+
+static void test_sid_transaction_keeps_gate_edges() {
+  sid_zero_all_registers();
+  sid_set_waveform(0, SID_SQUARE, true);
+  sid_set_gate(0, true);
+
+  // retriggering a voice is gate off -> gate on. Coalescing those would leave
+  // the register untouched and the envelope would never restart.
+  bus_writes = 0;
+  sid_begin();
+  sid_set_gate(0, false);
+  sid_set_gate(0, true);
+  sid_commit();
+
+  byte square_gate_on = SID_SQUARE | SID_GATE;
+  assert_int_eq(2, bus_writes);
+  assert_byte_eq(square_gate_on, last_bus_data);
+  assert_true(get_voice_gate(0));
+}
+
+static void test_sid_transaction_nesting() {
+  sid_zero_all_registers();
+
+  bus_writes = 0;
+  sid_begin();
+  sid_begin();
+  sid_set_volume(7);
+  sid_commit();
+  assert_int_eq(0, bus_writes); // inner commit doesn't flush
+  sid_commit();
+  assert_int_eq(1, bus_writes);
+
+  sid_commit(); // unbalanced commit is a no-op
+  assert_int_eq(1, bus_writes);
+  assert_int_eq(0, sid_transaction_depth);
+}
+
 int main() {
   setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+  sid_bus = &counting_transport;
 
   test_sid_transfer();
   test_sid_set_volume();
@@ -159,7 +334,13 @@ int main() {
   test_sid_set_filter();
   test_sid_set_filter_mode();
   test_sid_set_voice_frequency();
+  test_sid_note_register_word();
   test_sid_set_gate();
+  test_sid_transaction_coalesces_pulse_width_burst();
+  test_sid_transaction_coalesces_filter_sweep();
+  test_sid_transaction_paraphonic_waveform_change();
+  test_sid_transaction_keeps_gate_edges();
+  test_sid_transaction_nesting();
 
   printf("\n");
 
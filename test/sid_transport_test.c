@@ -0,0 +1,120 @@
+#include "test_helper.h"
+#include "../src/sid.h"
+
+void sid_bus_drain_start() { return; };
+
+byte replayed_registers[32];
+unsigned int replayed_writes = 0;
+
+static void replay_write(__attribute__ ((unused)) void *context, byte address, byte data) {
+  replayed_registers[address] = data;
+  replayed_writes++;
+}
+
+static void test_sid_null_transport() {
+  sid_bus = &sid_null_transport;
+  sid_zero_all_registers();
+
+  sid_set_volume(12);
+  assert_int_eq(12, get_volume()); // shadow still tracks what we "sent"
+}
+
+static void test_sid_recorder() {
+  FILE *f = tmpfile();
+  sid_recorder rec;
+  sid_transport recording = sid_recorder_transport(&rec, f);
+
+  sid_bus = &sid_null_transport;
+  sid_zero_all_registers();
+  sid_bus = &recording;
+
+  sid_set_volume(15);
+  sid_recorder_advance(&rec, 1000);
+  sid_set_attack(2, 3);
+  sid_set_decay(2, 9);
+
+  assert_int_eq(3, (int)rec.writes);
+
+  long size = ftell(f);
+  assert_long_eq((long)(SID_RECORDING_HEADER_SIZE + 3 * SID_RECORDING_ENTRY_SIZE), size);
+
+  rewind(f);
+  assert_true(sid_recording_read_header(f));
+
+  sid_recording_entry e;
+  assert_true(sid_recording_read(f, &e));
+  assert_int_eq(0, (int)e.time);
+  assert_int_eq(SID_REGISTER_ADDRESS_FILTER_MODE_VOLUME, e.address);
+  assert_int_eq(15, e.data);
+
+  assert_true(sid_recording_read(f, &e));
+  assert_int_eq(1001, (int)e.time); // 1 cycle for the first write, then 1000µs of host time
+  assert_int_eq((2 * 7) + SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD, e.address);
+  assert_int_eq(0B00110000, e.data);
+
+  assert_true(sid_recording_read(f, &e));
+  assert_int_eq(1002, (int)e.time); // back-to-back writes are one Ø2 cycle apart
+  assert_int_eq(0B00111001, e.data);
+
+  assert_false(sid_recording_read(f, &e));
+
+  fclose(f);
+  sid_bus = &sid_null_transport;
+}
+
+static void test_sid_recording_rejects_garbage() {
+  FILE *f = tmpfile();
+  fputs("MIDI\001", f);
+  rewind(f);
+  assert_false(sid_recording_read_header(f));
+  fclose(f);
+
+  f = tmpfile();
+  rewind(f);
+  assert_false(sid_recording_read_header(f)); // empty file
+  fclose(f);
+}
+
+static void test_sid_recording_replay() {
+  FILE *f = tmpfile();
+  sid_recorder rec;
+  sid_transport recording = sid_recorder_transport(&rec, f);
+
+  sid_bus = &sid_null_transport;
+  sid_zero_all_registers();
+  sid_bus = &recording;
+
+  for (byte voice = 0; voice < 3; voice++) {
+    sid_set_waveform(voice, SID_TRIANGLE, true);
+    sid_set_pulse_width(voice, 1234);
+    sid_set_gate(voice, true);
+  }
+  sid_set_filter_frequency(1500);
+
+  rewind(f);
+  assert_true(sid_recording_read_header(f));
+  sid_transport replayer = { .write=replay_write, .context=NULL };
+  unsigned long replayed = sid_recording_replay(f, &replayer);
+
+  assert_int_eq((int)rec.writes, (int)replayed);
+  assert_int_eq((int)rec.writes, (int)replayed_writes);
+  for (byte address = 0; address < 25; address++) {
+    assert_byte_eq(sid_state_bytes[address], replayed_registers[address]);
+  }
+
+  fclose(f);
+  sid_bus = &sid_null_transport;
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_sid_null_transport();
+  test_sid_recorder();
+  test_sid_recording_rejects_garbage();
+  test_sid_recording_replay();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,132 @@
+// sid_voice<V> is C++ only, so this runner is built with clang++. Two chips, so
+// the chip bits of the compile-time addresses get exercised too.
+#define SID_NUM_CHIPS 2
+
+#include "test_helper.h"
+#include "../src/sid.h"
+
+void sid_bus_drain_start() { return; };
+
+struct logged_write {
+  byte address;
+  byte data;
+};
+
+logged_write bus_log[64];
+unsigned int bus_log_length = 0;
+
+static void logging_write(__attribute__ ((unused)) void *context, byte address, byte data) {
+  if (bus_log_length < sizeof(bus_log) / sizeof(*bus_log)) {
+    bus_log[bus_log_length] = { address, data };
+  }
+  bus_log_length++;
+}
+sid_transport logging_transport = { .write=logging_write, .context=NULL };
+
+static void reset_bus() {
+  sid_bus = &sid_null_transport;
+  sid_zero_all_registers();
+  bus_log_length = 0;
+  sid_bus = &logging_transport;
+}
+
+// runs the same changes through the runtime setters, then the compile-time
+// ones, and checks both leave the same registers and put the same writes on the
+// bus in the same order
+template <byte VOICE>
+static void assert_matches_runtime_setters() {
+  reset_bus();
+  sid_set_waveform(VOICE, SID_SQUARE | SID_GATE, true); // gate is masked off
+  sid_set_ring_mod(VOICE, true);
+  sid_set_sync(VOICE, true);
+  sid_set_test(VOICE, true);
+  sid_set_test(VOICE, false);
+  sid_set_gate(VOICE, true);
+  sid_set_attack(VOICE, 3);
+  sid_set_decay(VOICE, 0xFE);
+  sid_set_sustain(VOICE, 12);
+  sid_set_release(VOICE, 5);
+  sid_set_pulse_width(VOICE, 0xFABC);
+  sid_set_voice_frequency_register(VOICE, 0x1234);
+  sid_set_voice_frequency_register(VOICE, 0x1299); // only lo changes
+  sid_set_filter(VOICE, true);
+
+  byte runtime_state[SID_STATE_SIZE];
+  logged_write runtime_log[64];
+  unsigned int runtime_log_length = bus_log_length;
+  memcpy(runtime_state, sid_state_bytes, sizeof(runtime_state));
+  memcpy(runtime_log, bus_log, sizeof(runtime_log));
+
+  reset_bus();
+  typedef sid_voice<VOICE> v;
+  v::set_waveform(SID_SQUARE | SID_GATE, true);
+  v::set_ring_mod(true);
+  v::set_sync(true);
+  v::set_test(true);
+  v::set_test(false);
+  v::set_gate(true);
+  v::set_attack(3);
+  v::set_decay(0xFE);
+  v::set_sustain(12);
+  v::set_release(5);
+  v::set_pulse_width(0xFABC);
+  v::set_frequency_register(0x1234);
+  v::set_frequency_register(0x1299);
+  v::set_filter(true);
+
+  assert_true(v::gate());
+  assert_int_eq(runtime_log_length, bus_log_length);
+  for (unsigned int i = 0; i < bus_log_length; i++) {
+    assert_byte_eq(runtime_log[i].address, bus_log[i].address);
+    assert_byte_eq(runtime_log[i].data, bus_log[i].data);
+  }
+  for (unsigned int address = 0; address < SID_STATE_SIZE; address++) {
+    assert_byte_eq(runtime_state[address], sid_state_bytes[address]);
+  }
+}
+
+static void test_sid_voice_addresses_are_constants() {
+  static_assert(sid_voice<0>::address(SID_REGISTER_OFFSET_VOICE_CONTROL) == 4, "");
+  static_assert(sid_voice<2>::address(SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD) == 19, "");
+  static_assert(sid_voice<4>::address(SID_REGISTER_OFFSET_VOICE_CONTROL) == ((1 << 5) | 11), "");
+  static_assert(sid_voice<5>::FILTER_MASK == SID_FILTER_VOICE3, "");
+
+  for (byte offset = 0; offset < 7; offset++) {
+    assert_int_eq(sid_voice_address(0, offset), sid_voice<0>::address(offset));
+    assert_int_eq(sid_voice_address(1, offset), sid_voice<1>::address(offset));
+    assert_int_eq(sid_voice_address(5, offset), sid_voice<5>::address(offset));
+  }
+}
+
+static void test_sid_voice_matches_runtime_setters() {
+  assert_matches_runtime_setters<0>();
+  assert_matches_runtime_setters<1>();
+  assert_matches_runtime_setters<2>();
+  assert_matches_runtime_setters<3>();
+  assert_matches_runtime_setters<4>();
+  assert_matches_runtime_setters<5>();
+}
+
+static void test_sid_voice_on_every_chip() {
+  reset_bus();
+
+  sid_voice_on_every_chip<1>::apply([](auto voice) { voice.set_attack(9); });
+
+  assert_int_eq(2, bus_log_length);
+  assert_byte_eq(0B10010000, sid_state_bytes[sid_voice_address(1, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
+  assert_byte_eq(0B10010000, sid_state_bytes[sid_voice_address(4, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
+  assert_byte_eq(0, sid_state_bytes[sid_voice_address(0, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
+  assert_byte_eq(0, sid_state_bytes[sid_voice_address(3, SID_REGISTER_OFFSET_VOICE_ENVELOPE_AD)]);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_sid_voice_addresses_are_constants();
+  test_sid_voice_matches_runtime_setters();
+  test_sid_voice_on_every_chip();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
@@ -0,0 +1,142 @@
+#include "test_helper.h"
+#include "../src/sysex.h"
+
+static void example_patch(sysex_patch *patch) {
+  for (byte i = 0; i < SYSEX_PATCH_REGISTERS; i++) {
+    patch->registers[i] = i * 11; // top bits set from register 12 up
+  }
+  patch->modes = SYSEX_PATCH_PARAPHONIC | SYSEX_PATCH_PULSE_WIDTH_MODULATION;
+  patch->note_priority = 2;
+  patch->voice_stealing = 1;
+  patch->glide_time_millis = 1500;
+  patch->pitch_bend_semitones = 12;
+  patch->detune_semitones = 2;
+  patch->detunes[0] = 0;
+  patch->detunes[1] = 8192;
+  patch->detunes[2] = 16383;
+}
+
+static void test_sysex_pack() {
+  byte in[9] = { 0x00, 0x7F, 0x80, 0xFF, 0x01, 0x81, 0x40, 0xC0, 0x55 };
+  byte packed[SYSEX_PACKED_SIZE(9)];
+  byte out[9];
+
+  assert_int_eq(11, SYSEX_PACKED_SIZE(9));
+  assert_int_eq(11, sysex_pack(in, 9, packed));
+  assert_int_eq(0B0101100, packed[0]); // bytes 2, 3 and 5
+  assert_int_eq(0x00, packed[3]);
+  assert_int_eq(0x7F, packed[4]);
+  assert_int_eq(0B1, packed[8]); // byte 7, the first of the second group
+  assert_int_eq(0x40, packed[9]);
+
+  bool seven_bit = true;
+  for (byte i = 0; i < sizeof(packed); i++) {
+    seven_bit = seven_bit && packed[i] < 0x80;
+  }
+  assert_true(seven_bit);
+
+  assert_int_eq(9, sysex_unpack(packed, sizeof(packed), out));
+  bool round_trip = memcmp(in, out, sizeof(in)) == 0;
+  assert_true(round_trip);
+}
+
+static void test_sysex_checksum() {
+  byte data[] = { 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00 };
+  byte checksum = sysex_checksum(data, sizeof(data));
+
+  assert_int_eq(0x1C, checksum);
+  byte sum = checksum;
+  for (byte i = 0; i < sizeof(data); i++) {
+    sum += data[i];
+  }
+  sum &= 0x7F;
+  assert_int_eq(0, sum);
+  assert_int_eq(0, sysex_checksum(data, 0));
+}
+
+static void test_sysex_patch_round_trip() {
+  sysex_patch patch, parsed;
+  byte message[SYSEX_PATCH_MESSAGE_SIZE];
+  byte command, checksum;
+  example_patch(&patch);
+
+  assert_int_eq(38, SYSEX_PATCH_SIZE);
+  assert_int_eq(49, SYSEX_PATCH_MESSAGE_SIZE);
+  assert_int_eq(SYSEX_PATCH_MESSAGE_SIZE, sysex_patch_message(&patch, message));
+  assert_int_eq(0xF0, message[0]);
+  assert_int_eq(SYSEX_MANUFACTURER_ID, message[1]);
+  assert_int_eq(SYSEX_PATCH_DUMP, message[2]);
+  assert_int_eq(0xF7, message[SYSEX_PATCH_MESSAGE_SIZE - 1]);
+
+  // what the parser hands over: between F0 and F7
+  message[2] = SYSEX_PATCH_LOAD;
+  byte status = sysex_parse(&message[1], SYSEX_PATCH_MESSAGE_SIZE - 2, &command, &checksum, &parsed);
+  assert_int_eq(SYSEX_STATUS_OK, status);
+  assert_int_eq(SYSEX_PATCH_LOAD, command);
+  assert_int_eq(message[SYSEX_PATCH_MESSAGE_SIZE - 2], checksum);
+
+  bool registers_match = memcmp(patch.registers, parsed.registers, SYSEX_PATCH_REGISTERS) == 0;
+  assert_true(registers_match);
+  assert_int_eq(patch.modes, parsed.modes);
+  assert_int_eq(2, parsed.note_priority);
+  assert_int_eq(1, parsed.voice_stealing);
+  assert_int_eq(1500, parsed.glide_time_millis);
+  assert_int_eq(12, parsed.pitch_bend_semitones);
+  assert_int_eq(2, parsed.detune_semitones);
+  assert_int_eq(0, parsed.detunes[0]);
+  assert_int_eq(8192, parsed.detunes[1]);
+  assert_int_eq(16383, parsed.detunes[2]);
+}
+
+static void test_sysex_parse_errors() {
+  sysex_patch patch;
+  byte message[SYSEX_PATCH_MESSAGE_SIZE];
+  byte command, checksum;
+  example_patch(&patch);
+  sysex_patch_message(&patch, message);
+  byte *data = &message[1];
+  byte length = SYSEX_PATCH_MESSAGE_SIZE - 2;
+
+  // a corrupted data byte
+  data[10] ^= 0x01;
+  assert_int_eq(SYSEX_STATUS_BAD_CHECKSUM, sysex_parse(data, length, &command, &checksum, &patch));
+  assert_int_eq(SYSEX_PATCH_DUMP, command);
+  data[10] ^= 0x01;
+
+  // a byte short
+  assert_int_eq(SYSEX_STATUS_BAD_LENGTH, sysex_parse(data, length - 1, &command, &checksum, &patch));
+
+  byte request[] = { SYSEX_MANUFACTURER_ID, SYSEX_PATCH_DUMP_REQUEST };
+  assert_int_eq(SYSEX_STATUS_OK, sysex_parse(request, 2, &command, &checksum, &patch));
+  assert_int_eq(SYSEX_PATCH_DUMP_REQUEST, command);
+
+  byte unknown[] = { SYSEX_MANUFACTURER_ID, 0x42 };
+  assert_int_eq(SYSEX_STATUS_UNKNOWN_COMMAND, sysex_parse(unknown, 2, &command, &checksum, &patch));
+
+  byte theirs[] = { 0x43, SYSEX_PATCH_DUMP_REQUEST };
+  assert_int_eq(SYSEX_STATUS_NOT_OURS, sysex_parse(theirs, 2, &command, &checksum, &patch));
+  assert_int_eq(SYSEX_STATUS_NOT_OURS, sysex_parse(theirs, 0, &command, &checksum, &patch));
+}
+
+static void test_sysex_ack_message() {
+  byte ack[SYSEX_ACK_MESSAGE_SIZE];
+
+  assert_int_eq(7, sysex_ack_message(SYSEX_PATCH_LOAD, SYSEX_STATUS_BAD_CHECKSUM, 0x55, ack));
+  byte expected[] = { 0xF0, SYSEX_MANUFACTURER_ID, SYSEX_ACK, SYSEX_PATCH_LOAD, SYSEX_STATUS_BAD_CHECKSUM, 0x55, 0xF7 };
+  bool matches = memcmp(expected, ack, sizeof(expected)) == 0;
+  assert_true(matches);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_sysex_pack();
+  test_sysex_checksum();
+  test_sysex_patch_round_trip();
+  test_sysex_parse_errors();
+  test_sysex_ack_message();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
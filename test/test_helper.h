@@ -116,8 +116,8 @@ volatile unsigned int TEST_FAILURE_COUNT = 0;
 }
 
 #define NOTE_FIXTURES                                                          \
-  note note0 = {.number=100, .on_time=1, .off_time=2, .voiced_by_oscillator=0};\
-  note note1 = {.number=101, .on_time=2, .off_time=3, .voiced_by_oscillator=1};\
-  note note2 = {.number=102, .on_time=3, .off_time=4, .voiced_by_oscillator=2};
+  note note0 = {.number=100, .voiced_by_oscillator=0, .on_time=1, .off_time=2};\
+  note note1 = {.number=101, .voiced_by_oscillator=1, .on_time=2, .off_time=3};\
+  note note2 = {.number=102, .voiced_by_oscillator=2, .on_time=3, .off_time=4};
 
 #endif /* TEST_HELPER_H */
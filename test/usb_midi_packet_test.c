@@ -0,0 +1,196 @@
+#include "test_helper.h"
+#include "../src/midi_constants.h"
+#include "../src/usb_midi_packet.h"
+
+#define MAX_EVENTS 16
+
+// every event `count` packets make
+static byte read_packets(midi_parser *p, const usb_midi_packet *packets, byte count, midi_event *events) {
+  byte read = 0;
+
+  for (byte i = 0; i < count; i++) {
+    if (usb_midi_packet_read(p, &packets[i], &events[read]) && read < MAX_EVENTS - 1) {
+      read++;
+    }
+  }
+
+  return read;
+}
+
+static void assert_event(const midi_event *event, byte status, byte data_one, byte data_two) {
+  assert_int_eq(status, event->status);
+  assert_int_eq(data_one, event->data_one);
+  assert_int_eq(data_two, event->data_two);
+}
+
+static void test_usb_midi_packet_channel_messages() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  usb_midi_packet packets[] = {
+    { 0x09, { 0x90, 60, 100 } },
+    { 0x0B, { 0xB3, 7, 127 } },
+    { 0x0C, { 0xC0, 3, 0 } },
+    { 0x0D, { 0xD0, 90, 0 } },
+    { 0x0E, { 0xE0, 0x00, 0x40 } },
+    { 0x18, { 0x80, 60, 0 } }, // cable 1
+  };
+  assert_int_eq(6, read_packets(&p, packets, 6, events));
+  assert_event(&events[0], 0x90, 60, 100);
+  assert_event(&events[1], 0xB3, 7, 127);
+  assert_event(&events[2], 0xC0, 3, 0);
+  assert_event(&events[3], 0xD0, 90, 0);
+  assert_event(&events[4], 0xE0, 0x00, 0x40);
+  assert_event(&events[5], 0x80, 60, 0);
+
+  assert_int_eq(1, usb_midi_packet_cable(&packets[5]));
+  assert_int_eq(3, usb_midi_packet_length(&packets[0]));
+  assert_int_eq(2, usb_midi_packet_length(&packets[2]));
+}
+
+static void test_usb_midi_packet_system_messages() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  midi_parser_initialize(&p);
+
+  usb_midi_packet packets[] = {
+    { 0x0F, { MIDI_TIMING_CLOCK, 0, 0 } },
+    { 0x02, { 0xF3, 5, 0 } },
+    { 0x03, { 0xF2, 0x10, 0x20 } },
+    { 0x05, { 0xF6, 0, 0 } },
+    { 0x00, { 0x90, 60, 100 } }, // reserved CINs: ignored
+    { 0x01, { 0x90, 60, 100 } },
+  };
+  assert_int_eq(4, read_packets(&p, packets, 6, events));
+  assert_event(&events[0], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[1], 0xF3, 5, 0);
+  assert_event(&events[2], 0xF2, 0x10, 0x20);
+  assert_event(&events[3], 0xF6, 0, 0);
+}
+
+static void test_usb_midi_packet_sysex() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  byte buffer[8];
+  midi_parser_initialize(&p);
+  midi_parser_set_sysex_buffer(&p, buffer, sizeof(buffer));
+
+  // F0 7D 01 02 03 04 F7, with a clock in the middle
+  usb_midi_packet packets[] = {
+    { 0x04, { 0xF0, 0x7D, 0x01 } },
+    { 0x0F, { MIDI_TIMING_CLOCK, 0, 0 } },
+    { 0x04, { 0x02, 0x03, 0x04 } },
+    { 0x05, { 0xF7, 0, 0 } },
+  };
+  assert_int_eq(2, read_packets(&p, packets, 4, events));
+  assert_event(&events[0], MIDI_TIMING_CLOCK, 0, 0);
+  assert_event(&events[1], 0xF0, 5, 0);
+  byte expected[] = { 0x7D, 0x01, 0x02, 0x03, 0x04 };
+  bool matches = memcmp(expected, buffer, sizeof(expected)) == 0;
+  assert_true(matches);
+  bool pending = p.sysex_pending;
+  assert_true(pending);
+  midi_parser_release_sysex(&p);
+
+  // ending with two and three bytes
+  usb_midi_packet short_one[] = { { 0x06, { 0xF0, 0xF7, 0 } } };
+  assert_int_eq(1, read_packets(&p, short_one, 1, events));
+  assert_event(&events[0], 0xF0, 0, 0);
+  midi_parser_release_sysex(&p);
+
+  usb_midi_packet three[] = { { 0x07, { 0xF0, 0x7D, 0xF7 } } };
+  assert_int_eq(1, read_packets(&p, three, 1, events));
+  assert_event(&events[0], 0xF0, 1, 0);
+  assert_int_eq(0x7D, buffer[0]);
+  midi_parser_release_sysex(&p);
+
+  usb_midi_packet two[] = { { 0x04, { 0xF0, 0x7D, 0x02 } }, { 0x06, { 0x03, 0xF7, 0 } } };
+  assert_int_eq(1, read_packets(&p, two, 2, events));
+  assert_event(&events[0], 0xF0, 3, 0);
+  assert_int_eq(0x03, buffer[2]);
+  midi_parser_release_sysex(&p);
+}
+
+static void test_usb_midi_packet_sysex_dropped() {
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  byte buffer[4];
+  midi_parser_initialize(&p);
+
+  // no buffer: skipped
+  usb_midi_packet skipped[] = { { 0x04, { 0xF0, 0x7D, 0x01 } }, { 0x05, { 0xF7, 0, 0 } } };
+  assert_int_eq(0, read_packets(&p, skipped, 2, events));
+
+  // too long
+  midi_parser_set_sysex_buffer(&p, buffer, sizeof(buffer));
+  usb_midi_packet too_long[] = {
+    { 0x04, { 0xF0, 1, 2 } },
+    { 0x04, { 3, 4, 5 } },
+    { 0x05, { 0xF7, 0, 0 } },
+  };
+  assert_int_eq(0, read_packets(&p, too_long, 3, events));
+
+  // the end of a message we didn't see the start of
+  usb_midi_packet tail[] = { { 0x04, { 1, 2, 3 } }, { 0x06, { 4, 0xF7, 0 } } };
+  assert_int_eq(0, read_packets(&p, tail, 2, events));
+
+  // cut short by a note: the note still comes through
+  usb_midi_packet cut[] = { { 0x04, { 0xF0, 1, 2 } }, { 0x09, { 0x90, 60, 100 } }, { 0x05, { 0xF7, 0, 0 } } };
+  assert_int_eq(1, read_packets(&p, cut, 3, events));
+  assert_event(&events[0], 0x90, 60, 100);
+
+  // and the next one fits
+  usb_midi_packet fits[] = { { 0x07, { 0xF0, 0x7D, 0xF7 } } };
+  assert_int_eq(1, read_packets(&p, fits, 1, events));
+  assert_event(&events[0], 0xF0, 1, 0);
+}
+
+static void test_usb_midi_sysex_packet() {
+  byte message[] = { 0xF0, 0x7D, 0x7F, 0x01, 0x00, 0x55, 0xF7 };
+  usb_midi_packet packets[4];
+  byte count = 0;
+
+  for (byte offset = 0; offset < sizeof(message); count++) {
+    offset += usb_midi_sysex_packet(message, sizeof(message), offset, &packets[count]);
+  }
+
+  assert_int_eq(3, count);
+  assert_int_eq(USB_MIDI_CIN_SYSEX, packets[0].header);
+  assert_int_eq(0xF0, packets[0].bytes[0]);
+  assert_int_eq(USB_MIDI_CIN_SYSEX, packets[1].header);
+  assert_int_eq(0x01, packets[1].bytes[0]);
+  assert_int_eq(USB_MIDI_CIN_SYSEX_END_1, packets[2].header);
+  assert_int_eq(0xF7, packets[2].bytes[0]);
+  assert_int_eq(0, packets[2].bytes[1]);
+
+  // and back again
+  midi_parser p;
+  midi_event events[MAX_EVENTS];
+  byte buffer[8];
+  midi_parser_initialize(&p);
+  midi_parser_set_sysex_buffer(&p, buffer, sizeof(buffer));
+  assert_int_eq(1, read_packets(&p, packets, count, events));
+  assert_event(&events[0], 0xF0, 5, 0);
+  bool matches = memcmp(&message[1], buffer, 5) == 0;
+  assert_true(matches);
+
+  byte two_left[] = { 0xF0, 0x7D, 0x02, 0x03, 0xF7 };
+  usb_midi_packet last;
+  assert_int_eq(2, usb_midi_sysex_packet(two_left, sizeof(two_left), 3, &last));
+  assert_int_eq(USB_MIDI_CIN_SYSEX_END_2, last.header);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_usb_midi_packet_channel_messages();
+  test_usb_midi_packet_system_messages();
+  test_usb_midi_packet_sysex();
+  test_usb_midi_packet_sysex_dropped();
+  test_usb_midi_sysex_packet();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}
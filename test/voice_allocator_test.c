@@ -0,0 +1,185 @@
+#include "test_helper.h"
+#include "../src/voice_allocator.h"
+
+// plays `note` the way SID.ino does: pick a voice, then assign it
+static byte note_on(voice_allocator *a, byte note, byte policy) {
+  byte voice = voice_allocator_pick(a, note, policy);
+  voice_allocator_assign(a, voice, note);
+  voice_allocator_set_level(a, voice, 255);
+  return voice;
+}
+
+static void note_off(voice_allocator *a, byte note) {
+  for (byte i = 0; i < a->count; i++) {
+    if (a->voices[i].phase == VOICE_HELD && a->voices[i].note == note) {
+      voice_allocator_release(a, i);
+    }
+  }
+}
+
+// plays a chord on a 3-voice allocator
+static void chord(voice_allocator *a, byte root, byte policy) {
+  note_on(a, root, policy);
+  note_on(a, root + 4, policy);
+  note_on(a, root + 7, policy);
+}
+
+static void test_voice_allocator_free_voices_first() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+
+  for (byte policy = VOICE_ALLOCATOR_OLDEST; policy <= VOICE_ALLOCATOR_SAME_NOTE; policy++) {
+    voice_allocator_initialize(&a, 3);
+    assert_int_eq(0, note_on(&a, 60, policy));
+    assert_int_eq(1, note_on(&a, 64, policy));
+    assert_int_eq(2, note_on(&a, 67, policy));
+  }
+
+  voice_allocator_free(&a, 1);
+  assert_int_eq(1, voice_allocator_pick(&a, 72, VOICE_ALLOCATOR_OLDEST));
+  assert_int_eq(1, voice_allocator_pick(&a, 72, VOICE_ALLOCATOR_QUIETEST));
+}
+
+static void test_voice_allocator_oldest() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+  chord(&a, 60, VOICE_ALLOCATOR_OLDEST);
+
+  // C major, then F major on top: each new note takes the oldest voice
+  assert_int_eq(0, note_on(&a, 65, VOICE_ALLOCATOR_OLDEST));
+  assert_int_eq(1, note_on(&a, 69, VOICE_ALLOCATOR_OLDEST));
+  assert_int_eq(2, note_on(&a, 72, VOICE_ALLOCATOR_OLDEST));
+  assert_int_eq(0, note_on(&a, 74, VOICE_ALLOCATOR_OLDEST));
+}
+
+static void test_voice_allocator_quietest() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+  chord(&a, 60, VOICE_ALLOCATOR_QUIETEST);
+
+  voice_allocator_set_level(&a, 0, 200);
+  voice_allocator_set_level(&a, 1, 40); // decayed the furthest, though it's held
+  voice_allocator_set_level(&a, 2, 120);
+  assert_int_eq(1, note_on(&a, 72, VOICE_ALLOCATOR_QUIETEST));
+
+  // on a tie, the older voice goes
+  voice_allocator_set_level(&a, 0, 90);
+  voice_allocator_set_level(&a, 1, 90);
+  voice_allocator_set_level(&a, 2, 90);
+  assert_int_eq(0, note_on(&a, 74, VOICE_ALLOCATOR_QUIETEST));
+}
+
+static void test_voice_allocator_released_first() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+  chord(&a, 60, VOICE_ALLOCATOR_RELEASED_FIRST);
+
+  // nothing released: the oldest
+  assert_int_eq(0, voice_allocator_pick(&a, 72, VOICE_ALLOCATOR_RELEASED_FIRST));
+
+  // the newest note is let go: it's stolen, not the held ones
+  note_off(&a, 67);
+  voice_allocator_set_level(&a, 2, 250);
+  voice_allocator_set_level(&a, 0, 10); // quieter, but held
+  assert_int_eq(2, note_on(&a, 72, VOICE_ALLOCATOR_RELEASED_FIRST));
+
+  // of two released voices, the quieter one
+  note_off(&a, 60);
+  note_off(&a, 64);
+  voice_allocator_set_level(&a, 0, 80);
+  voice_allocator_set_level(&a, 1, 30);
+  assert_int_eq(1, note_on(&a, 76, VOICE_ALLOCATOR_RELEASED_FIRST));
+  assert_int_eq(0, note_on(&a, 79, VOICE_ALLOCATOR_RELEASED_FIRST));
+  assert_int_eq(VOICE_HELD, a.voices[0].phase);
+}
+
+static void test_voice_allocator_round_robin() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+
+  // each chord note lands one voice further on, even when earlier ones are
+  // free again, so every release rings out as long as it can
+  byte expected[] = { 0, 1, 2, 0, 1, 2, 0 };
+  for (byte i = 0; i < sizeof(expected); i++) {
+    assert_int_eq(expected[i], note_on(&a, 60 + i, VOICE_ALLOCATOR_ROUND_ROBIN));
+    note_off(&a, 60 + i);
+    voice_allocator_free(&a, expected[i]);
+  }
+
+  // a busy voice is skipped while there's a free one
+  voice_allocator_initialize(&a, 3);
+  note_on(&a, 60, VOICE_ALLOCATOR_ROUND_ROBIN); // 0
+  note_on(&a, 62, VOICE_ALLOCATOR_ROUND_ROBIN); // 1
+  voice_allocator_free(&a, 0);
+  assert_int_eq(2, note_on(&a, 64, VOICE_ALLOCATOR_ROUND_ROBIN));
+  assert_int_eq(0, note_on(&a, 65, VOICE_ALLOCATOR_ROUND_ROBIN));
+  // and with none free, it just goes round
+  assert_int_eq(1, note_on(&a, 67, VOICE_ALLOCATOR_ROUND_ROBIN));
+  assert_int_eq(2, note_on(&a, 69, VOICE_ALLOCATOR_ROUND_ROBIN));
+}
+
+static void test_voice_allocator_same_note() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+  chord(&a, 60, VOICE_ALLOCATOR_SAME_NOTE);
+
+  // re-striking a chord note retriggers its voice, whatever its age
+  assert_int_eq(1, note_on(&a, 64, VOICE_ALLOCATOR_SAME_NOTE));
+  note_off(&a, 67);
+  assert_int_eq(2, note_on(&a, 67, VOICE_ALLOCATOR_SAME_NOTE));
+
+  // even if there's a free voice: the note isn't doubled
+  voice_allocator_free(&a, 0);
+  assert_int_eq(2, note_on(&a, 67, VOICE_ALLOCATOR_SAME_NOTE));
+
+  // a new note falls back to released-first
+  note_off(&a, 64);
+  assert_int_eq(0, note_on(&a, 72, VOICE_ALLOCATOR_SAME_NOTE)); // free
+  assert_int_eq(1, note_on(&a, 74, VOICE_ALLOCATOR_SAME_NOTE)); // released
+}
+
+static void test_voice_allocator_ages_saturate() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 3);
+  note_on(&a, 36, VOICE_ALLOCATOR_OLDEST); // a pad on voice 0, held throughout
+
+  // a long run on the other two voices, enough to wrap an 8-bit counter
+  for (unsigned int i = 0; i < 1000; i++) {
+    byte voice = voice_allocator_pick(&a, 60 + i % 12, VOICE_ALLOCATOR_OLDEST);
+    voice_allocator_assign(&a, voice == 0 ? 1 + i % 2 : voice, 60 + i % 12);
+  }
+
+  assert_int_eq(0, voice_allocator_pick(&a, 72, VOICE_ALLOCATOR_OLDEST));
+}
+
+static void test_voice_allocator_count() {
+  voice_allocator a;
+  voice_allocator_initialize(&a, 200);
+  assert_int_eq(VOICE_ALLOCATOR_MAX_VOICES, a.count);
+
+  voice_allocator_initialize(&a, 6); // two chips
+  for (byte i = 0; i < 6; i++) {
+    assert_int_eq(i, note_on(&a, 48 + i, VOICE_ALLOCATOR_OLDEST));
+  }
+  assert_int_eq(0, note_on(&a, 60, VOICE_ALLOCATOR_OLDEST));
+
+  fprintf(stdout, "\n");
+  voice_allocator_inspect(&a, stdout);
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0); // disable buffering on stdout
+
+  test_voice_allocator_free_voices_first();
+  test_voice_allocator_oldest();
+  test_voice_allocator_quietest();
+  test_voice_allocator_released_first();
+  test_voice_allocator_round_robin();
+  test_voice_allocator_same_note();
+  test_voice_allocator_ages_saturate();
+  test_voice_allocator_count();
+
+  printf("\n");
+
+  return TEST_FAILURE_COUNT;
+}